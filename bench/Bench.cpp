@@ -0,0 +1,272 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Generator.h"
+#include "Lexer/Lexer.h"
+#include "Parser/Interpreter.h"
+#include "Parser/Parser.h"
+
+/*
+times the three stages of running a program, Lexer::tokenize, Parser::parse
+and Interpreter::walkAST, separately on generated programs (see Generator).
+each stage is run a few times untimed first, then repetitions times, and the
+median time gives its throughput. --json writes everything, every sample
+included, for comparing runs across commits.
+*/
+
+namespace {
+
+struct Options {
+  RunOptions run;
+  size_t bytes = 256 * 1024;  // base size of a workload
+  int warmup = 2;
+  int repetitions = 10;
+  std::string workload;  // empty for all of them
+  std::string json;      // "-" for stdout
+};
+
+// seconds per repetition, sorted
+struct Samples {
+  std::vector<double> seconds;
+
+  double percentile(double p) const {
+    const double rank = p / 100 * (seconds.size() - 1);
+    return seconds[static_cast<size_t>(rank + 0.5)];
+  }
+  double mean() const {
+    double total = 0;
+    for (double s : seconds) total += s;
+    return total / seconds.size();
+  }
+};
+
+struct Result {
+  const Generator::Workload* workload;
+  size_t bytes, tokens, nodes;
+  Samples lex, parse, walk;
+};
+
+// the nodes the parser made, the interpreter's stage runs on the same tree
+size_t countNodes(const ASTNode* node) {
+  if (!node) return 0;
+  size_t count = 1;
+  if (auto decl = dynamic_cast<const VariableDeclarationNode*>(node)) {
+    if (decl->lambdaExpr.has_value())
+      count += 1 + countNodes((*decl->lambdaExpr)->body);
+    else if (decl->expression.has_value())
+      count += countNodes(*decl->expression);
+  } else if (auto assign = dynamic_cast<const AssignmentNode*>(node)) {
+    count += countNodes(assign->expression);
+  } else if (auto binary = dynamic_cast<const BinaryOperationNode*>(node)) {
+    count += countNodes(binary->left) + countNodes(binary->right);
+  } else if (auto unary = dynamic_cast<const UnaryOperationNode*>(node)) {
+    count += countNodes(unary->operand);
+  } else if (auto call = dynamic_cast<const FunctionCallNode*>(node)) {
+    for (const ExpressionNode* arg : call->arguments) count += countNodes(arg);
+  } else if (auto pipeline = dynamic_cast<const PipelineNode*>(node)) {
+    count += countNodes(pipeline->source);
+    for (const FunctionCallNode* stage : pipeline->stages)
+      count += countNodes(stage);
+  } else if (auto array = dynamic_cast<const ArrayNode*>(node)) {
+    for (const ExpressionNode* element : array->elements)
+      count += countNodes(element);
+  } else if (auto index = dynamic_cast<const IndexNode*>(node)) {
+    count += countNodes(index->array) + countNodes(index->index);
+  }
+  return count;
+}
+
+template <typename Run>
+Samples measure(const Options& options, Run&& run) {
+  using Clock = std::chrono::steady_clock;
+  for (int i = 0; i < options.warmup; i++) run();
+  Samples samples;
+  for (int i = 0; i < options.repetitions; i++) {
+    const Clock::time_point start = Clock::now();
+    run();
+    samples.seconds.push_back(
+        std::chrono::duration<double>(Clock::now() - start).count());
+  }
+  std::sort(samples.seconds.begin(), samples.seconds.end());
+  return samples;
+}
+
+Result bench(const Generator::Workload& workload, const Options& options) {
+  const std::string code = workload.generate(options.bytes * workload.scale);
+  Result result{&workload, code.size(), 0, 0, {}, {}, {}};
+
+  const TokenStream tokens = Lexer::tokenize(code);
+  result.tokens = tokens.size();
+  std::unique_ptr<ProgramNode> program = Parser(tokens).parse();
+  for (const ASTNode* stmt : program->statements)
+    result.nodes += countNodes(stmt);
+
+  result.lex = measure(options, [&] { Lexer::tokenize(code); });
+  result.parse = measure(options, [&] { Parser(tokens).parse(); });
+
+  // resolving and optimizing change the tree, every run gets a fresh one.
+  // parsing it isn't timed, nor is freeing it
+  using Clock = std::chrono::steady_clock;
+  Samples& walk = result.walk;
+  for (int i = 0; i < options.warmup + options.repetitions; i++) {
+    program = Parser(tokens).parse();
+    const Clock::time_point start = Clock::now();
+    Interpreter::walkAST(program, options.run);
+    const double seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    if (i >= options.warmup) walk.seconds.push_back(seconds);
+  }
+  std::sort(walk.seconds.begin(), walk.seconds.end());
+  return result;
+}
+
+void printStage(const char* name, const Samples& samples,
+                const Result& result) {
+  const double median = samples.percentile(50);
+  char line[160];
+  std::snprintf(line, sizeof line,
+                "  %-6s p50 %9.3f ms  p90 %9.3f ms  %8.2f MB/s  %8.2f "
+                "Mtokens/s  %8.2f Mnodes/s\n",
+                name, median * 1e3, samples.percentile(90) * 1e3,
+                result.bytes / median / 1e6, result.tokens / median / 1e6,
+                result.nodes / median / 1e6);
+  std::cerr << line;
+}
+
+void printResult(const Result& result) {
+  std::cerr << result.workload->name << " (" << result.workload->description
+            << "): " << result.bytes << " bytes, " << result.tokens
+            << " tokens, " << result.nodes << " nodes\n";
+  printStage("lex", result.lex, result);
+  printStage("parse", result.parse, result);
+  printStage("walk", result.walk, result);
+}
+
+void jsonStage(std::ostream& out, const char* name, const Samples& samples,
+               const Result& result, bool last) {
+  const double median = samples.percentile(50);
+  out << "        \"" << name << "\": {\n"
+      << "          \"min\": " << samples.seconds.front()
+      << ", \"mean\": " << samples.mean()
+      << ", \"p50\": " << median << ", \"p90\": " << samples.percentile(90)
+      << ", \"p99\": " << samples.percentile(99)
+      << ", \"max\": " << samples.seconds.back() << ",\n"
+      << "          \"bytes_per_second\": " << result.bytes / median
+      << ", \"tokens_per_second\": " << result.tokens / median
+      << ", \"nodes_per_second\": " << result.nodes / median << ",\n"
+      << "          \"samples\": [";
+  for (size_t i = 0; i < samples.seconds.size(); i++)
+    out << (i ? ", " : "") << samples.seconds[i];
+  out << "]\n        }" << (last ? "\n" : ",\n");
+}
+
+void writeJson(std::ostream& out, const std::vector<Result>& results,
+               const Options& options) {
+  out.precision(9);
+#ifdef NDEBUG
+  const bool optimizedBuild = true;
+#else
+  const bool optimizedBuild = false;
+#endif
+  out << "{\n"
+      << "  \"mode\": \""
+      << (options.run.mode == ExecutionMode::TreeWalk ? "tree-walk"
+                                                      : "bytecode")
+      << "\",\n"
+      << "  \"optimize\": " << (options.run.optimize ? "true" : "false")
+      << ",\n"
+      << "  \"ndebug\": " << (optimizedBuild ? "true" : "false") << ",\n"
+      << "  \"warmup\": " << options.warmup << ",\n"
+      << "  \"repetitions\": " << options.repetitions << ",\n"
+      << "  \"unit\": \"seconds\",\n"
+      << "  \"workloads\": [\n";
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result& result = results[i];
+    out << "    {\n"
+        << "      \"name\": \"" << result.workload->name << "\",\n"
+        << "      \"bytes\": " << result.bytes
+        << ", \"tokens\": " << result.tokens
+        << ", \"nodes\": " << result.nodes << ",\n"
+        << "      \"stages\": {\n";
+    jsonStage(out, "lex", result.lex, result, false);
+    jsonStage(out, "parse", result.parse, result, false);
+    jsonStage(out, "walk", result.walk, result, true);
+    out << "      }\n    }" << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  out << "  ]\n}\n";
+}
+
+int usage(const char* program) {
+  std::cerr << "usage: " << program
+            << " [--workload deep|pipes|lambdas|large] [--size BYTES]"
+               " [--warmup N] [--repetitions N] [--tree-walk]"
+               " [--no-optimize] [--json FILE | -]\n";
+  return 2;
+}
+
+bool number(const char* text, long minimum, long& value) {
+  char* end = nullptr;
+  value = std::strtol(text, &end, 10);
+  return *end == '\0' && value >= minimum;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    long value;
+    if (std::strcmp(argv[i], "--tree-walk") == 0) {
+      options.run.mode = ExecutionMode::TreeWalk;
+    } else if (std::strcmp(argv[i], "--no-optimize") == 0) {
+      options.run.optimize = false;
+    } else if (std::strcmp(argv[i], "--workload") == 0 && i + 1 < argc) {
+      options.workload = argv[++i];
+    } else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+      options.json = argv[++i];
+    } else if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+      if (!number(argv[++i], 1, value)) return usage(argv[0]);
+      options.bytes = static_cast<size_t>(value);
+    } else if (std::strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+      if (!number(argv[++i], 0, value)) return usage(argv[0]);
+      options.warmup = static_cast<int>(value);
+    } else if (std::strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc) {
+      if (!number(argv[++i], 1, value)) return usage(argv[0]);
+      options.repetitions = static_cast<int>(value);
+    } else {
+      return usage(argv[0]);
+    }
+  }
+
+  std::vector<Result> results;
+  try {
+    for (const Generator::Workload& workload : Generator::workloads()) {
+      if (!options.workload.empty() && options.workload != workload.name)
+        continue;
+      results.push_back(bench(workload, options));
+      printResult(results.back());
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "error: " << e.what() << '\n';
+    return 1;
+  }
+  if (results.empty()) return usage(argv[0]);
+
+  if (options.json == "-") {
+    writeJson(std::cout, results, options);
+  } else if (!options.json.empty()) {
+    std::ofstream out(options.json);
+    writeJson(out, results, options);
+    if (!out.flush()) {
+      std::cerr << "error: can't write " << options.json << '\n';
+      return 1;
+    }
+  }
+}
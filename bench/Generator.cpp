@@ -0,0 +1,137 @@
+#include "Generator.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+
+// xorshift64*, std's distributions aren't the same on every standard library
+class Random {
+ public:
+  explicit Random(uint64_t seed) : state(seed) {}
+
+  uint32_t next(uint32_t bound) {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return static_cast<uint32_t>((state * 0x2545F4914F6CDD1DULL) >> 32) %
+           bound;
+  }
+
+ private:
+  uint64_t state;
+};
+
+// a literal, or a binding declared earlier in the same workload
+void leaf(std::string& out, Random& random, const std::string& previous) {
+  const uint32_t pick = random.next(8);
+  if (pick == 0 && !previous.empty())
+    out += previous;
+  else if (pick == 1)
+    out += std::to_string(random.next(100)) + ".5";
+  else
+    out += std::to_string(random.next(100) + 1);
+}
+
+// one side of every operation goes depth - 1 deeper, the other stays shallow
+void expression(std::string& out, Random& random, int depth,
+                const std::string& previous) {
+  if (depth == 0) {
+    leaf(out, random, previous);
+    return;
+  }
+  const int deep = depth - 1;
+  const int shallow = std::min(deep, 2);
+  const bool deepFirst = random.next(2) == 0;
+  out += '(';
+  expression(out, random, deepFirst ? deep : shallow, previous);
+  switch (random.next(4)) {
+    case 0:
+      out += " + ";
+      break;
+    case 1:
+      out += " - ";
+      break;
+    case 2:
+      out += " * ";
+      break;
+    default:
+      // only ever by a literal, so there's no division by zero
+      out += " / ";
+      out += std::to_string(random.next(9) + 1);
+      out += ")";
+      return;
+  }
+  expression(out, random, deepFirst ? shallow : deep, previous);
+  out += ')';
+}
+
+}  // namespace
+
+namespace Generator {
+
+std::string deepExpressions(size_t bytes) {
+  Random random(1);
+  std::string out;
+  std::string previous;
+  for (size_t i = 0; out.size() < bytes; i++) {
+    const std::string name = "deep" + std::to_string(i);
+    out += "let " + name + " = ";
+    expression(out, random, 32 + static_cast<int>(random.next(16)), previous);
+    out += ";\n";
+    previous = name;
+  }
+  return out;
+}
+
+std::string pipeChains(size_t bytes) {
+  static const char* const stages[] = {"increment", "decrement", "double",
+                                       "shift(3)", "shift(-2)"};
+  Random random(2);
+  std::string out = "let shift = (value, by) => value + by;\n";
+  for (size_t i = 0; out.size() < bytes; i++) {
+    out += "let pipe" + std::to_string(i) + " = " +
+           std::to_string(random.next(1000));
+    const uint32_t length = 48 + random.next(32);
+    for (uint32_t stage = 0; stage < length; stage++) {
+      out += stage % 8 == 7 ? "\n    |> " : " |> ";
+      out += stages[random.next(5)];
+    }
+    out += ";\n";
+  }
+  return out;
+}
+
+std::string manyLambdas(size_t bytes) {
+  Random random(3);
+  std::string out;
+  for (size_t i = 0; out.size() < bytes; i++) {
+    const std::string n = std::to_string(i);
+    const std::string k = std::to_string(random.next(50) + 1);
+    // chains of eight, so calls never nest deeper than that
+    if (i % 8 == 0)
+      out += "let fn" + n + " = (a, b) => (a + " + k + ") * (b - " + k + ");\n";
+    else
+      out += "let fn" + n + " = (a, b) => a * " + k + " + b - fn" +
+             std::to_string(i - 1) + "(b, a + 1);\n";
+    out += "let value" + n + " = fn" + n + "(" + n + ", " + k + ");\n";
+  }
+  return out;
+}
+
+std::string largeFile(size_t bytes) {
+  return deepExpressions(bytes / 3) + pipeChains(bytes / 3) +
+         manyLambdas(bytes / 3);
+}
+
+const std::vector<Workload>& workloads() {
+  static const std::vector<Workload> all = {
+      {"deep", "deeply nested arithmetic", deepExpressions, 1},
+      {"pipes", "long pipe chains", pipeChains, 1},
+      {"lambdas", "many small lambdas", manyLambdas, 1},
+      {"large", "a large file mixing all three", largeFile, 16},
+  };
+  return all;
+}
+
+}  // namespace Generator
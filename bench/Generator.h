@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*
+synthetic PalmTree programs for palmtree_bench. each workload is a list of
+top-level statements that print nothing, generated until the source is at
+least the requested size. the same size always gives the same bytes, so
+runs on different commits measure the same program.
+*/
+namespace Generator {
+
+struct Workload {
+  const char* name;
+  const char* description;
+  std::string (*generate)(size_t bytes);
+  size_t scale;  // the workload's size in multiples of the base size
+};
+
+// nested arithmetic, every statement has a spine a few dozen levels deep
+std::string deepExpressions(size_t bytes);
+// long pipelines through built-ins and a lambda taking extra arguments
+std::string pipeChains(size_t bytes);
+// many small lambdas calling each other in short chains, each called once
+std::string manyLambdas(size_t bytes);
+// all of the above, one after another
+std::string largeFile(size_t bytes);
+
+const std::vector<Workload>& workloads();
+
+}  // namespace Generator
@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Generator.h"
+#include "Server/Protocol.h"
+
+/*
+load for palmtree --serve: a number of connections, each on its own thread,
+send requests one after another and time every round trip. it runs twice,
+first with every script slightly different so none is in the server's
+cache and each is compiled, then with the same script every time, so all
+but the first only run. the difference is what the cache saves per request.
+the script is a file, or a workload from Generator.
+*/
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  std::string socket;
+  std::string script;              // a file, empty for the workload
+  std::string workload = "lambdas";
+  size_t bytes = 4 * 1024;         // the workload's size
+  int connections = 4;
+  int requests = 2000;             // per pass, split between connections
+  std::vector<std::pair<std::string, std::string>> inputs;
+};
+
+struct Pass {
+  std::vector<double> seconds;  // round trips, sorted
+  double wall = 0;
+
+  double percentile(double p) const {
+    const double rank = p / 100 * (seconds.size() - 1);
+    return seconds[static_cast<size_t>(rank + 0.5)];
+  }
+};
+
+// whitespace after the script that's different for every i, so each
+// request hashes to a program of its own
+std::string unique(const std::string& script, size_t i) {
+  std::string result = script + "\n";
+  for (; i; i >>= 1) result += i & 1 ? '\n' : ' ';
+  return result;
+}
+
+Pass run(const Options& options, const std::string& script, bool cold) {
+  std::vector<std::vector<double>> times(options.connections);
+  std::atomic<size_t> next{0};
+  std::mutex errorMutex;
+  std::string error;
+  // not the same scripts as an earlier run, which the server may still have
+  const size_t salt = static_cast<size_t>(
+      Clock::now().time_since_epoch().count() & 0xffffffff) << 24;
+
+  const Clock::time_point start = Clock::now();
+  std::vector<std::thread> threads;
+  for (int c = 0; c < options.connections; c++) {
+    threads.emplace_back([&, c] {
+      try {
+        Protocol::Connection connection =
+            Protocol::Connection::connect(options.socket);
+        Protocol::Request request;
+        request.inputs = options.inputs;
+        request.script = script;
+        Protocol::Reply reply;
+        for (size_t i; (i = next++) < static_cast<size_t>(options.requests);) {
+          if (cold) request.script = unique(script, salt + i + 1);
+          const Clock::time_point sent = Clock::now();
+          connection.write(request);
+          if (!connection.read(reply))
+            throw std::runtime_error("The server closed the connection");
+          times[c].push_back(
+              std::chrono::duration<double>(Clock::now() - sent).count());
+          if (!reply.ok) throw std::runtime_error(reply.error);
+        }
+      } catch (const std::exception& e) {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (error.empty()) error = e.what();
+        next = options.requests;
+      }
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  if (!error.empty()) throw std::runtime_error(error);
+
+  Pass pass;
+  pass.wall = std::chrono::duration<double>(Clock::now() - start).count();
+  for (const std::vector<double>& connection : times)
+    pass.seconds.insert(pass.seconds.end(), connection.begin(),
+                        connection.end());
+  std::sort(pass.seconds.begin(), pass.seconds.end());
+  return pass;
+}
+
+void print(const char* name, const Pass& pass) {
+  char line[160];
+  std::snprintf(line, sizeof line,
+                "  %-4s p50 %8.3f ms  p90 %8.3f ms  p99 %8.3f ms  %9.1f "
+                "requests/s\n",
+                name, pass.percentile(50) * 1e3, pass.percentile(90) * 1e3,
+                pass.percentile(99) * 1e3, pass.seconds.size() / pass.wall);
+  std::cerr << line;
+}
+
+int usage(const char* program) {
+  std::cerr << "usage: " << program
+            << " --socket PATH [--workload deep|pipes|lambdas|large]"
+               " [--size BYTES] [--connections N] [--requests N]"
+               " [--input name=value] [file]\n";
+  return 2;
+}
+
+bool number(const char* text, long minimum, long& value) {
+  char* end = nullptr;
+  value = std::strtol(text, &end, 10);
+  return *end == '\0' && value >= minimum;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    long value;
+    if (std::strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+      options.socket = argv[++i];
+    } else if (std::strcmp(argv[i], "--workload") == 0 && i + 1 < argc) {
+      options.workload = argv[++i];
+    } else if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+      if (!number(argv[++i], 1, value)) return usage(argv[0]);
+      options.bytes = static_cast<size_t>(value);
+    } else if (std::strcmp(argv[i], "--connections") == 0 && i + 1 < argc) {
+      if (!number(argv[++i], 1, value)) return usage(argv[0]);
+      options.connections = static_cast<int>(value);
+    } else if (std::strcmp(argv[i], "--requests") == 0 && i + 1 < argc) {
+      if (!number(argv[++i], 1, value)) return usage(argv[0]);
+      options.requests = static_cast<int>(value);
+    } else if (std::strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+      const std::string input = argv[++i];
+      const size_t equals = input.find('=');
+      if (equals == std::string::npos || equals == 0) return usage(argv[0]);
+      options.inputs.emplace_back(input.substr(0, equals),
+                                  input.substr(equals + 1));
+    } else if (argv[i][0] != '-' && options.script.empty()) {
+      options.script = argv[i];
+    } else {
+      return usage(argv[0]);
+    }
+  }
+  if (options.socket.empty()) return usage(argv[0]);
+
+  std::string script;
+  if (!options.script.empty()) {
+    std::ifstream file(options.script, std::ios::binary);
+    if (!file) {
+      std::cerr << "error: can't open " << options.script << '\n';
+      return 1;
+    }
+    script.assign(std::istreambuf_iterator<char>(file), {});
+  } else {
+    for (const Generator::Workload& workload : Generator::workloads())
+      if (options.workload == workload.name)
+        script = workload.generate(options.bytes);
+    if (script.empty()) return usage(argv[0]);
+  }
+
+  try {
+    std::cerr << script.size() << " byte script, " << options.connections
+              << " connections, " << options.requests << " requests\n";
+    print("cold", run(options, script, true));
+    print("hot", run(options, script, false));
+  } catch (const std::exception& e) {
+    std::cerr << "error: " << e.what() << '\n';
+    return 1;
+  }
+}
@@ -0,0 +1,431 @@
+#include "CppEmitter.h"
+
+#include <cctype>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+std::string CppEmitter::emit(const ProgramNode& program,
+                             const std::string& entry) {
+  if (!program.resolved)
+    throw std::runtime_error("Program must be resolved before compiling");
+  if (entry.empty() || std::isdigit(static_cast<unsigned char>(entry[0])))
+    throw std::runtime_error("Invalid entry name: " + entry);
+  for (char c : entry)
+    if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_')
+      throw std::runtime_error("Invalid entry name: " + entry);
+
+  CppEmitter emitter(program);
+  for (const ASTNode* stmt : program.statements) {
+    auto decl = stmt->as<VariableDeclarationNode>();
+    if (!decl || !decl->lambdaExpr.has_value()) continue;
+    emitter.lambdas.push_back(decl);
+    emitter.declarations[*decl->lambdaExpr] = decl;
+    if (!decl->mut) emitter.immutable[decl->slot] = decl;
+  }
+
+  // the bodies first, they decide which direct calls are needed
+  std::string bodies;
+  for (const VariableDeclarationNode* decl : emitter.lambdas)
+    bodies += emitter.emitLambda(*decl);
+  Function run;
+  for (const ASTNode* stmt : program.statements)
+    emitter.emitStatement(*stmt, run);
+
+  std::string out =
+      "// generated by palmtree --aot, don't edit\n"
+      "#include \"AOT/Runtime.h\"\n\n"
+      "namespace {\n\n";
+  if (!emitter.constants.empty()) out += emitter.constants + "\n";
+  for (const VariableDeclarationNode* decl : emitter.lambdas)
+    out += "const LambdaNode* lambda_" + name(decl->name) + ";\n";
+  if (!emitter.lambdas.empty()) out += "\n";
+  for (const VariableDeclarationNode* decl : emitter.lambdas)
+    if (emitter.called.count(decl->slot))
+      out += "Value call_" + name(decl->name) + "(" +
+             parameters(**decl->lambdaExpr) + ");\n";
+  if (!emitter.called.empty()) out += "\n";
+  out += bodies;
+  for (const VariableDeclarationNode* decl : emitter.lambdas) {
+    if (emitter.called.count(decl->slot))
+      out += emitter.emitDirectCall(*decl);
+    out += emitter.emitEntry(*decl);
+  }
+
+  out += "Aot::Module makeModule() {\n"
+         "  Aot::Module module(" +
+         std::to_string(program.globals.size()) + ", {";
+  for (size_t i = 0; i < program.builtIns.size(); i++)
+    out += (i ? ", \"" : "\"") + name(program.builtIns[i]) + "\"";
+  out += "});\n";
+  for (const VariableDeclarationNode* decl : emitter.lambdas) {
+    const LambdaNode& lambda = **decl->lambdaExpr;
+    out += "  lambda_" + name(decl->name) + " = module.lambda(\"" +
+           name(decl->name) + "\", {";
+    for (size_t i = 0; i < lambda.arguments.size(); i++)
+      out += (i ? ", \"" : "\"") + name(lambda.arguments[i]) + "\"";
+    out += "}, enter_" + name(decl->name) + ", " +
+           (lambda.cache ? "true" : "false") + ");\n";
+  }
+  out += "  return module;\n}\n\n}  // namespace\n\n";
+
+  out += "void " + entry +
+         "() {\n"
+         "  static const Aot::Module module = makeModule();\n"
+         "  Environment env = module.environment();\n" +
+         run.code + "}\n";
+  return out;
+}
+
+void CppEmitter::emitStatement(const ASTNode& node, Function& function) {
+  // the temporaries of a statement get a scope of their own
+  Function statement;
+  statement.indent = function.indent + 1;
+  statement.temps = function.temps;
+  statement.names = function.names;
+  std::string code;
+  if (auto decl = node.as<VariableDeclarationNode>()) {
+    std::string value = "Value()";
+    if (decl->lambdaExpr.has_value())
+      value = "Aot::lambda(lambda_" + name(decl->name) + ")";
+    else if (decl->expression.has_value())
+      value = emitExpression(**decl->expression, statement);
+    code = "env.define(" + std::to_string(decl->slot) + ", " + value + ", " +
+           (decl->mut ? "true" : "false") + ");";
+  } else if (auto assign = node.as<AssignmentNode>()) {
+    code = "env.define(" + std::to_string(assign->slot) + ", " +
+           emitExpression(*assign->expression, statement) + ", true);";
+  } else if (node.as<FunctionCallNode>() || node.as<PipelineNode>() ||
+             node.as<LocalBindingNode>()) {
+    code = emitExpression(static_cast<const ExpressionNode&>(node), statement) +
+           ";";
+  } else {
+    return;  // any other expression statement is a no-op, same as its visit()
+  }
+
+  function.temps = statement.temps;
+  if (statement.code.empty()) {
+    line(code, function);
+    return;
+  }
+  line("{", function);
+  line(code, statement);
+  function.code += statement.code;
+  line("}", function);
+}
+
+std::string CppEmitter::emitExpression(const ExpressionNode& node,
+                                       Function& function) {
+  if (auto number = node.as<NumberNode>())
+    return literal(number->value);
+
+  if (auto variable = node.as<VariableNode>()) {
+    if (variable->local >= 0) return local(variable->local, function);
+    return "Aot::global(env, " + std::to_string(variable->slot) + ", \"" +
+           name(variable->name) + "\")";
+  }
+
+  if (auto binary = node.as<BinaryOperationNode>()) {
+    std::vector<std::string> operands =
+        emitOperands(nullptr, {binary->left, binary->right}, function);
+    if (binary->operation == '/')
+      return "Aot::divide(" + operands[0] + ", " + operands[1] + ")";
+    if (binary->operation != '+' && binary->operation != '-' &&
+        binary->operation != '*')
+      throw std::runtime_error("Unsupported operation");
+    return "(" + operands[0] + " " + binary->operation + " " + operands[1] +
+           ")";
+  }
+
+  if (node.as<IntArithmeticNode>() || node.as<DoubleArithmeticNode>() ||
+      node.as<IntToDoubleNode>())
+    return "Value(" +
+           emitRaw(node, node.as<IntArithmeticNode>()
+                             ? "int"
+                             : "double",
+                   function) +
+           ")";
+
+  if (auto unary = node.as<UnaryOperationNode>())
+    return (unary->op == '-' ? "Aot::negate(" : "Aot::plus(") +
+           emitExpression(*unary->operand, function) + ")";
+
+  if (auto call = node.as<FunctionCallNode>())
+    return emitCall(*call, nullptr, function);
+
+  if (auto pipeline = node.as<PipelineNode>()) {
+    Operand value{emitExpression(*pipeline->source, function),
+                  isAtomic(*pipeline->source)};
+    for (const FunctionCallNode* stage : pipeline->stages)
+      value = {emitCall(*stage, &value, function), false};
+    return value.code;
+  }
+
+  if (auto array = node.as<ArrayNode>()) {
+    std::vector<std::string> elements = emitOperands(
+        nullptr, {array->elements.begin(), array->elements.end()}, function);
+    std::string code = "Aot::array({";
+    for (size_t i = 0; i < elements.size(); i++)
+      code += (i ? ", " : "") + elements[i];
+    return code + "})";
+  }
+
+  if (auto index = node.as<IndexNode>()) {
+    std::vector<std::string> operands =
+        emitOperands(nullptr, {index->array, index->index}, function);
+    return operands[0] + "[" + operands[1] + "]";
+  }
+
+  if (auto binding = node.as<LocalBindingNode>()) {
+    const std::string value = emitExpression(*binding->value, function);
+    std::string local = "l" + std::to_string(binding->local);
+    for (size_t i = 1; function.names.count(local); i++)
+      local = "l" + std::to_string(binding->local) + "_" + std::to_string(i);
+    function.names.insert(local);
+    line("const Value " + local + " = " + value + ";", function);
+
+    if (function.locals.size() <= static_cast<size_t>(binding->local))
+      function.locals.resize(binding->local + 1);
+    std::string shadowed = std::move(function.locals[binding->local]);
+    function.locals[binding->local] = local;
+    std::string body = emitExpression(*binding->body, function);
+    function.locals[binding->local] = std::move(shadowed);
+    return body;
+  }
+
+  if (auto lambda = node.as<LambdaNode>()) {
+    auto decl = declarations.find(lambda);
+    if (decl != declarations.end())
+      return "Aot::lambda(lambda_" + name(decl->second->name) + ")";
+  }
+
+  throw std::runtime_error("Can't compile " + node.to_string());
+}
+
+// the operands TypeInference typed are computed as plain ints and doubles,
+// only the outermost result is boxed in a Value. type is the C++ type node
+// was proven to have, int or double
+std::string CppEmitter::emitRaw(const ExpressionNode& node, const char* type,
+                                Function& function) {
+  const ExpressionNode* left;
+  const ExpressionNode* right;
+  char operation;
+  if (auto typed = node.as<IntArithmeticNode>()) {
+    left = typed->left, right = typed->right, operation = typed->operation;
+  } else if (auto typed = node.as<DoubleArithmeticNode>()) {
+    left = typed->left, right = typed->right, operation = typed->operation;
+  } else if (auto conversion = node.as<IntToDoubleNode>()) {
+    return "static_cast<double>(" +
+           emitRaw(*conversion->operand, "int", function) + ")";
+  } else if (auto constant = node.as<NumberNode>()) {
+    return number(constant->value);
+  } else {
+    return emitExpression(node, function) +
+           (std::string(type) == "int" ? ".asInt()" : ".asDouble()");
+  }
+
+  // the same left to right order as emitOperands keeps
+  std::string a = emitRaw(*left, type, function);
+  if (!isAtomic(*left) && !isAtomic(*right)) a = temp(a, function, type);
+  const std::string b = emitRaw(*right, type, function);
+  switch (operation) {
+    case '+':
+      return "Arithmetic::add(" + a + ", " + b + ")";
+    case '-':
+      return "Arithmetic::subtract(" + a + ", " + b + ")";
+    case '*':
+      return "Arithmetic::multiply(" + a + ", " + b + ")";
+    case '/':
+      return "Arithmetic::divide(" + a + ", " + b + ")";
+    default:
+      throw std::runtime_error("Unsupported operation");
+  }
+}
+
+std::string CppEmitter::emitCall(const FunctionCallNode& call,
+                                 const Operand* piped, Function& function) {
+  std::vector<std::string> operands = emitOperands(
+      piped, {call.arguments.begin(), call.arguments.end()}, function);
+  std::string list;
+  for (size_t i = 0; i < operands.size(); i++)
+    list += (i ? ", " : "") + operands[i];
+
+  if (call.builtIn >= 0)
+    return "Aot::callBuiltIn(env, " + std::to_string(call.builtIn) + ", {" +
+           list + "})";
+  if (call.local >= 0)
+    return "Aot::callValue(env, " + local(call.local, function) + ", \"" +
+           name(call.functionName) + "\", {" + list + "})";
+
+  auto callee = immutable.find(call.slot);
+  if (callee != immutable.end() &&
+      (*callee->second->lambdaExpr)->arguments.size() ==
+          call.argumentCount()) {
+    called.insert(call.slot);
+    return "call_" + name(call.functionName) + "(env" +
+           (list.empty() ? "" : ", ") + list + ")";
+  }
+  return "Aot::callGlobal(env, " + std::to_string(call.slot) + ", \"" +
+         name(call.functionName) + "\", {" + list + "})";
+}
+
+// the interpreter evaluates operands left to right, C++ doesn't promise an
+// order for the arguments of a call. wherever more than one operand can throw
+// or have an effect, all but the last are put in temporaries in turn
+std::vector<std::string> CppEmitter::emitOperands(
+    const Operand* first, const std::vector<const ExpressionNode*>& nodes,
+    Function& function) {
+  size_t effects = first && !first->atomic ? 1 : 0;
+  for (const ExpressionNode* node : nodes) effects += isAtomic(*node) ? 0 : 1;
+
+  std::vector<std::string> operands;
+  if (first) {
+    operands.push_back(first->atomic || effects == 1
+                           ? first->code
+                           : temp(first->code, function));
+    if (!first->atomic) effects--;
+  }
+  for (const ExpressionNode* node : nodes) {
+    std::string code = emitExpression(*node, function);
+    if (!isAtomic(*node) && --effects > 0) code = temp(code, function);
+    operands.push_back(std::move(code));
+  }
+  return operands;
+}
+
+std::string CppEmitter::emitLambda(const VariableDeclarationNode& decl) {
+  const LambdaNode& lambda = **decl.lambdaExpr;
+  Function function;
+  function.lambda = &lambda;
+  for (Symbol argument : lambda.arguments)
+    function.names.insert("a_" + name(argument));
+  const std::string result = emitExpression(*lambda.body, function);
+  return "// " + lambda.to_string() + "\nValue body_" + name(decl.name) +
+         "(" + parameters(lambda) + ") {\n" + function.code + "  return " +
+         result + ";\n}\n\n";
+}
+
+// a call that doesn't go through the lambda's node, which does the same
+// checks and caching
+std::string CppEmitter::emitDirectCall(const VariableDeclarationNode& decl) {
+  const LambdaNode& lambda = **decl.lambdaExpr;
+  const std::string function = name(decl.name);
+  std::string arguments;
+  for (Symbol argument : lambda.arguments)
+    arguments += ", a_" + name(argument);
+
+  std::string out = "Value call_" + function + "(" + parameters(lambda) +
+                    ") {\n  Aot::checkDefined(env, " +
+                    std::to_string(decl.slot) + ", \"" + function + "\");\n";
+  if (!lambda.cache)
+    return out + "  Aot::Frame frame(env);\n  return body_" + function +
+           "(env" + arguments + ");\n}\n\n";
+
+  const std::string count = std::to_string(lambda.arguments.size());
+  const std::string values = lambda.arguments.empty() ? "nullptr" : "arguments";
+  if (!lambda.arguments.empty())
+    out += "  const Value arguments[] = {" + arguments.substr(2) + "};\n";
+  return out + "  Value result;\n  if (lambda_" + function + "->cache->find(" +
+         values + ", " + count + ", result)) return result;\n" +
+         "  Aot::Frame frame(env);\n  result = body_" + function + "(env" +
+         arguments + ");\n  lambda_" + function + "->cache->insert(" + values +
+         ", " + count + ", result);\n  return result;\n}\n\n";
+}
+
+// the body for calls through the lambda's node, e.g. from map
+std::string CppEmitter::emitEntry(const VariableDeclarationNode& decl) {
+  const LambdaNode& lambda = **decl.lambdaExpr;
+  std::string out = "Value enter_" + name(decl.name) + "(Environment& env) {\n";
+  std::string arguments;
+  // copied, the body may grow the stack the frame is on
+  for (size_t i = 0; i < lambda.arguments.size(); i++) {
+    out += "  const Value a_" + name(lambda.arguments[i]) +
+           " = env.stack[env.frameBase + " + std::to_string(i) + "];\n";
+    arguments += ", a_" + name(lambda.arguments[i]);
+  }
+  return out + "  return body_" + name(decl.name) + "(env" + arguments +
+         ");\n}\n\n";
+}
+
+std::string CppEmitter::literal(const Value& value) {
+  if (value.isInt() || value.isDouble()) return "Value(" + number(value) + ")";
+
+  if (value.isArray()) {
+    const ArrayObject& array = value.asArray();
+    const std::string constant = "constant" + std::to_string(constantCount++);
+    constants += "const Value " + constant + " = Aot::array({";
+    for (size_t i = 0; i < array.size; i++) {
+      const Value element = array.integral
+                                ? Value(static_cast<int>(array.values[i]))
+                                : Value(array.values[i]);
+      constants += (i == 0 ? "" : i % 8 == 0 ? ",\n    " : ", ") +
+                   literal(element);
+    }
+    constants += "});\n";
+    return constant;
+  }
+
+  throw std::runtime_error("Can't compile the constant " + value.to_string());
+}
+
+// an int or a double as a C++ literal of that type
+std::string CppEmitter::number(const Value& value) {
+  if (value.isInt()) {
+    if (value.asInt() == INT_MIN) return "(-2147483647 - 1)";
+    return std::to_string(value.asInt());
+  }
+
+  const double d = value.asDouble();
+  if (std::isnan(d)) return "std::numeric_limits<double>::quiet_NaN()";
+  if (std::isinf(d))
+    return d > 0 ? "std::numeric_limits<double>::infinity()"
+                 : "-std::numeric_limits<double>::infinity()";
+  // the shortest digits that read back as the same double
+  char buffer[32];
+  for (int precision = 1; precision <= 17; precision++) {
+    std::snprintf(buffer, sizeof buffer, "%.*g", precision, d);
+    if (std::strtod(buffer, nullptr) == d) break;
+  }
+  std::string digits = buffer;
+  if (digits.find_first_of(".e") == std::string::npos) digits += ".0";
+  return digits;
+}
+
+std::string CppEmitter::local(int index, Function& function) const {
+  if (function.lambda &&
+      static_cast<size_t>(index) < function.lambda->arguments.size())
+    return "a_" + name(function.lambda->arguments[index]);
+  if (static_cast<size_t>(index) >= function.locals.size() ||
+      function.locals[index].empty())
+    throw std::runtime_error("Local $" + std::to_string(index) +
+                             " isn't bound");
+  return function.locals[index];
+}
+
+std::string CppEmitter::temp(const std::string& code, Function& function,
+                             const char* type) {
+  const std::string name = "t" + std::to_string(function.temps++);
+  line("const " + std::string(type) + " " + name + " = " + code + ";",
+       function);
+  return name;
+}
+
+void CppEmitter::line(const std::string& code, Function& function) {
+  function.code += std::string(2 * function.indent, ' ') + code + "\n";
+}
+
+// literals and arguments, whose order doesn't matter
+bool CppEmitter::isAtomic(const ExpressionNode& node) {
+  if (node.as<NumberNode>()) return true;
+  auto variable = node.as<VariableNode>();
+  return variable && variable->local >= 0;
+}
+
+std::string CppEmitter::parameters(const LambdaNode& lambda) {
+  std::string list = "Environment& env";
+  for (Symbol argument : lambda.arguments)
+    list += ", const Value& a_" + name(argument);
+  return list;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../Parser/AST.h"
+
+/*
+lowers a resolved, usually optimized, ProgramNode into a standalone C++17
+translation unit for palmtree --aot. every declared lambda becomes a function,
+calls of immutable lambdas become direct calls, pipelines nested ones, and
+built-ins are called through the runtime (see Aot in Runtime.h). the unit
+defines `void entry()`, which runs the program's statements in order.
+*/
+class CppEmitter {
+ public:
+  static std::string emit(const ProgramNode& program, const std::string& entry);
+
+ private:
+  // a C++ function being written, the entry or one lambda's body
+  struct Function {
+    const LambdaNode* lambda = nullptr;  // nullptr for the entry
+    std::string code;
+    int indent = 1;
+    size_t temps = 0;
+    std::vector<std::string> locals;  // names of the bound LocalBindingNodes
+    std::unordered_set<std::string> names;
+  };
+  struct Operand {
+    std::string code;
+    bool atomic;  // can neither throw nor have an effect
+  };
+
+  explicit CppEmitter(const ProgramNode& program) : program(program) {}
+
+  void emitStatement(const ASTNode& node, Function& function);
+  std::string emitExpression(const ExpressionNode& node, Function& function);
+  std::string emitCall(const FunctionCallNode& call, const Operand* piped,
+                       Function& function);
+  std::string emitRaw(const ExpressionNode& node, const char* type,
+                      Function& function);
+  std::vector<std::string> emitOperands(
+      const Operand* first, const std::vector<const ExpressionNode*>& nodes,
+      Function& function);
+  std::string emitLambda(const VariableDeclarationNode& decl);
+  std::string emitDirectCall(const VariableDeclarationNode& decl);
+  std::string emitEntry(const VariableDeclarationNode& decl);
+
+  std::string literal(const Value& value);
+  static std::string number(const Value& value);
+  std::string local(int index, Function& function) const;
+  static std::string temp(const std::string& code, Function& function,
+                          const char* type = "Value");
+  static void line(const std::string& code, Function& function);
+  static bool isAtomic(const ExpressionNode& node);
+  static std::string parameters(const LambdaNode& lambda);
+  static std::string name(Symbol symbol) { return symbolName(symbol); }
+
+ private:
+  const ProgramNode& program;
+  // declarations binding a lambda, in order, and the immutable ones by slot,
+  // which calls can go to directly
+  std::vector<const VariableDeclarationNode*> lambdas;
+  std::unordered_map<int, const VariableDeclarationNode*> immutable;
+  std::unordered_map<const LambdaNode*, const VariableDeclarationNode*>
+      declarations;
+  std::unordered_set<int> called;  // slots of immutable lambdas called directly
+  std::string constants;           // array literals, built once
+  size_t constantCount = 0;
+};
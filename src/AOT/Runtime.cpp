@@ -0,0 +1,31 @@
+#include "Runtime.h"
+
+#include "../Lexer/Lexer.h"
+
+namespace Aot {
+
+Module::Module(size_t globalCount, std::initializer_list<const char*> builtIns)
+    : arena(std::make_shared<Arena>()), globalCount(globalCount) {
+  for (const char* name : builtIns)
+    this->builtIns.push_back(
+        &Lexer::BUILT_IN_FUNCTIONS.at(intern(name)).function);
+}
+
+const LambdaNode* Module::lambda(const char* name,
+                                 std::initializer_list<const char*> arguments,
+                                 CompiledBodyNode::Function function,
+                                 bool cached) {
+  std::vector<Symbol> symbols;
+  for (const char* argument : arguments) symbols.push_back(intern(argument));
+  LambdaNode* lambda = arena->make<LambdaNode>(
+      intern(name), symbols, arena->make<CompiledBodyNode>(function));
+  lambda->self = std::shared_ptr<const LambdaNode>(arena, lambda);
+  if (cached) lambda->cache = std::make_unique<MemoCache>();
+  return lambda;
+}
+
+Environment Module::environment() const {
+  return Environment(globalCount, builtIns);
+}
+
+}  // namespace Aot
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../Parser/AST.h"
+
+// the body of a lambda compiled ahead of time. its arguments are the current
+// frame, like for any other lambda called through LambdaNode::call
+struct CompiledBodyNode : public ExpressionNode {
+  static constexpr NodeKind KIND = NodeKind::CompiledBody;
+
+  using Function = Value (*)(Environment& env);
+  Function function;
+
+  explicit CompiledBodyNode(Function function)
+      : ExpressionNode(KIND), function(function) {}
+
+  Value evaluate(Environment& env) const override { return function(env); }
+  Value visit(Environment& env) const override { return evaluate(env); }
+
+  std::string to_string(int indent = 0) const override {
+    return std::string(indent, ' ') + "COMPILED";
+  }
+};
+
+/*
+what the CppEmitter's C++ links against. every helper behaves
+exactly like the node of the tree it stands in for, errors included, so a
+compiled program prints what Interpreter::walkAST prints.
+*/
+namespace Aot {
+
+// the globals and built-ins of one compiled program, and the nodes of its
+// lambdas, which built-ins like map need to call them
+class Module {
+ public:
+  Module(size_t globalCount, std::initializer_list<const char*> builtIns);
+
+  // a lambda whose body is function, with a result cache if it's memoized
+  const LambdaNode* lambda(const char* name,
+                           std::initializer_list<const char*> arguments,
+                           CompiledBodyNode::Function function, bool cached);
+
+  Environment environment() const;  // a fresh one for every run
+
+ private:
+  std::shared_ptr<Arena> arena;  // owns the lambdas
+  size_t globalCount;
+  std::vector<const BuiltInFunction*> builtIns;
+};
+
+// counts a call of a compiled lambda towards the call depth
+class Frame {
+ public:
+  explicit Frame(Environment& env) : env(env) {
+    if (env.depth >= Environment::MAX_CALL_DEPTH)
+      throw std::runtime_error("Stack overflow");
+    env.depth++;
+  }
+  Frame(const Frame&) = delete;
+  Frame& operator=(const Frame&) = delete;
+  ~Frame() { env.depth--; }
+
+ private:
+  Environment& env;
+};
+
+inline const Value& global(const Environment& env, int slot,
+                           const char* name) {
+  if (env.defined[slot]) return env.globals[slot];
+  env.output->line(std::string("Undefined variable: ") + name);
+  throw std::runtime_error(std::string("Undefined variable: ") + name);
+}
+
+inline Value divide(const Value& left, const Value& right) {
+  // arrays check their own elements
+  if (right.isArray() || right != 0) return left / right;
+  throw std::runtime_error("Division by zero");
+}
+
+inline Value negate(const Value& value) {
+  if (value.isArray()) return value * Value(-1);
+  if (value.isInt()) return Value(Arithmetic::subtract(0, value.asInt()));
+  if (value.isDouble()) return Value(-value.asDouble());
+  throw std::runtime_error("Invalid Unary Operand");
+}
+
+inline const Value& plus(const Value& value) {
+  if (!value.isNumeric() && !value.isArray())
+    throw std::runtime_error("Invalid Unary Operand");
+  return value;
+}
+
+inline Value array(std::initializer_list<Value> elements) {
+  return Value::array(elements.begin(), elements.size());
+}
+
+inline Value lambda(const LambdaNode* lambda) {
+  return Value(lambda->self.lock());
+}
+
+inline Value callBuiltIn(Environment& env, int index,
+                         std::initializer_list<Value> arguments) {
+  return (*env.builtIns[index])(
+      Arguments{arguments.begin(), arguments.size(), &env});
+}
+
+// a lambda that's only known at runtime, an argument or a mutable global
+inline Value callValue(Environment& env, const Value& callee, const char* name,
+                       std::initializer_list<Value> arguments) {
+  if (!callee.isLambda())
+    throw std::runtime_error(std::string("Unknown function: ") + name);
+  const LambdaNode* function = callee.asLambda().get();
+  if (arguments.size() != function->arguments.size())
+    throw std::runtime_error("Input count mismatch");
+  const size_t base = env.stack.size();
+  env.stack.insert(env.stack.end(), arguments.begin(), arguments.end());
+  return function->call(env, base);
+}
+
+inline Value callGlobal(Environment& env, int slot, const char* name,
+                        std::initializer_list<Value> arguments) {
+  return callValue(env, env.defined[slot] ? env.globals[slot] : Value(), name,
+                   arguments);
+}
+
+// the check a direct call of a compiled lambda starts with
+inline void checkDefined(const Environment& env, int slot, const char* name) {
+  if (!env.defined[slot])
+    throw std::runtime_error(std::string("Unknown function: ") + name);
+}
+
+}  // namespace Aot
@@ -0,0 +1,207 @@
+#include "Assembler.h"
+
+#include <cstring>
+#include <stdexcept>
+
+Assembler::Label Assembler::newLabel() {
+  labels.emplace_back();
+  return labels.size() - 1;
+}
+
+void Assembler::bind(Label label) {
+  LabelState& state = labels[label];
+  state.position = bytes.size();
+  for (size_t fixup : state.fixups)
+    patch32(fixup, static_cast<int32_t>(state.position - fixup));
+  state.fixups.clear();
+}
+
+void Assembler::jump(Label label) {
+  byte(0xe9);
+  reference(label);
+}
+
+void Assembler::jump(Condition condition, Label label) {
+  byte(0x0f);
+  byte(static_cast<uint8_t>(0x80 | condition));
+  reference(label);
+}
+
+void Assembler::push(Register r) { byte(static_cast<uint8_t>(0x50 + r)); }
+
+void Assembler::pop(Register r) { byte(static_cast<uint8_t>(0x58 + r)); }
+
+void Assembler::mov(Register dst, Register src) {
+  rexW();
+  byte(0x89);
+  modrm(3, src, dst);
+}
+
+void Assembler::movImm(Register dst, uint64_t value) {
+  rexW();
+  byte(static_cast<uint8_t>(0xb8 + dst));
+  for (int i = 0; i < 8; i++) byte(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+void Assembler::load(Register dst, Register base, int32_t disp) {
+  rexW();
+  byte(0x8b);
+  memory(dst, base, disp);
+}
+
+void Assembler::store(Register base, int32_t disp, Register src) {
+  rexW();
+  byte(0x89);
+  memory(src, base, disp);
+}
+
+void Assembler::lea(Register dst, Register base, int32_t disp) {
+  rexW();
+  byte(0x8d);
+  memory(dst, base, disp);
+}
+
+void Assembler::addImm(Register dst, int32_t value) {
+  rexW();
+  byte(0x81);
+  modrm(3, 0, dst);
+  imm32(value);
+}
+
+void Assembler::subImm(Register dst, int32_t value) {
+  rexW();
+  byte(0x81);
+  modrm(3, 5, dst);
+  imm32(value);
+}
+
+void Assembler::xor64(Register dst, Register src) {
+  rexW();
+  byte(0x31);
+  modrm(3, src, dst);
+}
+
+void Assembler::movImm32(Register dst, int32_t value) {
+  byte(static_cast<uint8_t>(0xb8 + dst));
+  imm32(value);
+}
+
+void Assembler::add32(Register dst, Register src) {
+  byte(0x01);
+  modrm(3, src, dst);
+}
+
+void Assembler::sub32(Register dst, Register src) {
+  byte(0x29);
+  modrm(3, src, dst);
+}
+
+void Assembler::imul32(Register dst, Register src) {
+  byte(0x0f);
+  byte(0xaf);
+  modrm(3, dst, src);
+}
+
+void Assembler::neg32(Register r) {
+  byte(0xf7);
+  modrm(3, 3, r);
+}
+
+void Assembler::cdq() { byte(0x99); }
+
+void Assembler::idiv32(Register divisor) {
+  byte(0xf7);
+  modrm(3, 7, divisor);
+}
+
+void Assembler::test32(Register a, Register b) {
+  byte(0x85);
+  modrm(3, b, a);
+}
+
+void Assembler::cmpImm32(Register r, int32_t value) {
+  byte(0x81);
+  modrm(3, 7, r);
+  imm32(value);
+}
+
+void Assembler::movq(Xmm dst, Register src) {
+  byte(0x66);
+  rexW();
+  byte(0x0f);
+  byte(0x6e);
+  modrm(3, dst, src);
+}
+
+void Assembler::movq(Register dst, Xmm src) {
+  byte(0x66);
+  rexW();
+  byte(0x0f);
+  byte(0x7e);
+  modrm(3, src, dst);
+}
+
+void Assembler::cvtsi2sd(Xmm dst, Register src) {
+  byte(0xf2);
+  byte(0x0f);
+  byte(0x2a);
+  modrm(3, dst, src);
+}
+
+void Assembler::sse(SseOp op, Xmm dst, Xmm src) {
+  byte(0xf2);
+  byte(0x0f);
+  byte(op);
+  modrm(3, dst, src);
+}
+
+void Assembler::xorpd(Xmm dst, Xmm src) {
+  byte(0x66);
+  byte(0x0f);
+  byte(0x57);
+  modrm(3, dst, src);
+}
+
+void Assembler::ucomisd(Xmm a, Xmm b) {
+  byte(0x66);
+  byte(0x0f);
+  byte(0x2e);
+  modrm(3, a, b);
+}
+
+void Assembler::call(Register target) {
+  byte(0xff);
+  modrm(3, 2, target);
+}
+
+void Assembler::leave() { byte(0xc9); }
+
+void Assembler::ret() { byte(0xc3); }
+
+void Assembler::patch32(size_t position, int32_t value) {
+  if (position < 4 || position > bytes.size())
+    throw std::runtime_error("Invalid patch position");
+  std::memcpy(bytes.data() + position - 4, &value, sizeof value);
+}
+
+// a rel32 to label, relative to the end of the field
+void Assembler::reference(Label label) {
+  imm32(0);
+  const LabelState& state = labels[label];
+  if (state.position == SIZE_MAX)
+    labels[label].fixups.push_back(bytes.size());
+  else
+    patch32(bytes.size(),
+            static_cast<int32_t>(state.position - bytes.size()));
+}
+
+void Assembler::imm32(int32_t value) {
+  for (int i = 0; i < 4; i++) byte(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+// [base+disp32], rsp as a base needs a SIB byte
+void Assembler::memory(uint8_t reg, Register base, int32_t disp) {
+  modrm(2, reg, base);
+  if (base == RSP) byte(0x24);
+  imm32(disp);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+emits the handful of x86-64 instructions the JIT needs into a byte buffer.
+only the first eight general purpose and sse registers are used, so no
+instruction needs the REX.R or REX.B bits.
+*/
+class Assembler {
+ public:
+  enum Register : uint8_t { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI };
+  enum Xmm : uint8_t { XMM0, XMM1, XMM2 };
+  enum Condition : uint8_t { Equal = 0x4, NotEqual = 0x5 };
+  enum SseOp : uint8_t {
+    AddSd = 0x58,
+    MulSd = 0x59,
+    SubSd = 0x5c,
+    DivSd = 0x5e
+  };
+
+  using Label = size_t;
+
+  const std::vector<uint8_t>& code() const { return bytes; }
+  size_t position() const { return bytes.size(); }
+
+  // labels may be jumped to before they're bound
+  Label newLabel();
+  void bind(Label label);
+  void jump(Label label);
+  void jump(Condition condition, Label label);
+
+  // 64 bit moves and stack
+  void push(Register r);
+  void pop(Register r);
+  void mov(Register dst, Register src);
+  void movImm(Register dst, uint64_t value);
+  void load(Register dst, Register base, int32_t disp);   // dst = [base+disp]
+  void store(Register base, int32_t disp, Register src);  // [base+disp] = src
+  void lea(Register dst, Register base, int32_t disp);
+  void addImm(Register dst, int32_t value);
+  void subImm(Register dst, int32_t value);
+  void xor64(Register dst, Register src);
+
+  // 32 bit integer arithmetic
+  void movImm32(Register dst, int32_t value);
+  void add32(Register dst, Register src);
+  void sub32(Register dst, Register src);
+  void imul32(Register dst, Register src);
+  void neg32(Register r);
+  void cdq();
+  void idiv32(Register divisor);  // edx:eax / divisor
+  void test32(Register a, Register b);
+  void cmpImm32(Register r, int32_t value);
+
+  // scalar doubles
+  void movq(Xmm dst, Register src);
+  void movq(Register dst, Xmm src);
+  void cvtsi2sd(Xmm dst, Register src);  // from the low 32 bits
+  void sse(SseOp op, Xmm dst, Xmm src);
+  void xorpd(Xmm dst, Xmm src);
+  void ucomisd(Xmm a, Xmm b);
+
+  void call(Register target);
+  void leave();
+  void ret();
+
+  // overwrites the 32 bit immediate ending at position, e.g. a frame size
+  // that's only known once the body has been emitted
+  void patch32(size_t position, int32_t value);
+
+ private:
+  void byte(uint8_t b) { bytes.push_back(b); }
+  void imm32(int32_t value);
+  void reference(Label label);
+  void rexW() { byte(0x48); }
+  void modrm(uint8_t mod, uint8_t reg, uint8_t rm) {
+    byte(static_cast<uint8_t>(mod << 6 | reg << 3 | rm));
+  }
+  void memory(uint8_t reg, Register base, int32_t disp);
+
+  struct LabelState {
+    size_t position = SIZE_MAX;
+    std::vector<size_t> fixups;  // ends of rel32 fields waiting for it
+  };
+
+  std::vector<uint8_t> bytes;
+  std::vector<LabelState> labels;
+};
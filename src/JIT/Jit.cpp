@@ -0,0 +1,458 @@
+#include "Jit.h"
+
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include "../Parser/AST.h"
+#include "Assembler.h"
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define PALM_JIT 1
+#include <sys/mman.h>
+#endif
+
+/*
+a compiled specialization, called as code(arguments, &result) with one 8
+byte slot per argument: the low 32 bits of an int or a double's bits.
+returns 0, or 1 when the call has to be run by the interpreter instead
+*/
+struct NativeFunction {
+  using Code = int (*)(const uint64_t* arguments, uint64_t* result);
+
+  Code code = nullptr;
+  void* memory = nullptr;
+  size_t size = 0;
+  uint32_t signature;
+  bool returnsDouble;
+
+  NativeFunction(uint32_t signature, bool returnsDouble)
+      : signature(signature), returnsDouble(returnsDouble) {}
+  NativeFunction(const NativeFunction&) = delete;
+  NativeFunction& operator=(const NativeFunction&) = delete;
+  ~NativeFunction() {
+#ifdef PALM_JIT
+    if (memory) munmap(memory, size);
+#endif
+  }
+
+  // copies the code into memory that's executable but no longer writable
+  bool load(const std::vector<uint8_t>& bytes) {
+#ifdef PALM_JIT
+    size = bytes.size();
+    void* pages = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pages == MAP_FAILED) return false;
+    memory = pages;
+    std::memcpy(memory, bytes.data(), size);
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) return false;
+    code = reinterpret_cast<Code>(memory);
+    return true;
+#else
+    (void)bytes;
+    return false;
+#endif
+  }
+};
+
+JitProfile::JitProfile() = default;
+JitProfile::~JitProfile() = default;
+
+namespace {
+
+#ifdef PALM_JIT
+JitMode currentMode = JitMode::On;
+#else
+JitMode currentMode = JitMode::Off;
+#endif
+
+std::mutex compileMutex;  // compiling touches the profiles of every callee
+std::atomic<size_t> compiled{0};
+std::atomic<size_t> bailouts{0};
+
+// one bit per argument, set for doubles. false unless every one is numeric
+bool signatureOf(const Value* arguments, size_t count, uint32_t& signature) {
+  if (count > Jit::MAX_ARGUMENTS) return false;
+  signature = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (arguments[i].isDouble())
+      signature |= uint32_t(1) << i;
+    else if (!arguments[i].isInt())
+      return false;
+  }
+  return true;
+}
+
+const NativeFunction* compile(const LambdaNode& lambda, uint32_t signature,
+                              Environment& env,
+                              std::vector<const LambdaNode*>& active);
+
+/*
+one lambda body for one signature. every expression leaves its value in
+rax, an int in the low 32 bits or a double's bits, and its type is known
+statically from the argument types. the frame holds the result pointer and
+then one slot per local, the arguments first:
+
+  [rbp - 8]           where the result goes
+  [rbp - 16 - 8 * i]  local i
+*/
+class FunctionCompiler {
+ public:
+  FunctionCompiler(const LambdaNode& lambda, uint32_t signature,
+                   Environment& env, std::vector<const LambdaNode*>& active)
+      : lambda(lambda), signature(signature), env(env), active(active) {}
+
+  std::unique_ptr<NativeFunction> compile() {
+    const size_t argumentCount = lambda.arguments.size();
+    for (size_t i = 0; i < argumentCount; i++)
+      locals.push_back(signature >> i & 1 ? Type::Double : Type::Int);
+
+    a.push(A::RBP);
+    a.mov(A::RBP, A::RSP);
+    a.subImm(A::RSP, 0);
+    const size_t frameSizeField = a.position();
+    a.store(A::RBP, -8, A::RSI);
+    for (size_t i = 0; i < argumentCount; i++) {
+      a.load(A::RAX, A::RDI, static_cast<int32_t>(8 * i));
+      a.store(A::RBP, slot(i), A::RAX);
+    }
+
+    Type type;
+    if (!expression(*lambda.body, type)) return nullptr;
+    a.load(A::RCX, A::RBP, -8);
+    a.store(A::RCX, 0, A::RAX);
+    a.xor64(A::RAX, A::RAX);
+    a.leave();
+    a.ret();
+
+    a.bind(bail);
+    a.movImm32(A::RAX, 1);
+    a.leave();
+    a.ret();
+
+    // the result pointer and the locals, kept 16 byte aligned
+    const size_t bytes = 8 + 8 * locals.size();
+    a.patch32(frameSizeField, static_cast<int32_t>((bytes + 15) / 16 * 16));
+
+    auto native =
+        std::make_unique<NativeFunction>(signature, type == Type::Double);
+    if (!native->load(a.code())) return nullptr;
+    return native;
+  }
+
+ private:
+  enum class Type { Int, Double };
+  using A = Assembler;
+
+  static int32_t slot(size_t local) {
+    return static_cast<int32_t>(-16 - 8 * static_cast<int64_t>(local));
+  }
+
+  bool expression(const ExpressionNode& node, Type& type) {
+    if (auto number = node.as<NumberNode>())
+      return constant(number->value, type);
+    if (auto variable = node.as<VariableNode>()) {
+      if (variable->local < 0) return global(variable->slot, type);
+      if (static_cast<size_t>(variable->local) >= locals.size()) return false;
+      a.load(A::RAX, A::RBP, slot(variable->local));
+      type = locals[variable->local];
+      return true;
+    }
+    if (auto binary = node.as<BinaryOperationNode>())
+      return arithmetic(*binary->left, binary->operation, *binary->right, type);
+    // TypeInference already proved what's checked here anyway
+    if (auto typed = node.as<IntArithmeticNode>())
+      return arithmetic(*typed->left, typed->operation, *typed->right, type);
+    if (auto typed = node.as<DoubleArithmeticNode>())
+      return arithmetic(*typed->left, typed->operation, *typed->right, type);
+    if (auto conversion = node.as<IntToDoubleNode>()) {
+      if (!expression(*conversion->operand, type)) return false;
+      if (type == Type::Int) {
+        a.cvtsi2sd(A::XMM0, A::RAX);
+        a.movq(A::RAX, A::XMM0);
+      }
+      type = Type::Double;
+      return true;
+    }
+    if (auto unary = node.as<UnaryOperationNode>()) {
+      if (!expression(*unary->operand, type)) return false;
+      if (unary->op == '+') return true;
+      if (unary->op != '-') return false;
+      if (type == Type::Int) {
+        a.neg32(A::RAX);
+      } else {
+        a.movImm(A::RCX, uint64_t(1) << 63);
+        a.xor64(A::RAX, A::RCX);
+      }
+      return true;
+    }
+    if (auto binding = node.as<LocalBindingNode>()) {
+      Type valueType;
+      if (binding->local < 0 || !expression(*binding->value, valueType))
+        return false;
+      if (static_cast<size_t>(binding->local) >= locals.size())
+        locals.resize(binding->local + 1, Type::Int);
+      locals[binding->local] = valueType;
+      a.store(A::RBP, slot(binding->local), A::RAX);
+      return expression(*binding->body, type);
+    }
+    if (auto call = node.as<FunctionCallNode>())
+      return this->call(*call, nullptr, type);
+    if (auto pipeline = node.as<PipelineNode>()) {
+      if (!expression(*pipeline->source, type)) return false;
+      for (const FunctionCallNode* stage : pipeline->stages) {
+        const Type piped = type;
+        if (!this->call(*stage, &piped, type)) return false;
+      }
+      return true;
+    }
+    return false;
+  }
+
+  bool constant(const Value& value, Type& type) {
+    if (value.isInt()) {
+      a.movImm32(A::RAX, value.asInt());
+      type = Type::Int;
+      return true;
+    }
+    if (!value.isDouble()) return false;
+    const double d = value.asDouble();
+    uint64_t bits;
+    std::memcpy(&bits, &d, sizeof bits);
+    a.movImm(A::RAX, bits);
+    type = Type::Double;
+    return true;
+  }
+
+  // an immutable global can't change once it's defined, so it's a constant
+  bool global(int slot, Type& type) {
+    if (slot < 0 || static_cast<size_t>(slot) >= env.globals.size() ||
+        !env.defined[slot] || env.isMutable(slot))
+      return false;
+    return constant(env.globals[slot], type);
+  }
+
+  bool arithmetic(const ExpressionNode& lhs, char operation,
+                  const ExpressionNode& rhs, Type& type) {
+    Type left, right;
+    if (!expression(lhs, left)) return false;
+    a.push(A::RAX);
+    if (!expression(rhs, right)) return false;
+    a.mov(A::RCX, A::RAX);
+    a.pop(A::RAX);
+
+    if (left == Type::Int && right == Type::Int) {
+      type = Type::Int;
+      switch (operation) {
+        case '+':
+          a.add32(A::RAX, A::RCX);
+          return true;
+        case '-':
+          a.sub32(A::RAX, A::RCX);
+          return true;
+        case '*':
+          a.imul32(A::RAX, A::RCX);
+          return true;
+        case '/': {
+          // a zero divisor raises the interpreter's error. INT_MIN / -1
+          // would trap in idiv, the interpreter wraps it (Arithmetic::divide)
+          a.test32(A::RCX, A::RCX);
+          a.jump(A::Equal, bail);
+          const A::Label divide = a.newLabel();
+          a.cmpImm32(A::RCX, -1);
+          a.jump(A::NotEqual, divide);
+          a.cmpImm32(A::RAX, INT32_MIN);
+          a.jump(A::Equal, bail);
+          a.bind(divide);
+          a.cdq();
+          a.idiv32(A::RCX);
+          return true;
+        }
+        default:
+          return false;
+      }
+    }
+
+    type = Type::Double;
+    if (left == Type::Int)
+      a.cvtsi2sd(A::XMM0, A::RAX);
+    else
+      a.movq(A::XMM0, A::RAX);
+    if (right == Type::Int)
+      a.cvtsi2sd(A::XMM1, A::RCX);
+    else
+      a.movq(A::XMM1, A::RCX);
+
+    switch (operation) {
+      case '+':
+        a.sse(A::AddSd, A::XMM0, A::XMM1);
+        break;
+      case '-':
+        a.sse(A::SubSd, A::XMM0, A::XMM1);
+        break;
+      case '*':
+        a.sse(A::MulSd, A::XMM0, A::XMM1);
+        break;
+      case '/':
+        // equal is also set for a NaN, which the interpreter then handles
+        a.xorpd(A::XMM2, A::XMM2);
+        a.ucomisd(A::XMM1, A::XMM2);
+        a.jump(A::Equal, bail);
+        a.sse(A::DivSd, A::XMM0, A::XMM1);
+        break;
+      default:
+        return false;
+    }
+    a.movq(A::RAX, A::XMM0);
+    return true;
+  }
+
+  // a direct call of the callee's code specialized for these arguments. the
+  // callee is an immutable binding, so it's the same lambda on every call.
+  // piped is the type of the value in rax a pipeline stage takes first
+  bool call(const FunctionCallNode& call, const Type* piped, Type& type) {
+    if (call.builtIn >= 0 || call.local >= 0 || call.slot < 0 ||
+        static_cast<size_t>(call.slot) >= env.globals.size() ||
+        !env.defined[call.slot] || env.isMutable(call.slot) ||
+        !env.globals[call.slot].isLambda())
+      return false;
+    const LambdaNode& callee = *env.globals[call.slot].asLambda();
+    const size_t count = call.argumentCount();
+    // a cached lambda has to be called through its cache
+    if (callee.cache || count != callee.arguments.size() ||
+        count > Jit::MAX_ARGUMENTS)
+      return false;
+
+    // the arguments, then the result, at the top of the stack
+    const int32_t area = static_cast<int32_t>(8 * (count + 1));
+    a.subImm(A::RSP, area);
+    uint32_t calleeSignature = 0;
+    size_t i = 0;
+    if (piped) {
+      a.store(A::RSP, 0, A::RAX);
+      if (*piped == Type::Double) calleeSignature |= 1;
+      i++;
+    }
+    for (const ExpressionNode* arg : call.arguments) {
+      Type argType;
+      if (!expression(*arg, argType)) return false;
+      a.store(A::RSP, static_cast<int32_t>(8 * i), A::RAX);
+      if (argType == Type::Double) calleeSignature |= uint32_t(1) << i;
+      i++;
+    }
+
+    const NativeFunction* native =
+        ::compile(callee, calleeSignature, env, active);
+    if (!native) return false;
+    a.mov(A::RDI, A::RSP);
+    a.lea(A::RSI, A::RSP, area - 8);
+    a.movImm(A::RAX, reinterpret_cast<uint64_t>(native->code));
+    a.call(A::RAX);
+    a.test32(A::RAX, A::RAX);
+    a.jump(A::NotEqual, bail);
+    a.load(A::RAX, A::RSP, area - 8);
+    a.addImm(A::RSP, area);
+    type = native->returnsDouble ? Type::Double : Type::Int;
+    return true;
+  }
+
+  const LambdaNode& lambda;
+  const uint32_t signature;
+  Environment& env;
+  std::vector<const LambdaNode*>& active;  // being compiled, up the chain
+  std::vector<Type> locals;
+  Assembler a;
+  const Assembler::Label bail = a.newLabel();
+};
+
+// under compileMutex. a lambda that's already being compiled further up
+// can't be called, it would recurse forever anyway
+const NativeFunction* compile(const LambdaNode& lambda, uint32_t signature,
+                              Environment& env,
+                              std::vector<const LambdaNode*>& active) {
+  JitProfile& profile = lambda.jit;
+  auto it = profile.compiled.find(signature);
+  if (it != profile.compiled.end()) return it->second.get();
+  if (profile.unsupported.load(std::memory_order_relaxed)) return nullptr;
+  for (const LambdaNode* outer : active)
+    if (outer == &lambda) return nullptr;
+
+  active.push_back(&lambda);
+  std::unique_ptr<NativeFunction> native =
+      FunctionCompiler(lambda, signature, env, active).compile();
+  active.pop_back();
+
+  // whether a body compiles doesn't depend on the argument types
+  if (!native) profile.unsupported.store(true, std::memory_order_relaxed);
+  if (native) compiled++;
+  return (profile.compiled[signature] = std::move(native)).get();
+}
+
+}  // namespace
+
+void Jit::configure(JitMode mode) {
+  currentMode = available() ? mode : JitMode::Off;
+}
+
+JitMode Jit::mode() { return currentMode; }
+
+bool Jit::available() {
+#ifdef PALM_JIT
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool Jit::call(const LambdaNode& lambda, const Value* arguments, size_t count,
+               Environment& env, Value& result) {
+  if (currentMode == JitMode::Off) return false;
+  JitProfile& profile = lambda.jit;
+  if (profile.unsupported.load(std::memory_order_relaxed)) return false;
+  uint32_t signature;
+  if (!signatureOf(arguments, count, signature)) return false;
+
+  const NativeFunction* native = profile.entry.load(std::memory_order_acquire);
+  if (!native || native->signature != signature) {
+    // only calls with the same types in a row count towards compiling
+    if (profile.signature.load(std::memory_order_relaxed) != signature) {
+      profile.signature.store(signature, std::memory_order_relaxed);
+      profile.calls.store(0, std::memory_order_relaxed);
+    }
+    const uint32_t threshold = currentMode == JitMode::Eager ? 1 : THRESHOLD;
+    if (profile.calls.fetch_add(1, std::memory_order_relaxed) + 1 != threshold)
+      return false;
+    std::lock_guard<std::mutex> lock(compileMutex);
+    std::vector<const LambdaNode*> active;
+    native = compile(lambda, signature, env, active);
+    if (!native) return false;
+    profile.entry.store(native, std::memory_order_release);
+  }
+
+  uint64_t slots[MAX_ARGUMENTS];
+  for (size_t i = 0; i < count; i++) {
+    if (arguments[i].isInt()) {
+      slots[i] = static_cast<uint32_t>(arguments[i].asInt());
+    } else {
+      const double d = arguments[i].asDouble();
+      std::memcpy(&slots[i], &d, sizeof d);
+    }
+  }
+  uint64_t out;
+  if (native->code(slots, &out) != 0) {
+    bailouts++;
+    return false;
+  }
+  if (native->returnsDouble) {
+    double d;
+    std::memcpy(&d, &out, sizeof d);
+    result = Value(d);
+  } else {
+    result = Value(static_cast<int32_t>(static_cast<uint32_t>(out)));
+  }
+  return true;
+}
+
+size_t Jit::compiledCount() { return compiled.load(); }
+
+size_t Jit::bailoutCount() { return bailouts.load(); }
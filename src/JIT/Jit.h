@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+#include "../Types/Value.h"
+
+class LambdaNode;
+struct Environment;
+struct NativeFunction;  // see Jit.cpp
+
+enum class JitMode : uint8_t {
+  Off,    // every lambda is interpreted
+  On,     // lambdas are compiled once they're hot
+  Eager,  // on their first call
+};
+
+// what the JIT knows about one lambda, see Jit::call
+struct JitProfile {
+  static constexpr uint32_t NO_SIGNATURE = UINT32_MAX;
+
+  // the argument types of the latest calls and how many in a row had them
+  std::atomic<uint32_t> signature{NO_SIGNATURE};
+  std::atomic<uint32_t> calls{0};
+  // compiled for the signature calls currently come in with
+  std::atomic<const NativeFunction*> entry{nullptr};
+  // the body has something in it that can't be compiled
+  std::atomic<bool> unsupported{false};
+  // by signature, nullptr where compiling failed. only touched under the
+  // JIT's lock
+  std::unordered_map<uint32_t, std::unique_ptr<NativeFunction>> compiled;
+
+  JitProfile();
+  ~JitProfile();
+};
+
+/*
+the second tier: lambdas that only do int and double arithmetic, on their
+arguments, literals, immutable globals and through calls of other such
+lambdas, are compiled to x86-64 once they've been called THRESHOLD times in
+a row with the same argument types. the code is specialized for those types,
+calls with others keep being interpreted until a new set becomes hot.
+compiled code has no side effects, so wherever it can't reproduce the
+interpreter exactly (a division by zero, which has to raise the error) it
+bails out and the call is simply run again by the interpreter.
+elsewhere than on x86-64 everything is interpreted.
+*/
+class Jit {
+ public:
+  static constexpr uint32_t THRESHOLD = 1000;
+  static constexpr size_t MAX_ARGUMENTS = 16;
+
+  static void configure(JitMode mode);
+  static JitMode mode();
+  static bool available();
+
+  // runs the call natively if the lambda is, or just became, compiled for
+  // these arguments. false leaves it to the interpreter
+  static bool call(const LambdaNode& lambda, const Value* arguments,
+                   size_t count, Environment& env, Value& result);
+
+  static size_t compiledCount();  // native functions made so far
+  static size_t bailoutCount();   // native calls handed back
+};
@@ -3,133 +3,225 @@
 #include <iomanip>
 #include <iostream>
 
-const std::unordered_map<std::string, TokenType> Lexer::KEYWORDS = {
-    {"let", TokenType::LetKeyword}, {"mut", TokenType::MutableKeyword}};
+#include "../Runtime/Parallel.h"
+#include "../Runtime/Stream.h"
+#include "../Types/Arithmetic.h"
+#include "../Types/ArrayKernels.h"
+
+const std::unordered_map<Symbol, TokenType> Lexer::KEYWORDS = {
+    {Symbols::Let, TokenType::LetKeyword},
+    {Symbols::Mut, TokenType::MutableKeyword}};
 
 /*
 temporary way of defining all built-in functions
 (it's not great for more complex functions, but it works for print) ;-) :|
 */
-const std::unordered_map<std::string,
-                         std::function<Value(const std::vector<Value>&)>>
-    Lexer::BUILT_IN_FUNCTIONS = {
-        {"print",
-         [](const std::vector<Value>& args) {
+const BuiltInMap Lexer::BUILT_IN_FUNCTIONS = {
+        {intern("print"),
+         {[](Arguments args) {
+           Output& output = args.env ? *args.env->output : Output::standard();
+           std::lock_guard<std::mutex> guard(output.mutex);
+           std::ostream& out = output.stream;
            for (const auto& val : args) {
              if (val.isDouble()) {
                const int count = val.decimalCount();
-               std::cout << std::fixed << std::setprecision(count)
-                         << val.asDouble() << " ";
+               out << std::fixed << std::setprecision(count)
+                   << val.asDouble() << " ";
              } else if (val.isInt())
-               std::cout << val.asInt() << " ";
+               out << val.asInt() << " ";
+             else if (val.isArray() || val.isStream())
+               out << val.to_string() << " ";
            }
-           std::cout << std::endl;
+           out << std::endl;
            return Value{};
-         }},
-        {"PI",
-         [](const std::vector<Value>&) {
+         },
+         false}},
+        {intern("PI"),
+         {[](Arguments) {
            return Value(3.14159265358979323846);
-         }},
-        {"double",
-         [](const std::vector<Value>& args) {
+         },
+         true}},
+        {intern("double"),
+         {[](Arguments args) {
            if (args.size() != 1 || !args[0].isNumeric())
              throw std::runtime_error(
                  "double expects a single numeric argument");
-           return args[0].isInt() ? Value{args[0].asInt() * 2}
-                                  : Value{args[0].asDouble() * 2};
-         }},
-        {"decrement",
-         [](const std::vector<Value>& args) {
+           if (args[0].isInt())
+             return Value{Arithmetic::multiply(args[0].asInt(), 2)};
+           return Value{args[0].asDouble() * 2};
+         },
+         true}},
+        {intern("decrement"),
+         {[](Arguments args) {
            if (args.size() != 1 || !args[0].isNumeric())
              throw std::runtime_error(
                  "decrement expects a single numeric argument");
-           return args[0].isInt() ? Value(args[0].asInt() - 1)
-                                  : Value(args[0].asDouble() - 1);
-         }},
-        {"increment", [](const std::vector<Value>& args) {
+           if (args[0].isInt())
+             return Value(Arithmetic::subtract(args[0].asInt(), 1));
+           return Value(args[0].asDouble() - 1);
+         },
+         true}},
+        {intern("increment"),
+         {[](Arguments args) {
            if (args.size() != 1 || !args[0].isNumeric())
              throw std::runtime_error(
                  "increment expects a single numeric argument");
-           return args[0].isInt() ? Value{args[0].asInt() + 1}
-                                  : Value{args[0].asDouble() + 1};
-         }}};
+           if (args[0].isInt()) return Value{Arithmetic::add(args[0].asInt(), 1)};
+           return Value{args[0].asDouble() + 1};
+         },
+         true}},
+        // on a stream these run its lambdas, so they aren't pure
+        {intern("len"),
+         {[](Arguments args) {
+           if (args.size() == 1 && args[0].isStream() && args.env)
+             return Streams::length(args[0], *args.env);
+           if (args.size() != 1 || !args[0].isArray())
+             throw std::runtime_error("len expects a single array argument");
+           return Value(static_cast<int>(args[0].asArray().size));
+         },
+         false, true}},
+        {intern("sum"),
+         {[](Arguments args) {
+           if (args.size() == 1 && args[0].isStream() && args.env)
+             return Streams::sum(args[0], *args.env);
+           if (args.size() != 1 || !args[0].isArray())
+             throw std::runtime_error("sum expects a single array argument");
+           const ArrayObject& array = args[0].asArray();
+           return Value::number(
+               arrayKernels().sum(array.values.get(), array.size),
+               array.integral);
+         },
+         false, true}},
+        {intern("min"),
+         {[](Arguments args) {
+           if (args.size() == 1 && args[0].isStream() && args.env)
+             return Streams::min(args[0], *args.env);
+           if (args.size() != 1 || !args[0].isArray() ||
+               args[0].asArray().size == 0)
+             throw std::runtime_error(
+                 "min expects a single non-empty array argument");
+           const ArrayObject& array = args[0].asArray();
+           return Value::number(
+               arrayKernels().min(array.values.get(), array.size),
+               array.integral);
+         },
+         false, true}},
+        {intern("max"),
+         {[](Arguments args) {
+           if (args.size() == 1 && args[0].isStream() && args.env)
+             return Streams::max(args[0], *args.env);
+           if (args.size() != 1 || !args[0].isArray() ||
+               args[0].asArray().size == 0)
+             throw std::runtime_error(
+                 "max expects a single non-empty array argument");
+           const ArrayObject& array = args[0].asArray();
+           return Value::number(
+               arrayKernels().max(array.values.get(), array.size),
+               array.integral);
+         },
+         false, true}},
+        {intern("dot"),
+         {[](Arguments args) {
+           if (args.size() != 2 || !args[0].isArray() || !args[1].isArray())
+             throw std::runtime_error("dot expects two array arguments");
+           const ArrayObject& a = args[0].asArray();
+           const ArrayObject& b = args[1].asArray();
+           if (a.size != b.size)
+             throw std::runtime_error("Array length mismatch");
+           return Value::number(
+               arrayKernels().dot(a.values.get(), b.values.get(), a.size),
+               a.integral && b.integral);
+         },
+         true}},
+        // these call lambdas, which may print
+        {intern("map"), {Parallel::map, false, true}},
+        {intern("filter"), {Parallel::filter, false, true}},
+        {intern("reduce"), {Parallel::reduce, false, true}},
+        {intern("range"), {Streams::range, true}},
+        {intern("collect"),
+         {[](Arguments args) {
+           if (args.size() == 1 && args[0].isArray()) return args[0];
+           if (args.size() != 1 || !args[0].isStream() || !args.env)
+             throw std::runtime_error(
+                 "collect expects a single stream argument");
+           return Streams::collect(args[0], *args.env);
+         },
+         false, true}}};
 
-std::vector<Token> Lexer::tokenize(const std::string& code) {
-  std::vector<Token> tokens;
+TokenStream Lexer::tokenize(std::string_view code) {
+  TokenStream tokens(code);
   size_t pos = 0;
 
   while (pos < code.length()) {
     const char curr = code[pos];
     if (std::isdigit(curr))
-      tokens.push_back(readNumber(pos, code));
+      readNumber(pos, code, tokens);
     else if (std::isalpha(curr))
-      tokens.push_back(readIdentifierKeyword(pos, code));
+      readIdentifierKeyword(pos, code, tokens);
     else if (pos != code.length() - 1 &&
              (curr == '|' && code[pos + 1] == '>')) {
-      tokens.push_back({TokenType::Operator, "|>", static_cast<int>(pos)});
+      tokens.push(TokenType::Operator, pos, 2, Symbols::Pipe);
       pos += 2;
     } else if (pos != code.length() - 1 &&
                (curr == '=' && code[pos + 1] == '>')) {
-      tokens.push_back({TokenType::Operator, "=>", static_cast<int>(pos)});
+      tokens.push(TokenType::Operator, pos, 2, Symbols::Arrow);
       pos += 2;
     } else if (curr == ',') {
-      tokens.push_back({TokenType::Delimiter, ",", static_cast<int>(pos)});
-      pos++;
+      tokens.push(TokenType::Delimiter, pos++, 1, Symbols::Comma);
+    } else if (curr == ';') {
+      tokens.push(TokenType::Delimiter, pos++, 1, Symbols::Semicolon);
+    } else if (curr == '(') {
+      tokens.push(TokenType::Delimiter, pos++, 1, Symbols::LeftParen);
+    } else if (curr == ')') {
+      tokens.push(TokenType::Delimiter, pos++, 1, Symbols::RightParen);
+    } else if (curr == '[') {
+      tokens.push(TokenType::Delimiter, pos++, 1, Symbols::LeftBracket);
+    } else if (curr == ']') {
+      tokens.push(TokenType::Delimiter, pos++, 1, Symbols::RightBracket);
     } else if (curr == '%') {
-      tokens.push_back({TokenType::Operator, "%", static_cast<int>(pos)});
-      pos++;
+      tokens.push(TokenType::Operator, pos++, 1, Symbols::Percent);
     } else if (curr == '+') {
-      tokens.push_back({TokenType::Operator, "+", static_cast<int>(pos)});
-      pos++;
+      tokens.push(TokenType::Operator, pos++, 1, Symbols::Plus);
     } else if (curr == '-') {
-      tokens.push_back({TokenType::Operator, "-", static_cast<int>(pos)});
-      pos++;
+      tokens.push(TokenType::Operator, pos++, 1, Symbols::Minus);
     } else if (curr == '/') {
-      tokens.push_back({TokenType::Operator, "/", static_cast<int>(pos)});
-      pos++;
+      tokens.push(TokenType::Operator, pos++, 1, Symbols::Slash);
     } else if (curr == '*') {
-      tokens.push_back({TokenType::Operator, "*", static_cast<int>(pos)});
-      pos++;
+      tokens.push(TokenType::Operator, pos++, 1, Symbols::Star);
     } else if (curr == '=') {
-      tokens.push_back({TokenType::Operator, "=", static_cast<int>(pos)});
-      pos++;
-    } else if (curr == ';') {
-      tokens.push_back({TokenType::Delimiter, ";", static_cast<int>(pos)});
-      pos++;
-    } else if (curr == '(') {
-      tokens.push_back({TokenType::Delimiter, "(", static_cast<int>(pos)});
-      pos++;
-    } else if (curr == ')') {
-      tokens.push_back({TokenType::Delimiter, ")", static_cast<int>(pos)});
-      pos++;
+      tokens.push(TokenType::Operator, pos++, 1, Symbols::Equals);
     } else
       pos++;
   }
 
-  tokens.push_back({TokenType::EndOfFile, "EOF"});
+  tokens.push(TokenType::EndOfFile, pos, 0);
   return tokens;
 }
 
-Token Lexer::readNumber(size_t& pos, const std::string& code) {
-  std::string numberStr;
+void Lexer::readNumber(size_t& pos, std::string_view code,
+                       TokenStream& tokens) {
+  const size_t start = pos;
+  bool isDouble = false;
+  while (pos < code.length() && (isdigit(code[pos]) || code[pos] == '.'))
+    isDouble |= code[pos++] == '.';
 
-  while (isdigit(code[pos]) || code[pos] == '.') numberStr += code[pos++];
-
-  if (numberStr.find('.') != std::string::npos)
-    return {TokenType::Double, numberStr};
-  else
-    return {TokenType::Int, numberStr};
+  tokens.push(isDouble ? TokenType::Double : TokenType::Int, start,
+              pos - start);
 }
 
-Token Lexer::readIdentifierKeyword(size_t& pos, const std::string& code) {
-  std::string identifier;
-  while (pos < code.length() && std::isalnum(code[pos]))
-    identifier += code[pos++];
+void Lexer::readIdentifierKeyword(size_t& pos, std::string_view code,
+                                  TokenStream& tokens) {
+  const size_t start = pos;
+  while (pos < code.length() && std::isalnum(code[pos])) pos++;
+  const Symbol symbol = intern(code.substr(start, pos - start));
 
   // for now, list all keywords here
-  if (Lexer::KEYWORDS.find(identifier) != Lexer::KEYWORDS.end())
-    return Token{Lexer::KEYWORDS.at(identifier), identifier};
+  auto keyword = Lexer::KEYWORDS.find(symbol);
+  if (keyword != Lexer::KEYWORDS.end()) {
+    tokens.push(keyword->second, start, pos - start, symbol);
+    return;
+  }
 
   // if it doesn't match a key word, it's an identifier.
-  return {TokenType::Identifier, identifier};
+  tokens.push(TokenType::Identifier, start, pos - start, symbol);
 }
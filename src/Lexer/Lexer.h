@@ -9,12 +9,12 @@
 class Lexer
 {
 public:
-	const static std::unordered_map<std::string, TokenType> KEYWORDS;
-	const static std::unordered_map<std::string,
-		std::function<Value(const std::vector<Value>&)>> BUILT_IN_FUNCTIONS;
+	const static std::unordered_map<Symbol, TokenType> KEYWORDS;
+	const static BuiltInMap BUILT_IN_FUNCTIONS;  // keyed by interned name
 public:
-	static std::vector<Token> tokenize(const std::string& code);
+	// the returned stream points into code, which has to outlive it
+	static TokenStream tokenize(std::string_view code);
 private:
-	static Token readNumber(size_t& pos, const std::string& code);
-	static Token readIdentifierKeyword(size_t& pos, const std::string& code);
+	static void readNumber(size_t& pos, std::string_view code, TokenStream& tokens);
+	static void readIdentifierKeyword(size_t& pos, std::string_view code, TokenStream& tokens);
 };
\ No newline at end of file
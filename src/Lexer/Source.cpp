@@ -0,0 +1,94 @@
+#include "Source.h"
+
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PALM_HAS_MMAP 1
+#else
+#include <fstream>
+#include <sstream>
+#endif
+
+std::unique_ptr<Source> Source::open(const std::string& path, bool mapped,
+                                     size_t chunkSize) {
+  if (path == "-")
+    return std::make_unique<StreamSource>(stdin, false, chunkSize);
+  if (mapped) return std::make_unique<MappedFileSource>(path);
+  std::FILE* file = std::fopen(path.c_str(), "rb");
+  if (!file) throw std::runtime_error("Could not open " + path);
+  return std::make_unique<StreamSource>(file, true, chunkSize);
+}
+
+StreamSource::StreamSource(std::FILE* file, bool owned, size_t chunkSize)
+    : file(file), owned(owned), buffer(chunkSize) {
+#ifdef PALM_HAS_MMAP
+  struct stat info;
+  partial = ::fstat(fileno(file), &info) != 0 || !S_ISREG(info.st_mode);
+#endif
+}
+
+std::string_view StreamSource::read() {
+#ifdef PALM_HAS_MMAP
+  // fread waits for a full buffer, on a pipe that holds back statements
+  // that have already arrived until the writer sends 64 KiB or closes it
+  if (partial) {
+    for (;;) {
+      const ssize_t count = ::read(fileno(file), buffer.data(), buffer.size());
+      if (count >= 0) return std::string_view(buffer.data(), count);
+      if (errno != EINTR) throw std::runtime_error("Error while reading input");
+    }
+  }
+#endif
+  const size_t count = std::fread(buffer.data(), 1, buffer.size(), file);
+  if (count == 0 && std::ferror(file))
+    throw std::runtime_error("Error while reading input");
+  return std::string_view(buffer.data(), count);
+}
+
+#ifdef PALM_HAS_MMAP
+
+MappedFileSource::MappedFileSource(const std::string& path) {
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) throw std::runtime_error("Could not open " + path);
+  struct stat info;
+  if (::fstat(fd, &info) != 0) {
+    ::close(fd);
+    throw std::runtime_error("Could not stat " + path);
+  }
+  size = static_cast<size_t>(info.st_size);
+  if (size > 0) {
+    void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+      ::close(fd);
+      throw std::runtime_error("Could not map " + path);
+    }
+    ::madvise(mapping, size, MADV_SEQUENTIAL);
+    data = static_cast<const char*>(mapping);
+  }
+  ::close(fd);
+}
+
+MappedFileSource::~MappedFileSource() {
+  if (data) ::munmap(const_cast<char*>(data), size);
+}
+
+#else
+
+MappedFileSource::MappedFileSource(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) throw std::runtime_error("Could not open " + path);
+  std::ostringstream contents;
+  contents << file.rdbuf();
+  fallback = contents.str();
+  data = fallback.data();
+  size = fallback.size();
+}
+
+MappedFileSource::~MappedFileSource() = default;
+
+#endif
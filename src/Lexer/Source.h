@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// where program text comes from, read a chunk at a time
+class Source {
+ public:
+  virtual ~Source() = default;
+
+  // the next chunk of input, empty once everything has been read. the view
+  // stays valid until the next call
+  virtual std::string_view read() = 0;
+
+  // a file, "-" for stdin. mapped files are handed out as one zero-copy
+  // chunk, everything else is read in chunks of chunkSize bytes
+  static std::unique_ptr<Source> open(const std::string& path,
+                                      bool mapped = false,
+                                      size_t chunkSize = 64 * 1024);
+};
+
+// code that's already in memory
+class StringSource : public Source {
+ public:
+  explicit StringSource(std::string_view code) : code(code) {}
+  std::string_view read() override {
+    std::string_view chunk = code;
+    code = {};
+    return chunk;
+  }
+
+ private:
+  std::string_view code;
+};
+
+// stdin or a regular file through stdio. pipes and terminals are read with
+// whatever has arrived so far, so a chunk can be shorter than chunkSize
+// before the end of the input
+class StreamSource : public Source {
+ public:
+  StreamSource(std::FILE* file, bool owned, size_t chunkSize);
+  ~StreamSource() override {
+    if (owned) std::fclose(file);
+  }
+  std::string_view read() override;
+
+ private:
+  std::FILE* file;
+  bool owned;
+  bool partial = false;  // not a regular file, see read()
+  std::vector<char> buffer;
+};
+
+// a read-only memory mapping of a whole file
+class MappedFileSource : public Source {
+ public:
+  explicit MappedFileSource(const std::string& path);
+  ~MappedFileSource() override;
+  std::string_view read() override {
+    std::string_view chunk(data, consumed ? 0 : size);
+    consumed = true;
+    return chunk;
+  }
+
+ private:
+  const char* data = nullptr;
+  size_t size = 0;
+  bool consumed = false;
+  std::string fallback;  // where mmap isn't available
+};
@@ -0,0 +1,49 @@
+#include "StatementReader.h"
+
+bool StatementReader::refill() {
+  if (exhausted) return false;
+  consumed += chunk.size();
+  chunk = source.read();
+  pos = 0;
+  if (chunk.empty()) exhausted = true;
+  return !exhausted;
+}
+
+bool StatementReader::next(std::string_view& statement) {
+  pending.clear();
+  int depth = 0;
+
+  for (;;) {
+    if (pos >= chunk.size()) {
+      // keep what we have, the chunk gets replaced
+      if (!refill()) break;
+      continue;
+    }
+
+    const size_t start = pos;
+    if (pending.empty()) statementStart = consumed + start;
+    while (pos < chunk.size()) {
+      const char c = chunk[pos++];
+      if (c == '(')
+        depth++;
+      else if (c == ')')
+        depth--;
+      else if (c == ';' && depth <= 0) {
+        if (pending.empty()) {
+          statement = chunk.substr(start, pos - start);
+        } else {
+          pending.append(chunk.substr(start, pos - start));
+          statement = pending;
+        }
+        return true;
+      }
+    }
+    pending.append(chunk.substr(start));
+  }
+
+  // whatever is left has no terminating `;`, let the parser complain about
+  // it unless it's just trailing whitespace
+  if (pending.find_first_not_of(" \t\r\n") == std::string::npos) return false;
+  statement = pending;
+  return true;
+}
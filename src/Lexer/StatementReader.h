@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "Source.h"
+
+/*
+pulls chunks from a Source and cuts them into top-level statements, so each
+one can be lexed, parsed and run before the rest of the input is read. a
+statement ends at a `;` outside of any parentheses. statements that fit in
+one chunk are handed out as views into it, only the ones spanning a chunk
+boundary get copied.
+*/
+class StatementReader {
+ public:
+  explicit StatementReader(Source& source) : source(source) {}
+
+  // the next statement, valid until the next call. false at end of input
+  bool next(std::string_view& statement);
+  // where the last statement started in the whole input
+  size_t offset() const { return statementStart; }
+
+ private:
+  bool refill();
+
+  Source& source;
+  std::string_view chunk;
+  size_t pos = 0;
+  size_t consumed = 0;  // the size of the chunks before this one
+  size_t statementStart = 0;
+  std::string pending;  // the start of a statement from an earlier chunk
+  bool exhausted = false;
+};
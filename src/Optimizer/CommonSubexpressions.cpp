@@ -0,0 +1,196 @@
+#include "CommonSubexpressions.h"
+
+#include <cstring>
+
+// a key holds its numbers as raw bytes, each part has a fixed size
+template <typename T>
+static void append(std::string& key, T value) {
+  char bytes[sizeof value];
+  std::memcpy(bytes, &value, sizeof value);
+  key.append(bytes, sizeof value);
+}
+
+bool CommonSubexpressions::runStatement(ASTNode*& statement,
+                                        PassContext& context) {
+  // an expression statement that isn't a call or a pipeline never runs
+  if (statement->as<ExpressionNode>() && !statement->as<FunctionCallNode>() &&
+      !statement->as<PipelineNode>())
+    return false;
+
+  bool changed = false;
+  forEachRoot(statement, [&](ExpressionNode*& root, int frameSize) {
+    changed |= eliminate(root, frameSize, context);
+  });
+  return changed;
+}
+
+bool CommonSubexpressions::eliminate(ExpressionNode*& root, int frameSize,
+                                     PassContext& context) {
+  if (root->as<LocalBindingNode>()) return false;  // done already
+
+  // smallest repeated expression first, so larger ones that contain it are
+  // found again with the temporary in its place
+  std::vector<ExpressionNode*> values;
+  for (;;) {
+    Walk walk{context, {}, {}, false};
+    size_t size = 0;
+    collect(root, walk, size);
+
+    const Candidate* best = nullptr;
+    for (const Candidate& candidate : walk.candidates) {
+      if (candidate.occurrences.size() < 2 || !candidate.safe) continue;
+      if (!best || candidate.size < best->size) best = &candidate;
+    }
+    if (!best) break;
+
+    const int local = frameSize + static_cast<int>(values.size());
+    const Symbol name = intern("$" + std::to_string(local));
+    values.push_back(*best->occurrences.front());
+    for (ExpressionNode** occurrence : best->occurrences) {
+      VariableNode* temporary = context.arena.make<VariableNode>(name);
+      temporary->local = local;
+      *occurrence = temporary;
+    }
+  }
+
+  // the first temporary is bound outermost, later ones may read it
+  for (size_t i = values.size(); i-- > 0;)
+    root = context.arena.make<LocalBindingNode>(
+        frameSize + static_cast<int>(i), values[i], root);
+  return !values.empty();
+}
+
+// returns the value number of node, NONE if evaluating it has side effects.
+// size is the number of nodes under it
+int CommonSubexpressions::collect(ExpressionNode*& node, Walk& walk,
+                                  size_t& size) {
+  std::string key;
+  int number = NONE;  // calls are numbered by collectCall
+  bool candidate = false;
+  size = 1;
+
+  if (auto literal = node->as<NumberNode>()) {
+    if (literal->value.isInt()) {
+      key = 'i';
+      append(key, literal->value.asInt());
+    } else if (literal->value.isDouble()) {
+      key = 'd';
+      append(key, literal->value.asDouble());
+    } else {
+      return NONE;
+    }
+  } else if (auto variable = node->as<VariableNode>()) {
+    key = variable->local >= 0 ? 'l' : 'g';
+    append(key, variable->local >= 0 ? variable->local : variable->slot);
+  } else if (auto binary = node->as<BinaryOperationNode>()) {
+    size_t leftSize = 0, rightSize = 0;
+    const int left = collect(binary->left, walk, leftSize);
+    const int right = collect(binary->right, walk, rightSize);
+    size += leftSize + rightSize;
+    if (left == NONE || right == NONE) return NONE;
+    key = binary->operation;
+    append(key, left);
+    append(key, right);
+    candidate = true;
+  } else if (auto unary = node->as<UnaryOperationNode>()) {
+    size_t operandSize = 0;
+    const int operand = collect(unary->operand, walk, operandSize);
+    size += operandSize;
+    if (operand == NONE) return NONE;
+    key = 'u';
+    key += unary->op;
+    append(key, operand);
+    candidate = size >= 3;  // negating a leaf is cheaper than a temporary
+  } else if (auto call = node->as<FunctionCallNode>()) {
+    number = collectCall(*call, walk, size);
+    if (number == NONE) return NONE;
+    candidate = true;
+  } else if (auto pipeline = node->as<PipelineNode>()) {
+    size_t sourceSize = 0;
+    const int source = collect(pipeline->source, walk, sourceSize);
+    size += sourceSize;
+    // the stages still run, and their own arguments can be shared
+    bool pure = source != NONE;
+    key = 'p';
+    append(key, source);
+    for (FunctionCallNode* stage : pipeline->stages) {
+      size_t stageSize = 0;
+      const int stageNumber = collectCall(*stage, walk, stageSize);
+      size += stageSize;
+      pure = pure && stageNumber != NONE;
+      append(key, stageNumber);
+    }
+    if (!pure) return NONE;
+    candidate = true;
+  } else if (auto array = node->as<ArrayNode>()) {
+    key = 'a';
+    bool keyed = true;
+    for (ExpressionNode*& element : array->elements) {
+      size_t elementSize = 0;
+      const int elementNumber = collect(element, walk, elementSize);
+      size += elementSize;
+      keyed = keyed && elementNumber != NONE;
+      append(key, elementNumber);
+    }
+    if (!keyed) return NONE;
+    candidate = true;
+  } else if (auto index = node->as<IndexNode>()) {
+    size_t arraySize = 0, indexSize = 0;
+    const int array = collect(index->array, walk, arraySize);
+    const int position = collect(index->index, walk, indexSize);
+    size += arraySize + indexSize;
+    if (array == NONE || position == NONE) return NONE;
+    key = 'x';
+    append(key, array);
+    append(key, position);
+    candidate = true;
+  } else {
+    // bindings from an earlier run and anything unknown stay opaque
+    walk.impure = true;
+    return NONE;
+  }
+
+  if (number == NONE) number = valueNumber(key, walk);
+  if (candidate) {
+    Candidate& entry = walk.candidates[number];
+    if (entry.occurrences.empty()) {
+      entry.size = size;
+      entry.safe = !walk.impure;
+    }
+    entry.occurrences.push_back(&node);
+  }
+  return number;
+}
+
+// the number of a call to a pure built-in, NONE otherwise. a piped stage has
+// the value coming in as its first argument, which the pipeline numbers
+int CommonSubexpressions::collectCall(FunctionCallNode& call, Walk& walk,
+                                      size_t& size) {
+  std::string key = call.piped ? "|" : "(";
+  append(key, call.builtIn);
+  bool pure = call.builtIn >= 0 &&
+              walk.context.builtIns
+                  .at(walk.context.tables.builtIns[call.builtIn])
+                  .pure;
+  size = 1;
+  for (ExpressionNode*& arg : call.arguments) {
+    size_t argSize = 0;
+    const int argNumber = collect(arg, walk, argSize);
+    size += argSize;
+    pure = pure && argNumber != NONE;
+    append(key, argNumber);
+  }
+  if (!pure) {
+    walk.impure = true;
+    return NONE;
+  }
+  return valueNumber(key, walk);
+}
+
+// the same key always gets the same number, a new key the next one
+int CommonSubexpressions::valueNumber(const std::string& key, Walk& walk) {
+  auto [entry, added] = walk.numbers.try_emplace(
+      key, static_cast<int>(walk.candidates.size()));
+  if (added) walk.candidates.emplace_back();
+  return entry->second;
+}
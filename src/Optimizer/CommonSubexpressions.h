@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Pass.h"
+
+/*
+evaluates a pure subexpression that shows up more than once in a statement
+or lambda body only once. the value is bound to a frame local by a
+LocalBindingNode at the root and every occurrence becomes a read of it.
+equal subexpressions are found by value numbering: a node's key is its
+operation and the numbers of its operands, so keys stay a few bytes however
+deep the expression is.
+*/
+class CommonSubexpressions : public Pass {
+ public:
+  const char* name() const override { return "common-subexpressions"; }
+  bool runStatement(ASTNode*& statement, PassContext& context) override;
+
+ private:
+  static constexpr int NONE = -1;  // the number of what can't be shared
+
+  // by value number, which is also the order they were first seen in
+  struct Candidate {
+    size_t size = 0;
+    bool safe = true;  // nothing with side effects runs before it
+    std::vector<ExpressionNode**> occurrences;  // in evaluation order
+  };
+
+  struct Walk {
+    PassContext& context;
+    std::unordered_map<std::string, int> numbers;  // key -> value number
+    std::vector<Candidate> candidates;
+    bool impure = false;  // a side effect has been evaluated so far
+  };
+
+  bool eliminate(ExpressionNode*& root, int frameSize, PassContext& context);
+  int collect(ExpressionNode*& node, Walk& walk, size_t& size);
+  int collectCall(FunctionCallNode& call, Walk& walk, size_t& size);
+  static int valueNumber(const std::string& key, Walk& walk);
+};
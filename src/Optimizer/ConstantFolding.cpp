@@ -0,0 +1,129 @@
+#include "ConstantFolding.h"
+
+#include <stdexcept>
+
+static bool isLiteral(const ExpressionNode* node) {
+  return node->as<NumberNode>() != nullptr;
+}
+
+bool ConstantFolding::runStatement(ASTNode*& statement, PassContext& context) {
+  bool changed = false;
+  forEachRoot(statement, [&](ExpressionNode*& root, int) {
+    changed |= fold(root, context);
+  });
+  return changed;
+}
+
+bool ConstantFolding::fold(ExpressionNode*& node, PassContext& context) {
+  bool changed = false;
+  Value value;
+  if (auto binary = node->as<BinaryOperationNode>()) {
+    changed |= fold(binary->left, context);
+    changed |= fold(binary->right, context);
+    if (!isLiteral(binary->left) || !isLiteral(binary->right)) return changed;
+    // going through evaluate keeps the semantics identical to the walker
+    try {
+      value = binary->evaluate(scratch);
+    } catch (const std::runtime_error&) {
+      return changed;
+    }
+  } else if (auto unary = node->as<UnaryOperationNode>()) {
+    changed |= fold(unary->operand, context);
+    if (!isLiteral(unary->operand)) return changed;
+    try {
+      value = unary->evaluate(scratch);
+    } catch (const std::runtime_error&) {
+      return changed;
+    }
+  } else if (auto call = node->as<FunctionCallNode>()) {
+    for (ExpressionNode*& arg : call->arguments) changed |= fold(arg, context);
+    if (!foldCall(*call, nullptr, context, value)) return changed;
+  } else if (auto pipeline = node->as<PipelineNode>()) {
+    return foldPipeline(node, *pipeline, context);
+  } else if (auto array = node->as<ArrayNode>()) {
+    // a literal array becomes one constant instead of being built each time
+    bool literal = true;
+    for (ExpressionNode*& element : array->elements) {
+      changed |= fold(element, context);
+      literal = literal && isLiteral(element);
+    }
+    if (!literal) return changed;
+    try {
+      value = array->evaluate(scratch);
+    } catch (const std::runtime_error&) {
+      return changed;
+    }
+  } else if (auto index = node->as<IndexNode>()) {
+    changed |= fold(index->array, context);
+    changed |= fold(index->index, context);
+    if (!isLiteral(index->array) || !isLiteral(index->index)) return changed;
+    try {
+      value = index->evaluate(scratch);
+    } catch (const std::runtime_error&) {
+      return changed;
+    }
+  } else if (auto binding = node->as<LocalBindingNode>()) {
+    changed |= fold(binding->value, context);
+    changed |= fold(binding->body, context);
+    return changed;
+  } else {
+    return false;
+  }
+
+  if (!value.isNumeric() && !value.isArray()) return changed;
+  node = context.arena.make<NumberNode>(value);
+  return true;
+}
+
+// stages are folded from the front for as long as the value is a literal
+bool ConstantFolding::foldPipeline(ExpressionNode*& node,
+                                   PipelineNode& pipeline,
+                                   PassContext& context) {
+  bool changed = fold(pipeline.source, context);
+  for (FunctionCallNode* stage : pipeline.stages)
+    for (ExpressionNode*& arg : stage->arguments) changed |= fold(arg, context);
+
+  size_t folded = 0;
+  Value value;
+  while (folded < pipeline.stages.size() && isLiteral(pipeline.source)) {
+    const Value& piped = static_cast<NumberNode*>(pipeline.source)->value;
+    if (!foldCall(*pipeline.stages[folded], &piped, context, value) ||
+        (!value.isNumeric() && !value.isArray()))
+      break;
+    pipeline.source = context.arena.make<NumberNode>(value);
+    folded++;
+  }
+  if (folded == 0) return changed;
+
+  if (folded == pipeline.stages.size()) {
+    node = pipeline.source;
+  } else {
+    std::vector<FunctionCallNode*> rest(pipeline.stages.begin() + folded,
+                                        pipeline.stages.end());
+    pipeline.stages = NodeList<FunctionCallNode>(context.arena, rest);
+  }
+  return true;
+}
+
+// the result of a pure built-in on literal arguments, false if it isn't one
+// or if it throws
+bool ConstantFolding::foldCall(const FunctionCallNode& call, const Value* piped,
+                               PassContext& context, Value& result) {
+  if (call.builtIn < 0) return false;
+  const BuiltIn& builtIn =
+      context.builtIns.at(context.tables.builtIns[call.builtIn]);
+  if (!builtIn.pure) return false;
+
+  std::vector<Value> args;
+  if (piped) args.push_back(*piped);
+  for (const ExpressionNode* arg : call.arguments) {
+    if (!isLiteral(arg)) return false;
+    args.push_back(static_cast<const NumberNode*>(arg)->value);
+  }
+  try {
+    result = builtIn.function({args.data(), args.size()});
+  } catch (const std::runtime_error&) {
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Pass.h"
+
+/*
+replaces arithmetic on literals and calls of pure built-ins with literal
+arguments by their result. anything that would throw is left in place so the
+error still shows up at runtime, in order.
+*/
+class ConstantFolding : public Pass {
+ public:
+  const char* name() const override { return "constant-folding"; }
+  bool runStatement(ASTNode*& statement, PassContext& context) override;
+
+ private:
+  bool fold(ExpressionNode*& node, PassContext& context);
+  bool foldPipeline(ExpressionNode*& node, PipelineNode& pipeline,
+                    PassContext& context);
+  static bool foldCall(const FunctionCallNode& call, const Value* piped,
+                       PassContext& context, Value& result);
+
+ private:
+  Environment scratch{0, {}};  // operations on literals never touch it
+};
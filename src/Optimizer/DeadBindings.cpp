@@ -0,0 +1,64 @@
+#include "DeadBindings.h"
+
+#include <algorithm>
+
+bool DeadBindings::run(ProgramNode& program, PassContext&) {
+  bool changed = false;
+  for (;;) {
+    std::vector<size_t> uses(program.globals.size(), 0);
+    for (ASTNode*& statement : program.statements) {
+      auto decl = statement->as<VariableDeclarationNode>();
+      const bool isLambda = decl && decl->lambdaExpr.has_value();
+      const size_t before = isLambda ? uses[decl->slot] : 0;
+      forEachRoot(statement, [&](ExpressionNode*& root, int) {
+        countUses(*root, uses);
+      });
+      // a lambda calling itself doesn't keep itself alive
+      if (isLambda) uses[decl->slot] = before;
+    }
+
+    auto dead = [&](const ASTNode* statement) {
+      auto decl = statement->as<VariableDeclarationNode>();
+      return decl && !decl->mut && uses[decl->slot] == 0 &&
+             isRemovable(*decl);
+    };
+    auto end = std::remove_if(program.statements.begin(),
+                              program.statements.end(), dead);
+    if (end == program.statements.end()) return changed;
+    program.statements.erase(end, program.statements.end());
+    changed = true;
+  }
+}
+
+void DeadBindings::countUses(const ExpressionNode& node,
+                             std::vector<size_t>& uses) {
+  if (auto variable = node.as<VariableNode>()) {
+    if (variable->local < 0) uses[variable->slot]++;
+  } else if (auto binary = node.as<BinaryOperationNode>()) {
+    countUses(*binary->left, uses);
+    countUses(*binary->right, uses);
+  } else if (auto unary = node.as<UnaryOperationNode>()) {
+    countUses(*unary->operand, uses);
+  } else if (auto call = node.as<FunctionCallNode>()) {
+    if (call->builtIn < 0 && call->local < 0) uses[call->slot]++;
+    for (const ExpressionNode* arg : call->arguments) countUses(*arg, uses);
+  } else if (auto pipeline = node.as<PipelineNode>()) {
+    countUses(*pipeline->source, uses);
+    for (const FunctionCallNode* stage : pipeline->stages)
+      countUses(*stage, uses);
+  } else if (auto array = node.as<ArrayNode>()) {
+    for (const ExpressionNode* element : array->elements)
+      countUses(*element, uses);
+  } else if (auto index = node.as<IndexNode>()) {
+    countUses(*index->array, uses);
+    countUses(*index->index, uses);
+  } else if (auto binding = node.as<LocalBindingNode>()) {
+    countUses(*binding->value, uses);
+    countUses(*binding->body, uses);
+  }
+}
+
+bool DeadBindings::isRemovable(const VariableDeclarationNode& decl) {
+  if (decl.lambdaExpr.has_value() || !decl.expression.has_value()) return true;
+  return (*decl.expression)->as<NumberNode>() != nullptr;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <vector>
+
+#include "Pass.h"
+
+/*
+drops immutable top-level bindings nothing reads, as long as creating them
+can't fail or have side effects (literals, lambdas and empty declarations).
+runs to a fixpoint, so a lambda only used by another dead lambda goes too.
+needs the whole program, a streamed statement could be used later.
+*/
+class DeadBindings : public Pass {
+ public:
+  const char* name() const override { return "dead-bindings"; }
+  bool run(ProgramNode& program, PassContext& context) override;
+
+ private:
+  static void countUses(const ExpressionNode& node, std::vector<size_t>& uses);
+  static bool isRemovable(const VariableDeclarationNode& decl);
+};
@@ -0,0 +1,398 @@
+#include "Inliner.h"
+
+#include <algorithm>
+
+bool Inliner::runStatement(ASTNode*& statement, PassContext& context) {
+  auto decl = statement->as<VariableDeclarationNode>();
+  caller = decl && decl->lambdaExpr.has_value() ? decl->name : NO_SYMBOL;
+
+  // an expression statement is run with visit(), which skips everything
+  // but calls and pipelines
+  ExpressionNode* const alone = statement->as<ExpressionNode>();
+  bool changed = false;
+  forEachRoot(statement, [&](ExpressionNode*& root, int) {
+    ExpressionNode* const original = root;
+    changed |= inlineCalls(root, context);
+    if (original != alone || root->as<FunctionCallNode>() ||
+        root->as<PipelineNode>())
+      return;
+    // its arguments keep what was inlined into them
+    root = original;
+    if (auto call = original->as<FunctionCallNode>())
+      note(call->functionName, "a statement on its own, left as a call");
+  });
+
+  // later statements may inline this one, a mutable binding could change.
+  // calls of a cached lambda have to stay calls to go through its cache
+  if (decl && decl->lambdaExpr.has_value() && !decl->mut &&
+      !(*decl->lambdaExpr)->cache) {
+    const LambdaNode* lambda = *decl->lambdaExpr;
+    if (ExpressionNode* body = clone(*lambda->body, context.arena))
+      callees[decl->slot] = {lambda, body, size(*body)};
+  }
+  return changed;
+}
+
+// bottom up, so arguments are as simple as they'll get before their call is
+// looked at. a body copied in is only looked at again for the calls it
+// makes through lambdas that were passed to it
+bool Inliner::inlineCalls(ExpressionNode*& node, PassContext& context,
+                          int depth) {
+  bool changed = false;
+  if (auto binary = node->as<BinaryOperationNode>()) {
+    changed |= inlineCalls(binary->left, context, depth);
+    changed |= inlineCalls(binary->right, context, depth);
+  } else if (auto unary = node->as<UnaryOperationNode>()) {
+    changed |= inlineCalls(unary->operand, context, depth);
+  } else if (auto binding = node->as<LocalBindingNode>()) {
+    changed |= inlineCalls(binding->value, context, depth);
+    changed |= inlineCalls(binding->body, context, depth);
+  } else if (auto array = node->as<ArrayNode>()) {
+    for (ExpressionNode*& element : array->elements)
+      changed |= inlineCalls(element, context, depth);
+  } else if (auto index = node->as<IndexNode>()) {
+    changed |= inlineCalls(index->array, context, depth);
+    changed |= inlineCalls(index->index, context, depth);
+  } else if (auto pipeline = node->as<PipelineNode>()) {
+    return inlinePipeline(node, *pipeline, context, depth);
+  } else if (auto call = node->as<FunctionCallNode>()) {
+    for (ExpressionNode*& arg : call->arguments)
+      changed |= inlineCalls(arg, context, depth);
+    if (call->builtIn >= 0 || call->local >= 0) return changed;
+    auto callee = callees.find(call->slot);
+    if (callee == callees.end()) return changed;
+    bool throughArgument = false;
+    if (ExpressionNode* body =
+            expand(*call, callee->second, context, throughArgument)) {
+      node = body;
+      if (throughArgument && depth < MAX_DEPTH)
+        inlineCalls(node, context, depth + 1);
+      return true;
+    }
+  }
+  return changed;
+}
+
+// a stage is expanded as a plain call taking what the stages before it
+// produce. the stages that stay are kept in a shorter pipeline
+bool Inliner::inlinePipeline(ExpressionNode*& node, PipelineNode& pipeline,
+                             PassContext& context, int depth) {
+  bool changed = inlineCalls(pipeline.source, context, depth);
+  bool inlined = false;
+  ExpressionNode* current = pipeline.source;
+  std::vector<FunctionCallNode*> pending;
+  for (FunctionCallNode* stage : pipeline.stages) {
+    for (ExpressionNode*& arg : stage->arguments)
+      changed |= inlineCalls(arg, context, depth);
+    auto callee = stage->builtIn < 0 && stage->local < 0
+                      ? callees.find(stage->slot)
+                      : callees.end();
+    if (callee == callees.end()) {
+      pending.push_back(stage);
+      continue;
+    }
+
+    std::vector<ExpressionNode*> args{
+        pending.empty() ? current
+                        : context.arena.make<PipelineNode>(
+                              current, NodeList<FunctionCallNode>(
+                                           context.arena, pending))};
+    args.insert(args.end(), stage->arguments.begin(), stage->arguments.end());
+    FunctionCallNode call(stage->functionName,
+                          NodeList<ExpressionNode>(context.arena, args));
+    call.slot = stage->slot;
+
+    bool throughArgument = false;
+    ExpressionNode* body =
+        expand(call, callee->second, context, throughArgument);
+    if (!body) {
+      pending.push_back(stage);
+      continue;
+    }
+    if (throughArgument && depth < MAX_DEPTH)
+      inlineCalls(body, context, depth + 1);
+    current = body;
+    pending.clear();
+    inlined = true;
+  }
+  if (!inlined) return changed;
+
+  node = pending.empty()
+             ? current
+             : context.arena.make<PipelineNode>(
+                   current, NodeList<FunctionCallNode>(context.arena, pending));
+  return true;
+}
+
+ExpressionNode* Inliner::expand(const FunctionCallNode& call,
+                                const Callee& callee, PassContext& context,
+                                bool& throughArgument) {
+  const LambdaNode& lambda = *callee.lambda;
+  if (call.arguments.size() != lambda.arguments.size()) {
+    note(call.functionName, "argument count mismatch, left for runtime");
+    return nullptr;
+  }
+  if (callee.size > MAX_BODY_SIZE) {
+    note(call.functionName, "body too large (", callee.size, " nodes)");
+    return nullptr;
+  }
+
+  std::vector<size_t> uses(lambda.arguments.size(), 0);
+  std::vector<size_t> calls(lambda.arguments.size(), 0);
+  countUses(*callee.body, uses, calls);
+  for (size_t count : calls) throughArgument = throughArgument || count > 0;
+  size_t expanded = callee.size;
+  for (size_t i = 0; i < call.arguments.size(); i++) {
+    const ExpressionNode& arg = *call.arguments[i];
+    if (!isPure(arg, context)) {
+      note(call.functionName, "argument ", i + 1, " has side effects");
+      return nullptr;
+    }
+    const size_t argSize = size(arg);
+    // dropping it would also drop any error evaluating it raises
+    if (uses[i] == 0 && argSize > 1) {
+      note(call.functionName, "argument ", i + 1, " is unused");
+      return nullptr;
+    }
+    expanded += uses[i] * (argSize - 1);
+  }
+  // the arguments that can raise an error, in the order they're passed
+  std::vector<int> order;
+  for (size_t i = 0; i < call.arguments.size(); i++)
+    if (!call.arguments[i]->as<NumberNode>() &&
+        !call.arguments[i]->as<VariableNode>())
+      order.push_back(static_cast<int>(i));
+  size_t next = 0;
+  if (!argumentsFirst(*callee.body, order, next) || next < order.size()) {
+    note(call.functionName,
+         "arguments that can fail would be evaluated out of order");
+    return nullptr;
+  }
+  if (expanded > MAX_EXPANDED_SIZE) {
+    note(call.functionName, "too large once expanded (", expanded, " nodes)");
+    return nullptr;
+  }
+
+  ExpressionNode* body =
+      substitute(*callee.body, &call.arguments, context.arena);
+  if (!body) {
+    note(call.functionName, "calls an argument that isn't a name");
+    return nullptr;
+  }
+  note(call.functionName, "inlined (", expanded, " nodes)");
+  return body;
+}
+
+// a copy of node with the callee's parameters replaced by copies of the
+// arguments, or a plain copy without arguments. nullptr if it can't be done
+ExpressionNode* Inliner::substitute(const ExpressionNode& node,
+                                    const NodeList<ExpressionNode>* arguments,
+                                    Arena& arena) {
+  if (auto number = node.as<NumberNode>())
+    return arena.make<NumberNode>(number->value);
+  if (auto variable = node.as<VariableNode>()) {
+    if (arguments && variable->local >= 0)
+      return clone(*(*arguments)[variable->local], arena);
+    VariableNode* copy = arena.make<VariableNode>(variable->name);
+    copy->slot = variable->slot;
+    copy->local = variable->local;
+    return copy;
+  }
+  if (auto binary = node.as<BinaryOperationNode>()) {
+    ExpressionNode* left = substitute(*binary->left, arguments, arena);
+    ExpressionNode* right = substitute(*binary->right, arguments, arena);
+    if (!left || !right) return nullptr;
+    return arena.make<BinaryOperationNode>(left, binary->operation, right);
+  }
+  if (auto unary = node.as<UnaryOperationNode>()) {
+    ExpressionNode* operand = substitute(*unary->operand, arguments, arena);
+    return operand ? arena.make<UnaryOperationNode>(unary->op, operand)
+                   : nullptr;
+  }
+  if (auto call = node.as<FunctionCallNode>()) {
+    std::vector<ExpressionNode*> args;
+    for (const ExpressionNode* arg : call->arguments) {
+      args.push_back(substitute(*arg, arguments, arena));
+      if (!args.back()) return nullptr;
+    }
+    FunctionCallNode* copy = arena.make<FunctionCallNode>(
+        call->functionName, NodeList<ExpressionNode>(arena, args));
+    copy->builtIn = call->builtIn;
+    copy->slot = call->slot;
+    copy->local = call->local;
+    copy->piped = call->piped;
+    copy->position = call->position;
+    if (arguments && call->local >= 0) {
+      // a lambda passed in, the call goes wherever the argument points
+      auto target = (*arguments)[call->local]->as<VariableNode>();
+      if (!target) return nullptr;
+      copy->functionName = target->name;
+      copy->slot = target->slot;
+      copy->local = target->local;
+    }
+    return copy;
+  }
+  if (auto array = node.as<ArrayNode>()) {
+    std::vector<ExpressionNode*> elements;
+    for (const ExpressionNode* element : array->elements) {
+      elements.push_back(substitute(*element, arguments, arena));
+      if (!elements.back()) return nullptr;
+    }
+    return arena.make<ArrayNode>(NodeList<ExpressionNode>(arena, elements));
+  }
+  if (auto index = node.as<IndexNode>()) {
+    ExpressionNode* array = substitute(*index->array, arguments, arena);
+    ExpressionNode* position = substitute(*index->index, arguments, arena);
+    if (!array || !position) return nullptr;
+    return arena.make<IndexNode>(array, position);
+  }
+  if (auto pipeline = node.as<PipelineNode>()) {
+    ExpressionNode* source = substitute(*pipeline->source, arguments, arena);
+    if (!source) return nullptr;
+    std::vector<FunctionCallNode*> stages;
+    for (const FunctionCallNode* stage : pipeline->stages) {
+      stages.push_back(static_cast<FunctionCallNode*>(
+          substitute(*stage, arguments, arena)));
+      if (!stages.back()) return nullptr;
+    }
+    return arena.make<PipelineNode>(
+        source, NodeList<FunctionCallNode>(arena, stages));
+  }
+  return nullptr;
+}
+
+bool Inliner::isPure(const ExpressionNode& node,
+                     const PassContext& context) const {
+  if (auto binary = node.as<BinaryOperationNode>())
+    return isPure(*binary->left, context) && isPure(*binary->right, context);
+  if (auto unary = node.as<UnaryOperationNode>())
+    return isPure(*unary->operand, context);
+  if (auto call = node.as<FunctionCallNode>()) {
+    if (call->builtIn < 0 ||
+        !context.builtIns.at(context.tables.builtIns[call->builtIn]).pure)
+      return false;
+    for (const ExpressionNode* arg : call->arguments)
+      if (!isPure(*arg, context)) return false;
+    return true;
+  }
+  if (auto array = node.as<ArrayNode>()) {
+    for (const ExpressionNode* element : array->elements)
+      if (!isPure(*element, context)) return false;
+    return true;
+  }
+  if (auto index = node.as<IndexNode>())
+    return isPure(*index->array, context) && isPure(*index->index, context);
+  if (auto pipeline = node.as<PipelineNode>()) {
+    if (!isPure(*pipeline->source, context)) return false;
+    for (const FunctionCallNode* stage : pipeline->stages)
+      if (!isPure(*stage, context)) return false;
+    return true;
+  }
+  return node.as<NumberNode>() || node.as<VariableNode>();
+}
+
+size_t Inliner::size(const ExpressionNode& node) {
+  if (auto binary = node.as<BinaryOperationNode>())
+    return 1 + size(*binary->left) + size(*binary->right);
+  if (auto unary = node.as<UnaryOperationNode>())
+    return 1 + size(*unary->operand);
+  if (auto call = node.as<FunctionCallNode>()) {
+    size_t total = 1;
+    for (const ExpressionNode* arg : call->arguments) total += size(*arg);
+    return total;
+  }
+  if (auto array = node.as<ArrayNode>()) {
+    size_t total = 1;
+    for (const ExpressionNode* element : array->elements)
+      total += size(*element);
+    return total;
+  }
+  if (auto index = node.as<IndexNode>())
+    return 1 + size(*index->array) + size(*index->index);
+  if (auto pipeline = node.as<PipelineNode>()) {
+    size_t total = 1 + size(*pipeline->source);
+    for (const FunctionCallNode* stage : pipeline->stages) total += size(*stage);
+    return total;
+  }
+  if (auto binding = node.as<LocalBindingNode>())
+    return 1 + size(*binding->value) + size(*binding->body);
+  return 1;
+}
+
+// uses of every parameter, and how many of those call it
+void Inliner::countUses(const ExpressionNode& node, std::vector<size_t>& uses,
+                        std::vector<size_t>& calls) {
+  if (auto variable = node.as<VariableNode>()) {
+    if (variable->local >= 0) uses[variable->local]++;
+  } else if (auto binary = node.as<BinaryOperationNode>()) {
+    countUses(*binary->left, uses, calls);
+    countUses(*binary->right, uses, calls);
+  } else if (auto unary = node.as<UnaryOperationNode>()) {
+    countUses(*unary->operand, uses, calls);
+  } else if (auto call = node.as<FunctionCallNode>()) {
+    if (call->local >= 0) {
+      uses[call->local]++;
+      calls[call->local]++;
+    }
+    for (const ExpressionNode* arg : call->arguments)
+      countUses(*arg, uses, calls);
+  } else if (auto array = node.as<ArrayNode>()) {
+    for (const ExpressionNode* element : array->elements)
+      countUses(*element, uses, calls);
+  } else if (auto index = node.as<IndexNode>()) {
+    countUses(*index->array, uses, calls);
+    countUses(*index->index, uses, calls);
+  } else if (auto pipeline = node.as<PipelineNode>()) {
+    countUses(*pipeline->source, uses, calls);
+    for (const FunctionCallNode* stage : pipeline->stages)
+      countUses(*stage, uses, calls);
+  }
+}
+
+// walks node in the order it's evaluated. false if anything that can raise
+// an error, an operation or a call, comes before the first use of every
+// argument in order, or if those are used out of order. next counts the
+// ones used so far
+bool Inliner::argumentsFirst(const ExpressionNode& node,
+                             const std::vector<int>& order, size_t& next) {
+  auto all = [&](const auto& nodes) {
+    for (const ExpressionNode* child : nodes)
+      if (!argumentsFirst(*child, order, next)) return false;
+    return true;
+  };
+  if (node.as<NumberNode>()) return true;
+  if (auto variable = node.as<VariableNode>()) {
+    auto it = std::find(order.begin(), order.end(), variable->local);
+    if (variable->local < 0 || it == order.end()) return true;
+    const size_t position = static_cast<size_t>(it - order.begin());
+    if (position < next) return true;  // evaluated again, the same way
+    if (position > next) return false;
+    next++;
+    return true;
+  }
+  bool operands;
+  if (auto binary = node.as<BinaryOperationNode>())
+    operands = argumentsFirst(*binary->left, order, next) &&
+               argumentsFirst(*binary->right, order, next);
+  else if (auto unary = node.as<UnaryOperationNode>())
+    operands = argumentsFirst(*unary->operand, order, next);
+  else if (auto call = node.as<FunctionCallNode>())
+    operands = all(call->arguments);
+  else if (auto array = node.as<ArrayNode>())
+    operands = all(array->elements);
+  else if (auto index = node.as<IndexNode>())
+    operands = argumentsFirst(*index->array, order, next) &&
+               argumentsFirst(*index->index, order, next);
+  else if (auto pipeline = node.as<PipelineNode>())
+    operands = argumentsFirst(*pipeline->source, order, next) &&
+               all(pipeline->stages);
+  else
+    return false;
+  // the operation itself, or the pipeline's last stage
+  return operands && next == order.size();
+}
+
+// nodes are never shared between parents, later passes rewrite in place
+ExpressionNode* Inliner::clone(const ExpressionNode& node, Arena& arena) {
+  return substitute(node, nullptr, arena);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Pass.h"
+
+/*
+replaces calls of small immutable lambdas with a copy of their body, the
+arguments substituted for the parameters.
+only lambdas declared above the caller are candidates. that rules out
+recursion, and the callee is bound by the time the caller runs. arguments
+have to be free of side effects, since they may end up evaluated zero or
+several times. one that can raise an error, anything but a literal or a
+name, has to be the first thing the body evaluates after those before it,
+so the call still fails the way it would have.
+a call that is a statement on its own stays a call, only calls and
+pipelines are run there.
+statements are handled in order and remember the lambdas they declare, so
+this works the same on a whole program and while streaming.
+*/
+class Inliner : public Pass {
+ public:
+  static constexpr size_t MAX_BODY_SIZE = 16;      // nodes in the callee
+  static constexpr size_t MAX_EXPANDED_SIZE = 32;  // after substitution
+  // how often a copied body is inlined into again, it may call a lambda
+  // that was passed in, including the one being inlined
+  static constexpr int MAX_DEPTH = 4;
+
+  explicit Inliner(std::ostream* report = nullptr) : report(report) {}
+
+  const char* name() const override { return "inliner"; }
+  bool runStatement(ASTNode*& statement, PassContext& context) override;
+
+ private:
+  struct Callee {
+    const LambdaNode* lambda;
+    // a copy taken before later passes add frame locals to the original
+    const ExpressionNode* body;
+    size_t size;
+  };
+
+  bool inlineCalls(ExpressionNode*& node, PassContext& context, int depth = 0);
+  bool inlinePipeline(ExpressionNode*& node, PipelineNode& pipeline,
+                      PassContext& context, int depth);
+  ExpressionNode* expand(const FunctionCallNode& call, const Callee& callee,
+                         PassContext& context, bool& throughArgument);
+  static ExpressionNode* substitute(const ExpressionNode& node,
+                                    const NodeList<ExpressionNode>* arguments,
+                                    Arena& arena);
+  bool isPure(const ExpressionNode& node, const PassContext& context) const;
+  // what happened to a call, on the report. nothing is formatted without one
+  template <typename... Parts>
+  void note(Symbol callee, const Parts&... what) const {
+    if (!report) return;
+    *report << "inline " << symbolName(callee) << " into "
+            << (caller == NO_SYMBOL ? "top level" : symbolName(caller))
+            << ": ";
+    (*report << ... << what) << '\n';
+  }
+
+  static size_t size(const ExpressionNode& node);
+  static void countUses(const ExpressionNode& node, std::vector<size_t>& uses,
+                        std::vector<size_t>& calls);
+  static bool argumentsFirst(const ExpressionNode& node,
+                             const std::vector<int>& order, size_t& next);
+  static ExpressionNode* clone(const ExpressionNode& node, Arena& arena);
+
+ private:
+  std::ostream* report;
+  std::unordered_map<int, Callee> callees;  // immutable lambdas by slot
+  Symbol caller = NO_SYMBOL;  // the lambda being rewritten, if any
+};
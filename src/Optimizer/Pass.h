@@ -0,0 +1,50 @@
+#pragma once
+
+#include "../Parser/AST.h"
+
+// what a pass gets to work with besides the tree itself
+struct PassContext {
+  ProgramNode& tables;  // the Resolver's global and built-in tables
+  Arena& arena;         // where replacement nodes are allocated
+  const BuiltInMap& builtIns;
+};
+
+// a rewrite of a resolved AST, every pass has to leave it resolved
+class Pass {
+ public:
+  virtual ~Pass() = default;
+  virtual const char* name() const = 0;
+
+  // the whole program at once, by default every statement on its own.
+  // returns whether anything changed
+  virtual bool run(ProgramNode& program, PassContext& context) {
+    bool changed = false;
+    for (ASTNode*& statement : program.statements)
+      changed |= runStatement(statement, context);
+    return changed;
+  }
+
+  // a single top-level statement, which is all a pass sees while streaming.
+  // passes that need the whole program leave it alone
+  virtual bool runStatement(ASTNode*&, PassContext&) { return false; }
+};
+
+// calls visit(root, frameSize) for every expression a frame is evaluated
+// from: the statement's own expression with an empty frame, and lambda
+// bodies with their arguments already in it
+template <typename Visit>
+void forEachRoot(ASTNode*& statement, Visit&& visit) {
+  if (auto decl = statement->as<VariableDeclarationNode>()) {
+    if (decl->lambdaExpr.has_value()) {
+      LambdaNode* lambda = *decl->lambdaExpr;
+      visit(lambda->body, static_cast<int>(lambda->arguments.size()));
+    } else if (decl->expression.has_value()) {
+      visit(*decl->expression, 0);
+    }
+  } else if (auto assign = statement->as<AssignmentNode>()) {
+    visit(assign->expression, 0);
+  } else if (auto expr = statement->as<ExpressionNode>()) {
+    visit(expr, 0);
+    statement = expr;
+  }
+}
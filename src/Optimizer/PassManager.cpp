@@ -0,0 +1,56 @@
+#include "PassManager.h"
+
+#include <stdexcept>
+
+#include "CommonSubexpressions.h"
+#include "ConstantFolding.h"
+#include "DeadBindings.h"
+#include "Inliner.h"
+#include "TypeInference.h"
+
+PassManager PassManager::standard(const BuiltInMap& builtIns,
+                                  std::ostream* inlineReport,
+                                  std::ostream* typeReport) {
+  PassManager manager(builtIns);
+  manager.add(std::make_unique<ConstantFolding>())
+      .add(std::make_unique<Inliner>(inlineReport))
+      .addAfterChange(std::make_unique<ConstantFolding>())
+      .add(std::make_unique<CommonSubexpressions>())
+      .add(std::make_unique<DeadBindings>())
+      .add(std::make_unique<TypeInference>(typeReport));
+  return manager;
+}
+
+PassManager& PassManager::add(std::unique_ptr<Pass> pass) {
+  steps.push_back({std::move(pass), false});
+  return *this;
+}
+
+PassManager& PassManager::addAfterChange(std::unique_ptr<Pass> pass) {
+  steps.push_back({std::move(pass), true});
+  return *this;
+}
+
+void PassManager::run(ProgramNode& program) {
+  if (!program.resolved)
+    throw std::runtime_error("Program must be resolved before optimizing");
+  PassContext context{program, *program.arena, builtIns};
+  bool changed = false;
+  for (const Step& step : steps)
+    changed = (!step.afterChange || changed) &&
+              step.pass->run(program, context);
+
+  if (!dump) return;
+  for (const ASTNode* statement : program.statements)
+    *dump << statement->to_string() << '\n';
+}
+
+void PassManager::runStatement(ASTNode*& statement, ProgramNode& tables,
+                               Arena& arena) {
+  PassContext context{tables, arena, builtIns};
+  bool changed = false;
+  for (const Step& step : steps)
+    changed = (!step.afterChange || changed) &&
+              step.pass->runStatement(statement, context);
+  if (dump) *dump << statement->to_string() << '\n';
+}
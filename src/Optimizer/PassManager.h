@@ -0,0 +1,40 @@
+#pragma once
+
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "Pass.h"
+
+// runs a pipeline of passes over a resolved program, in the order added
+class PassManager {
+ public:
+  explicit PassManager(const BuiltInMap& builtIns) : builtIns(builtIns) {}
+
+  // constant folding, inlining, folding what that exposed if anything was
+  // inlined, common subexpressions, dead bindings, then type inference.
+  // inlining decisions go to inlineReport, arithmetic left generic to
+  // typeReport
+  static PassManager standard(const BuiltInMap& builtIns,
+                              std::ostream* inlineReport = nullptr,
+                              std::ostream* typeReport = nullptr);
+
+  PassManager& add(std::unique_ptr<Pass> pass);
+  // runs pass only if the one added before it changed something
+  PassManager& addAfterChange(std::unique_ptr<Pass> pass);
+
+  void run(ProgramNode& program);
+  // for streaming, tables is the program the Resolver keeps its tables in
+  // and arena the one the statement was parsed into
+  void runStatement(ASTNode*& statement, ProgramNode& tables, Arena& arena);
+
+  std::ostream* dump = nullptr;  // prints the optimized tree when set
+
+ private:
+  const BuiltInMap& builtIns;
+  struct Step {
+    std::unique_ptr<Pass> pass;
+    bool afterChange;  // skipped if the step before changed nothing
+  };
+  std::vector<Step> steps;
+};
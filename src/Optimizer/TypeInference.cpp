@@ -0,0 +1,298 @@
+#include "TypeInference.h"
+
+using Type = TypeInference::Type;
+
+// the lambdas a VariableNode reads, which can then be called with anything
+static void markEscapes(const ExpressionNode& node,
+                        std::vector<int>& escaping) {
+  if (auto variable = node.as<VariableNode>()) {
+    if (variable->local < 0) escaping.push_back(variable->slot);
+  } else if (auto binary = node.as<BinaryOperationNode>()) {
+    markEscapes(*binary->left, escaping);
+    markEscapes(*binary->right, escaping);
+  } else if (auto unary = node.as<UnaryOperationNode>()) {
+    markEscapes(*unary->operand, escaping);
+  } else if (auto call = node.as<FunctionCallNode>()) {
+    for (const ExpressionNode* arg : call->arguments)
+      markEscapes(*arg, escaping);
+  } else if (auto pipeline = node.as<PipelineNode>()) {
+    markEscapes(*pipeline->source, escaping);
+    for (const FunctionCallNode* stage : pipeline->stages)
+      markEscapes(*stage, escaping);
+  } else if (auto array = node.as<ArrayNode>()) {
+    for (const ExpressionNode* element : array->elements)
+      markEscapes(*element, escaping);
+  } else if (auto index = node.as<IndexNode>()) {
+    markEscapes(*index->array, escaping);
+    markEscapes(*index->index, escaping);
+  } else if (auto binding = node.as<LocalBindingNode>()) {
+    markEscapes(*binding->value, escaping);
+    markEscapes(*binding->body, escaping);
+  }
+}
+
+bool TypeInference::run(ProgramNode& program, PassContext& context) {
+  for (const ASTNode* stmt : program.statements) {
+    auto decl = stmt->as<VariableDeclarationNode>();
+    if (!decl) continue;
+    if (decl->lambdaExpr.has_value() && !decl->mut) {
+      const LambdaNode* lambda = *decl->lambdaExpr;
+      lambdas[decl->slot] = {
+          lambda, std::vector<Type>(lambda->arguments.size(), Type::Unknown)};
+    } else {
+      globals[decl->slot] = Type::Unknown;
+    }
+  }
+
+  std::vector<int> escaping;
+  for (ASTNode* stmt : program.statements)
+    forEachRoot(stmt, [&](ExpressionNode*& root, int) {
+      markEscapes(*root, escaping);
+    });
+  for (int slot : escaping) {
+    auto lambda = lambdas.find(slot);
+    if (lambda != lambdas.end())
+      for (Type& argument : lambda->second.arguments) argument = Type::Dynamic;
+  }
+
+  // every round can only move types up the lattice, which is three high
+  do {
+    changed = false;
+    for (ASTNode*& stmt : program.statements) infer(stmt, context, false);
+  } while (changed);
+
+  bool rewritten = false;
+  for (ASTNode*& stmt : program.statements)
+    rewritten |= infer(stmt, context, true);
+  return rewritten;
+}
+
+// nothing is known about later statements, so lambdas take anything and
+// mutable bindings hold anything
+bool TypeInference::runStatement(ASTNode*& statement, PassContext& context) {
+  if (auto decl = statement->as<VariableDeclarationNode>()) {
+    if (decl->lambdaExpr.has_value() && !decl->mut) {
+      const LambdaNode* lambda = *decl->lambdaExpr;
+      lambdas[decl->slot] = {
+          lambda, std::vector<Type>(lambda->arguments.size(), Type::Dynamic)};
+    } else if (decl->mut) {
+      globals[decl->slot] = Type::Dynamic;
+    }
+  }
+  // a recursive lambda's result takes more than one round
+  do {
+    changed = false;
+    infer(statement, context, false);
+  } while (changed);
+  return infer(statement, context, true);
+}
+
+// returns whether anything was replaced
+bool TypeInference::infer(ASTNode*& statement, PassContext& context,
+                          bool rewrite) {
+  bool rewritten = false;
+  auto root = [&](ExpressionNode*& node, Scope& scope) {
+    const ExpressionNode* before = node;
+    const Type type = infer(node, scope, context);
+    rewritten |= node != before;
+    return type;
+  };
+
+  if (auto decl = statement->as<VariableDeclarationNode>()) {
+    if (decl->lambdaExpr.has_value()) {
+      LambdaNode* lambda = *decl->lambdaExpr;
+      auto signature = lambdas.find(decl->slot);
+      const bool known = !decl->mut && signature != lambdas.end();
+      Scope scope{known ? signature->second.arguments
+                        : std::vector<Type>(lambda->arguments.size(),
+                                            Type::Dynamic),
+                  decl->name, rewrite};
+      const Type result = root(lambda->body, scope);
+      if (known) join(signature->second.result, result);
+      if (decl->mut) join(globals[decl->slot], Type::Dynamic);
+    } else {
+      Scope scope{{}, NO_SYMBOL, rewrite};
+      join(globals[decl->slot], decl->expression.has_value()
+                                    ? root(*decl->expression, scope)
+                                    : Type::Dynamic);
+    }
+  } else if (auto assign = statement->as<AssignmentNode>()) {
+    Scope scope{{}, NO_SYMBOL, rewrite};
+    join(globals[assign->slot], root(assign->expression, scope));
+  } else if (auto expr = statement->as<ExpressionNode>()) {
+    Scope scope{{}, NO_SYMBOL, rewrite};
+    root(expr, scope);
+    statement = expr;
+  }
+  return rewritten;
+}
+
+Type TypeInference::infer(ExpressionNode*& node, Scope& scope,
+                          PassContext& context) {
+  if (auto number = node->as<NumberNode>())
+    return number->value.isInt()      ? Type::Int
+           : number->value.isDouble() ? Type::Double
+                                      : Type::Dynamic;
+
+  if (auto variable = node->as<VariableNode>()) {
+    if (variable->local >= 0)
+      return static_cast<size_t>(variable->local) < scope.frame.size()
+                 ? scope.frame[variable->local]
+                 : Type::Dynamic;
+    // a lambda, or a binding not declared yet while streaming
+    auto global = globals.find(variable->slot);
+    return global != globals.end() ? global->second : Type::Dynamic;
+  }
+
+  if (auto binary = node->as<BinaryOperationNode>())
+    return arithmetic(node, binary->left, binary->operation, binary->right,
+                      scope, context);
+
+  if (auto unary = node->as<UnaryOperationNode>()) {
+    const Type type = infer(unary->operand, scope, context);
+    if (type == Type::Dynamic && scope.rewrite)
+      note(scope, *node, "the operand is dynamic");
+    if (type != Type::Int && type != Type::Double) return type;
+    if (!scope.rewrite) return type;
+    if (unary->op == '+')
+      node = unary->operand;
+    else if (type == Type::Int)
+      node = context.arena.make<IntArithmeticNode>(
+          context.arena.make<NumberNode>(Value(0)), '-', unary->operand);
+    else
+      node = context.arena.make<DoubleArithmeticNode>(
+          context.arena.make<NumberNode>(Value(-1.0)), '*', unary->operand);
+    return type;
+  }
+
+  if (auto call = node->as<FunctionCallNode>())
+    return inferCall(*call, nullptr, scope, context);
+
+  if (auto pipeline = node->as<PipelineNode>()) {
+    Type type = infer(pipeline->source, scope, context);
+    for (FunctionCallNode* stage : pipeline->stages)
+      type = inferCall(*stage, &type, scope, context);
+    return type;
+  }
+
+  if (auto array = node->as<ArrayNode>()) {
+    for (ExpressionNode*& element : array->elements)
+      infer(element, scope, context);
+    return Type::Dynamic;
+  }
+
+  if (auto index = node->as<IndexNode>()) {
+    infer(index->array, scope, context);
+    infer(index->index, scope, context);
+    return Type::Dynamic;
+  }
+
+  if (auto binding = node->as<LocalBindingNode>()) {
+    const Type value = infer(binding->value, scope, context);
+    if (scope.frame.size() <= static_cast<size_t>(binding->local))
+      scope.frame.resize(binding->local + 1, Type::Dynamic);
+    const Type shadowed = scope.frame[binding->local];
+    scope.frame[binding->local] = value;
+    const Type type = infer(binding->body, scope, context);
+    scope.frame[binding->local] = shadowed;
+    return type;
+  }
+
+  if (node->as<IntArithmeticNode>()) return Type::Int;
+  if (node->as<DoubleArithmeticNode>() || node->as<IntToDoubleNode>())
+    return Type::Double;
+  return Type::Dynamic;
+}
+
+// the arguments flow into an immutable lambda's signature, its result out.
+// their types go on a stack the calls nested in them share
+Type TypeInference::inferCall(FunctionCallNode& call, const Type* piped,
+                              Scope& scope, PassContext& context) {
+  const size_t base = argumentTypes.size();
+  if (piped) argumentTypes.push_back(*piped);
+  for (ExpressionNode*& arg : call.arguments) {
+    const Type type = infer(arg, scope, context);
+    argumentTypes.push_back(type);
+  }
+  const Type result = callResult(call, argumentTypes.data() + base,
+                                 argumentTypes.size() - base, context);
+  argumentTypes.resize(base);
+  return result;
+}
+
+Type TypeInference::callResult(const FunctionCallNode& call,
+                               const Type* arguments, size_t count,
+                               const PassContext& context) {
+  if (call.builtIn >= 0)
+    return builtInResult(context.tables.builtIns[call.builtIn], arguments,
+                         count);
+  if (call.local >= 0) return Type::Dynamic;
+  auto callee = lambdas.find(call.slot);
+  if (callee == lambdas.end() || callee->second.arguments.size() != count)
+    return Type::Dynamic;
+  for (size_t i = 0; i < count; i++)
+    join(callee->second.arguments[i], arguments[i]);
+  return callee->second.result;
+}
+
+Type TypeInference::arithmetic(ExpressionNode*& node, ExpressionNode*& left,
+                               char op, ExpressionNode*& right, Scope& scope,
+                               PassContext& context) {
+  const Type l = infer(left, scope, context);
+  const Type r = infer(right, scope, context);
+  const bool known = (l == Type::Int || l == Type::Double) &&
+                     (r == Type::Int || r == Type::Double);
+  if (!known || (op != '+' && op != '-' && op != '*' && op != '/')) {
+    if (scope.rewrite)
+      note(scope, *node, "the operands are ", typeName(l), " and ",
+           typeName(r));
+    return l == Type::Dynamic || r == Type::Dynamic ? Type::Dynamic
+                                                    : Type::Unknown;
+  }
+
+  if (l == Type::Int && r == Type::Int) {
+    if (scope.rewrite)
+      node = context.arena.make<IntArithmeticNode>(left, op, right);
+    return Type::Int;
+  }
+  if (scope.rewrite) {
+    ExpressionNode* a =
+        l == Type::Int ? context.arena.make<IntToDoubleNode>(left) : left;
+    ExpressionNode* b =
+        r == Type::Int ? context.arena.make<IntToDoubleNode>(right) : right;
+    node = context.arena.make<DoubleArithmeticNode>(a, op, b);
+  }
+  return Type::Double;
+}
+
+// the built-ins whose result type follows from their arguments' types
+Type TypeInference::builtInResult(Symbol name, const Type* arguments,
+                                  size_t count) const {
+  static const Symbol pi = intern("PI");
+  static const Symbol doubled = intern("double");
+  static const Symbol increment = intern("increment");
+  static const Symbol decrement = intern("decrement");
+  if (name == pi) return Type::Double;
+  if ((name == doubled || name == increment || name == decrement) && count == 1)
+    return arguments[0];
+  return Type::Dynamic;
+}
+
+void TypeInference::join(Type& into, Type type) {
+  if (into == type || into == Type::Dynamic || type == Type::Unknown) return;
+  into = into == Type::Unknown ? type : Type::Dynamic;
+  changed = true;
+}
+
+const char* TypeInference::typeName(Type type) {
+  switch (type) {
+    case Type::Unknown:
+      return "never computed";
+    case Type::Int:
+      return "int";
+    case Type::Double:
+      return "double";
+    default:
+      return "dynamic";
+  }
+}
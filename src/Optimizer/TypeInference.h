@@ -0,0 +1,75 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Pass.h"
+
+/*
+proves which expressions always produce an int or a double and replaces the
+arithmetic on them with IntArithmeticNode and DoubleArithmeticNode, which
+skip Value's type checks and work on raw numbers.
+types come from literals, immutable globals, a few built-ins and the results
+of immutable lambdas. on a whole program the arguments of a lambda that's
+only ever called directly are the types it's called with, found by iterating
+to a fixpoint. lambdas passed around as values can be called with anything,
+and while streaming so can every lambda, later statements may call it.
+arithmetic left generic is listed on the report, if there is one.
+*/
+class TypeInference : public Pass {
+ public:
+  // the lattice, Unknown below everything else: nothing has flowed in yet
+  enum class Type : uint8_t { Unknown, Int, Double, Dynamic };
+
+  explicit TypeInference(std::ostream* report = nullptr) : report(report) {}
+
+  const char* name() const override { return "type-inference"; }
+  bool run(ProgramNode& program, PassContext& context) override;
+  bool runStatement(ASTNode*& statement, PassContext& context) override;
+
+ private:
+  // an immutable lambda binding
+  struct Signature {
+    const LambdaNode* lambda;
+    std::vector<Type> arguments;  // Dynamic if it escapes
+    Type result = Type::Unknown;
+  };
+  // the expression being looked at, frame holds the types of its locals
+  struct Scope {
+    std::vector<Type> frame;
+    Symbol owner;  // the lambda, or NO_SYMBOL at the top level
+    bool rewrite;  // replace what's proven, otherwise only infer
+  };
+
+  bool infer(ASTNode*& statement, PassContext& context, bool rewrite);
+  Type infer(ExpressionNode*& node, Scope& scope, PassContext& context);
+  Type inferCall(FunctionCallNode& call, const Type* piped,
+                 Scope& scope, PassContext& context);
+  Type arithmetic(ExpressionNode*& node, ExpressionNode*& left, char op,
+                  ExpressionNode*& right, Scope& scope, PassContext& context);
+  Type callResult(const FunctionCallNode& call, const Type* arguments,
+                  size_t count, const PassContext& context);
+  Type builtInResult(Symbol name, const Type* arguments, size_t count) const;
+  void join(Type& into, Type type);
+  // arithmetic left generic, on the report. nothing is formatted without one
+  template <typename... Parts>
+  void note(const Scope& scope, const ExpressionNode& node,
+            const Parts&... why) const {
+    if (!report) return;
+    *report << "types in "
+            << (scope.owner == NO_SYMBOL ? "top level"
+                                         : symbolName(scope.owner))
+            << ": " << node.to_string() << " stays generic, ";
+    (*report << ... << why) << '\n';
+  }
+  static const char* typeName(Type type);
+
+ private:
+  std::ostream* report;
+  bool changed = false;  // some type went up during the current round
+  std::unordered_map<int, Signature> lambdas;  // by slot
+  std::unordered_map<int, Type> globals;       // the other bindings, by slot
+  std::vector<Type> argumentTypes;             // of the calls being inferred
+};
@@ -1,8 +1,21 @@
+#include <chrono>
+#include <csignal>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 
+#include "AOT/CppEmitter.h"
 #include "Lexer/Lexer.h"
+#include "Lexer/Source.h"
 #include "Parser/Interpreter.h"
 #include "Parser/Parser.h"
+#include "Runtime/Batch.h"
+#include "Runtime/Memory.h"
+#include "Runtime/Profiler.h"
+#include "Runtime/Trace.h"
+#include "Runtime/ThreadPool.h"
+#include "Server/Server.h"
 
 /*
  =======================================================
@@ -11,26 +24,309 @@
               i hate Abstract Syntax Trees
 */
 
-int main() {
-  std::string code =
-      "let a = () => 4; print(a());";  // doesn't allow for sub 2 argument
-                                       // definitions cuz bad
+struct Options {
+  RunOptions run;
+  bool stream = false;  // run statements as they're read
+  bool mapped = false;  // mmap the input file instead of reading it
+  size_t threads = 0;   // for map, filter and reduce, 0 for one per core
+  std::string path;     // "-" for stdin, empty for the built-in demo
+  std::string aot;      // translate to C++ into this file instead of running
+  std::string entry = "palmtree_run";  // the function the C++ defines
+  std::string stacks;  // --profile writes collapsed stacks here
+  std::string trace;   // --trace writes the timeline here
+  bool memStats = false;  // count allocations by phase and what they're for
+  std::string serve;      // answer requests on this socket instead
+  size_t workers = 0;     // --serve's request threads, 0 for one per core
+  size_t cacheSize = 64;  // programs --serve keeps compiled
+  bool batch = false;     // palmtree run, every script under files
+  std::vector<std::string> files;
+  std::string timings;  // run writes every script's time here
+};
+
+static int usage(const char* program) {
+  std::cerr << "usage: " << program
+            << " [--tree-walk] [--stream] [--mmap] [--no-optimize]"
+               " [--dump-optimized] [--inline-report] [--type-report]"
+               " [--threads N] [--parallel]"
+               " [--no-memo] [--memo-stats] [--jit=off|on|eager]"
+               " [--jit-stats] [--profile[=stacks.folded]]"
+               " [--trace out.json] [--mem-stats]"
+               " [--aot out.cpp [--aot-entry name]] [file | -]\n"
+            << "       " << program
+            << " --serve socket [--workers N] [--cache N] [--threads N]"
+               " [--tree-walk] [--no-optimize] [--no-memo]\n"
+               "         (names scripts use are kept until the server exits)\n"
+            << "       " << program
+            << " run dir|file... [--jobs N] [--timings out.tsv]"
+               " [--tree-walk] [--no-optimize] [--no-memo]"
+               " [--jit=off|on|eager] [--parallel]\n";
+  return 2;
+}
+
+static void runDemo(const RunOptions& options) {
+  std::string code = "let a = () => 4; print(a());";
   //  std::string code = "let x = 4 + 4;";
   //  std::string code = "let x = 5 |> increment; print(x);";
-  std::vector<Token> tokens = Lexer::tokenize(code);
+  TokenStream tokens = Lexer::tokenize(code);
 
-  for (auto& token : tokens) std::cout << token.to_string() << '\n';
+  for (size_t i = 0; i < tokens.size(); i++)
+    std::cout << tokens[i].to_string() << '\n';
   std::cout << '\n';
 
   Parser parser(tokens);
   std::unique_ptr<ProgramNode> ast = parser.parse();
+  Resolver::resolve(*ast, Lexer::BUILT_IN_FUNCTIONS);
 
   std::cout << "\n" << ast->to_string() << '\n';
-  for (std::unique_ptr<ASTNode>& node : ast->statements)
+  for (const ASTNode* node : ast->statements)
     std::cout << node->to_string() << "\n";
+  if (options.mode == ExecutionMode::Bytecode)
+    std::cout << "\n" << Compiler::compile(*ast).to_string();
 
   std::cout << "Code:\n";
   std::cout << code << "\n\n";
   std::cout << "Output:\n";
-  Interpreter::walkAST(ast);
+  Interpreter::walkAST(ast, options);
+}
+
+static void runFile(const Options& options) {
+  std::unique_ptr<Source> source = Source::open(options.path, options.mapped);
+  if (options.stream && options.aot.empty()) {
+    Interpreter::walkStream(*source, options.run);
+    return;
+  }
+
+  // a mapped file arrives in one piece, anything else is read in full first
+  Trace::Scope read(Trace::Kind::Phase, Trace::Read);
+  std::string code;
+  std::string_view text = source->read();
+  if (!options.mapped) {
+    code.assign(text);
+    for (std::string_view chunk = source->read(); !chunk.empty();
+         chunk = source->read())
+      code.append(chunk);
+    text = code;
+  }
+  read.close();
+  if (Profiler::isEnabled()) Profiler::addSource(text);
+
+  TokenStream tokens = Interpreter::lex(text);
+  std::unique_ptr<ProgramNode> ast = Interpreter::parse(tokens);
+  if (options.aot.empty()) {
+    Interpreter::walkAST(ast, options.run);
+    return;
+  }
+
+  // the same passes walkAST runs, so the C++ does what it would have done
+  Resolver::resolve(*ast, Lexer::BUILT_IN_FUNCTIONS);
+  if (options.run.optimize) Interpreter::optimizer(options.run).run(*ast);
+  const std::string cpp = CppEmitter::emit(*ast, options.entry);
+  if (options.aot == "-") {
+    std::cout << cpp;
+    return;
+  }
+  std::ofstream out(options.aot, std::ios::binary);
+  if (!(out << cpp) || !out.flush())
+    throw std::runtime_error("Can't write " + options.aot);
+}
+
+static Server* server = nullptr;  // for the signal handlers
+
+static void stopServing(int) {
+  if (server) server->stop();
+}
+
+// answers requests until SIGINT or SIGTERM
+static int serve(const Options& options) {
+  // native code takes immutable globals for constants, but a cached
+  // program's can differ from one request to the next
+  Jit::configure(JitMode::Off);
+  ServeOptions serveOptions;
+  serveOptions.run = options.run;
+  serveOptions.workers = options.workers;
+  serveOptions.cacheSize = options.cacheSize;
+  Server instance(options.serve, serveOptions);
+  server = &instance;
+  std::signal(SIGINT, stopServing);
+  std::signal(SIGTERM, stopServing);
+
+  int status = 0;
+  try {
+    instance.run();
+  } catch (const std::exception& e) {
+    std::cerr << "error: " << e.what() << '\n';
+    status = 1;
+  }
+  server = nullptr;
+  const ProgramCache& cache = instance.cache();
+  std::cerr << "serve: " << cache.hits() << " hits, " << cache.misses()
+            << " misses, " << cache.size() << " programs cached, "
+            << SymbolTable::global().size() << " symbols\n";
+  return status;
+}
+
+// palmtree run: the scripts --jobs at a time, then a summary to stderr
+static int runBatch(const Options& options) {
+  using Clock = std::chrono::steady_clock;
+  const Clock::time_point start = Clock::now();
+  std::vector<Batch::Result> results;
+  try {
+    const std::vector<std::string> files = Batch::discover(options.files);
+    if (files.empty()) throw std::runtime_error("No .palm files found");
+    results = Batch::run(files, options.run, std::cout);
+  } catch (const std::exception& e) {
+    std::cout.flush();
+    std::cerr << "error: " << e.what() << '\n';
+    return 1;
+  }
+  Batch::summary(results,
+                 std::chrono::duration<double>(Clock::now() - start).count(),
+                 std::cerr);
+
+  int status = 0;
+  for (const Batch::Result& result : results)
+    if (!result.ok) status = 1;
+  if (!options.timings.empty()) {
+    std::ofstream timings(options.timings);
+    Batch::writeTimings(results, timings);
+    if (!timings.flush()) {
+      std::cerr << "error: can't write " << options.timings << '\n';
+      status = 1;
+    }
+  }
+  return status;
+}
+
+// a count for an option, at least minimum
+static bool count(const char* text, long minimum, size_t& value) {
+  char* end = nullptr;
+  const long parsed = std::strtol(text, &end, 10);
+  if (*end != '\0' || parsed < minimum) return false;
+  value = static_cast<size_t>(parsed);
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  Options options;
+  options.batch = argc > 1 && std::strcmp(argv[1], "run") == 0;
+  for (int i = options.batch ? 2 : 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--tree-walk") == 0)
+      options.run.mode = ExecutionMode::TreeWalk;
+    else if (std::strcmp(argv[i], "--stream") == 0)
+      options.stream = true;
+    else if (std::strcmp(argv[i], "--mmap") == 0)
+      options.mapped = true;
+    else if (std::strcmp(argv[i], "--no-optimize") == 0)
+      options.run.optimize = false;
+    else if (std::strcmp(argv[i], "--dump-optimized") == 0)
+      options.run.dumpOptimized = true;
+    else if (std::strcmp(argv[i], "--inline-report") == 0)
+      options.run.inlineReport = true;
+    else if (std::strcmp(argv[i], "--type-report") == 0)
+      options.run.typeReport = true;
+    else if (std::strcmp(argv[i], "--no-memo") == 0)
+      MemoCache::setEnabled(false);
+    else if (std::strcmp(argv[i], "--memo-stats") == 0)
+      options.run.memoStats = true;
+    else if (std::strcmp(argv[i], "--jit=off") == 0)
+      Jit::configure(JitMode::Off);
+    else if (std::strcmp(argv[i], "--jit=on") == 0)
+      Jit::configure(JitMode::On);
+    else if (std::strcmp(argv[i], "--jit=eager") == 0)
+      Jit::configure(JitMode::Eager);
+    else if (std::strcmp(argv[i], "--jit-stats") == 0)
+      options.run.jitStats = true;
+    else if (std::strcmp(argv[i], "--profile") == 0)
+      options.stacks = "palmtree.folded";
+    else if (std::strncmp(argv[i], "--profile=", 10) == 0 && argv[i][10])
+      options.stacks = argv[i] + 10;
+    else if (std::strcmp(argv[i], "--parallel") == 0)
+      options.run.parallel = true;
+    else if (std::strcmp(argv[i], "--mem-stats") == 0)
+      options.memStats = true;
+    else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+      options.trace = argv[++i];
+    else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      if (!count(argv[++i], 1, options.threads)) return usage(argv[0]);
+    } else if (std::strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+      if (!count(argv[++i], 1, options.threads)) return usage(argv[0]);
+    } else if (std::strcmp(argv[i], "--timings") == 0 && i + 1 < argc)
+      options.timings = argv[++i];
+    else if (std::strcmp(argv[i], "--serve") == 0 && i + 1 < argc)
+      options.serve = argv[++i];
+    else if (std::strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+      if (!count(argv[++i], 1, options.workers)) return usage(argv[0]);
+    } else if (std::strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+      if (!count(argv[++i], 1, options.cacheSize)) return usage(argv[0]);
+    } else if (std::strcmp(argv[i], "--aot") == 0 && i + 1 < argc)
+      options.aot = argv[++i];
+    else if (std::strcmp(argv[i], "--aot-entry") == 0 && i + 1 < argc)
+      options.entry = argv[++i];
+    else if (argv[i][0] == '-' && argv[i][1] != '\0')
+      return usage(argv[0]);
+    else if (options.batch)
+      options.files.push_back(argv[i]);
+    else if (options.path.empty())
+      options.path = argv[i];
+    else
+      return usage(argv[0]);
+  }
+
+  ThreadPool::configure(options.threads);
+  if (options.batch)
+    return options.files.empty() || !options.serve.empty() ||
+                   !options.aot.empty()
+               ? usage(argv[0])
+               : runBatch(options);
+  if (!options.serve.empty())
+    return options.path.empty() ? serve(options) : usage(argv[0]);
+  if (options.path.empty()) {
+    runDemo(options.run);
+    return 0;
+  }
+
+  // native code calls other native code directly, past the profiler and
+  // the trace
+  if (!options.stacks.empty() && options.aot.empty()) {
+    Jit::configure(JitMode::Off);
+    Profiler::enable();
+  }
+  if (!options.trace.empty()) {
+    if (options.aot.empty()) Jit::configure(JitMode::Off);
+    Trace::enable();
+  }
+  if (options.memStats) Memory::enable();
+
+  int status = 0;
+  try {
+    runFile(options);
+  } catch (const std::exception& e) {
+    std::cout.flush();
+    std::cerr << "error: " << e.what() << '\n';
+    status = 1;
+  }
+
+  if (Profiler::isEnabled()) {
+    std::cout.flush();
+    Profiler::report(std::cerr);
+    std::ofstream stacks(options.stacks);
+    Profiler::writeStacks(stacks);
+    if (!stacks.flush()) {
+      std::cerr << "error: can't write " << options.stacks << '\n';
+      status = 1;
+    }
+  }
+  if (Trace::isEnabled()) {
+    std::ofstream trace(options.trace);
+    Trace::write(trace);
+    if (!trace.flush()) {
+      std::cerr << "error: can't write " << options.trace << '\n';
+      status = 1;
+    }
+  }
+  if (Memory::isEnabled()) {
+    std::cout.flush();
+    Memory::report(std::cerr);
+  }
+  return status;
 }
@@ -6,35 +6,100 @@
 #include <optional>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
+#include "../JIT/Jit.h"
+#include "../Runtime/Memo.h"
+#include "../Runtime/Profiler.h"
+#include "../Runtime/Trace.h"
+#include "../Types/Arithmetic.h"
 #include "../Types/Value.h"
+#include "Arena.h"
+#include "Environment.h"
+
+// one per concrete node, see ASTNode::as
+enum class NodeKind : uint8_t {
+  Program,
+  Number,
+  Variable,
+  BinaryOperation,
+  IntArithmetic,
+  DoubleArithmetic,
+  IntToDouble,
+  Assignment,
+  Lambda,
+  VariableDeclaration,
+  FunctionCall,
+  UnaryOperation,
+  Pipeline,
+  Array,
+  Index,
+  LocalBinding,
+  CompiledBody,
+};
+
+struct ExpressionNode;
 
+// nodes are allocated in the Arena owned by their ProgramNode (or by the
+// Parser while streaming), so links between them are plain pointers
 struct ASTNode {
+  const NodeKind kind;
+
+  explicit ASTNode(NodeKind kind) : kind(kind) {}
   virtual std::string to_string(
       int indent = 0) const = 0;  // for debug purposes to visualize the AST
-  virtual Value visit(
-      std::unordered_map<std::string, Value>& variables,
-      const std::unordered_map<std::string,
-                               std::function<Value(const std::vector<Value>&)>>&
-          builtInFunctions) const = 0;
+  virtual Value visit(Environment& env) const = 0;
   virtual ~ASTNode() = default;
+
+  // the node as a T if it is one, nullptr otherwise. the passes and the
+  // compilers ask this of every node they walk, comparing kind is much
+  // cheaper than a dynamic_cast that fails
+  template <typename T>
+  T* as() {
+    return is<T>() ? static_cast<T*>(this) : nullptr;
+  }
+  template <typename T>
+  const T* as() const {
+    return is<T>() ? static_cast<const T*>(this) : nullptr;
+  }
+
+ private:
+  template <typename T>
+  bool is() const {
+    if constexpr (std::is_same_v<T, ExpressionNode>)
+      return kind != NodeKind::Program && kind != NodeKind::Assignment &&
+             kind != NodeKind::VariableDeclaration;
+    else
+      return kind == T::KIND;
+  }
 };
 
 struct ProgramNode : public ASTNode {
  public:
-  std::vector<std::unique_ptr<ASTNode>> statements;
-
-  ProgramNode(std::vector<std::unique_ptr<ASTNode>> stmts)
-      : statements(std::move(stmts)) {}
-
-  Value visit(std::unordered_map<std::string, Value>& variables,
-              const std::unordered_map<
-                  std::string, std::function<Value(const std::vector<Value>&)>>&
-                  builtInFunctions) const override {
-    for (const auto& stmt : statements)
-      stmt->visit(variables, builtInFunctions);
+  static constexpr NodeKind KIND = NodeKind::Program;
+
+  std::vector<ASTNode*> statements;
+  std::shared_ptr<Arena> arena;  // owns the statements
+
+  // filled in by the Resolver, slot and built-in index -> name
+  std::vector<Symbol> globals;
+  std::vector<Symbol> builtIns;
+  // every memo lambda, those that got a cache and those that didn't
+  std::vector<std::shared_ptr<const LambdaNode>> memoized;
+  bool resolved = false;
+
+  ProgramNode(std::vector<ASTNode*> stmts, std::shared_ptr<Arena> arena)
+      : ASTNode(KIND),
+        statements(std::move(stmts)),
+        arena(std::move(arena)) {}
+
+  Value visit(Environment& env) const override {
+    for (size_t i = 0; i < statements.size(); i++) {
+      Trace::Scope trace(Trace::Kind::Statement, static_cast<uint32_t>(i));
+      statements[i]->visit(env);
+    }
     return Value();
   }
 
@@ -45,35 +110,38 @@ struct ProgramNode : public ASTNode {
 
 // parent class for expressions of all types
 struct ExpressionNode : public ASTNode {
-  virtual Value evaluate(
-      std::unordered_map<std::string, Value>& variables,
-      const std::unordered_map<std::string,
-                               std::function<Value(const std::vector<Value>&)>>&
-          builtInFunctions) const = 0;
-  Value visit(std::unordered_map<std::string, Value>& variables,
-              const std::unordered_map<
-                  std::string, std::function<Value(const std::vector<Value>&)>>&
-                  builtInFunctions) const override = 0;
+  using ASTNode::ASTNode;
+
+  virtual Value evaluate(Environment& env) const = 0;
+  Value visit(Environment& env) const override = 0;
+
+  // for parents that know the node's type, see TypeInference. nodes that
+  // can produce a raw value without boxing it override these
+  virtual int evaluateInt(Environment& env) const {
+    return evaluate(env).asInt();
+  }
+  virtual double evaluateDouble(Environment& env) const {
+    return evaluate(env).asDouble();
+  }
 };
 
 // number literals like 5
 struct NumberNode : public ExpressionNode {
+  static constexpr NodeKind KIND = NodeKind::Number;
+
   Value value;
 
-  NumberNode(Value val) : value(val) {}
+  NumberNode(Value val) : ExpressionNode(KIND), value(val) {}
 
-  Value evaluate(
-      std::unordered_map<std::string, Value>& variables,
-      const std::unordered_map<std::string,
-                               std::function<Value(const std::vector<Value>&)>>&
-          builtInFunctions) const override {
+  Value evaluate(Environment& env) const override {
     return value;
   }
+  int evaluateInt(Environment&) const override { return value.asInt(); }
+  double evaluateDouble(Environment&) const override {
+    return value.asDouble();
+  }
 
-  Value visit(std::unordered_map<std::string, Value>& variables,
-              const std::unordered_map<
-                  std::string, std::function<Value(const std::vector<Value>&)>>&
-                  builtInFunctions) const override {
+  Value visit(Environment& env) const override {
     /* Doesn't do anything right now */
     return Value();
   }
@@ -85,61 +153,64 @@ struct NumberNode : public ExpressionNode {
 
 // for identifiers like print(x); (x is considered a variable-node)
 struct VariableNode : public ExpressionNode {
-  std::string name;
-  VariableNode(const std::string& name) : name(name) {}
-
-  Value evaluate(
-      std::unordered_map<std::string, Value>& variables,
-      const std::unordered_map<std::string,
-                               std::function<Value(const std::vector<Value>&)>>&
-          builtInFunctions) const override {
-    auto it = variables.find(name);
-    if (it != variables.end())
-      return it->second;
-    else {
-      std::cout << "Undefined variable: " + name << "\n";
-      throw std::runtime_error("Undefined variable: " + name);
-    }
+  static constexpr NodeKind KIND = NodeKind::Variable;
+
+  Symbol name;
+  int slot = -1;   // set by the Resolver for globals
+  int local = -1;  // or the argument index inside the enclosing lambda
+  VariableNode(Symbol name) : ExpressionNode(KIND), name(name) {}
+
+  Value evaluate(Environment& env) const override {
+    if (local >= 0) return env.stack[env.frameBase + local];
+    if (env.defined[slot]) return env.globals[slot];
+    env.output->line("Undefined variable: " + symbolName(name));
+    throw std::runtime_error("Undefined variable: " + symbolName(name));
+  }
+  // a local is read in place instead of copied out
+  int evaluateInt(Environment& env) const override {
+    return local >= 0 ? env.stack[env.frameBase + local].asInt()
+                      : evaluate(env).asInt();
+  }
+  double evaluateDouble(Environment& env) const override {
+    return local >= 0 ? env.stack[env.frameBase + local].asDouble()
+                      : evaluate(env).asDouble();
   }
 
-  Value visit(std::unordered_map<std::string, Value>& variables,
-              const std::unordered_map<
-                  std::string, std::function<Value(const std::vector<Value>&)>>&
-                  builtInFunctions) const override {
+  Value visit(Environment& env) const override {
     /* Doesn't do anything right now */
     return Value();
   }
 
   std::string to_string(int indent = 0) const override {
-    return std::string(indent, ' ') + "IDENTIFIER (" + name + ")";
+    return std::string(indent, ' ') + "IDENTIFIER (" + symbolName(name) + ")";
   }
 };
 
 // an expression representing 3*2 (or something of the like)
 struct BinaryOperationNode : public ExpressionNode {
-  std::unique_ptr<ExpressionNode> left;
-  std::unique_ptr<ExpressionNode> right;
+  static constexpr NodeKind KIND = NodeKind::BinaryOperation;
+
+  ExpressionNode* left;
+  ExpressionNode* right;
   char operation;
 
-  BinaryOperationNode(std::unique_ptr<ExpressionNode> lhs, char op,
-                      std::unique_ptr<ExpressionNode> rhs)
-      : left(std::move(lhs)), right(std::move(rhs)), operation(op) {}
+  BinaryOperationNode(ExpressionNode* lhs, char op,
+                      ExpressionNode* rhs)
+      : ExpressionNode(KIND), left(lhs), right(rhs), operation(op) {}
 
-  Value evaluate(
-      std::unordered_map<std::string, Value>& variables,
-      const std::unordered_map<std::string,
-                               std::function<Value(const std::vector<Value>&)>>&
-          builtInFunctions) const override {
-    Value leftVal = left->evaluate(variables, builtInFunctions);
-    Value rightVal = right->evaluate(variables, builtInFunctions);
+  Value evaluate(Environment& env) const override {
+    Value leftVal = left->evaluate(env);
+    Value rightVal = right->evaluate(env);
 
     switch (operation) {
       ;
       case '*':
         return leftVal * rightVal;
       case '/':
-        return rightVal != 0 ? leftVal / rightVal
-                             : throw std::runtime_error("Division by zero");
+        // arrays check their own elements
+        return rightVal.isArray() || rightVal != 0
+                   ? leftVal / rightVal
+                   : throw std::runtime_error("Division by zero");
       case '+':
         return leftVal + rightVal;
       case '-':
@@ -149,10 +220,7 @@ struct BinaryOperationNode : public ExpressionNode {
     }
   }
 
-  Value visit(std::unordered_map<std::string, Value>& variables,
-              const std::unordered_map<
-                  std::string, std::function<Value(const std::vector<Value>&)>>&
-                  builtInFunctions) const override {
+  Value visit(Environment& env) const override {
     /* Doesn't do anything right now */
     return Value();
   }
@@ -163,197 +231,297 @@ struct BinaryOperationNode : public ExpressionNode {
   }
 };
 
+/*
+the specialized forms of BinaryOperationNode the TypeInference pass puts in
+where it proved both operands to be ints, or both doubles. an int operand of
+a double operation is converted by an IntToDoubleNode, and negation becomes
+0 - x or -1.0 * x. their operands are evaluated raw, not as Values.
+*/
+struct IntArithmeticNode : public ExpressionNode {
+  static constexpr NodeKind KIND = NodeKind::IntArithmetic;
+
+  ExpressionNode* left;
+  ExpressionNode* right;
+  char operation;
+
+  IntArithmeticNode(ExpressionNode* lhs, char op, ExpressionNode* rhs)
+      : ExpressionNode(KIND), left(lhs), right(rhs), operation(op) {}
+
+  int evaluateInt(Environment& env) const override {
+    const int a = left->evaluateInt(env);
+    return Arithmetic::apply(operation, a, right->evaluateInt(env));
+  }
+  Value evaluate(Environment& env) const override {
+    return Value(evaluateInt(env));
+  }
+
+  // like BinaryOperationNode, a statement on its own doesn't run
+  Value visit(Environment&) const override { return Value(); }
+
+  std::string to_string(int indent = 0) const override {
+    return std::string(indent, ' ') + "INT-EXPR: (" + left->to_string() +
+           " " + operation + " " + right->to_string() + ")";
+  }
+};
+
+struct DoubleArithmeticNode : public ExpressionNode {
+  static constexpr NodeKind KIND = NodeKind::DoubleArithmetic;
+
+  ExpressionNode* left;
+  ExpressionNode* right;
+  char operation;
+
+  DoubleArithmeticNode(ExpressionNode* lhs, char op, ExpressionNode* rhs)
+      : ExpressionNode(KIND), left(lhs), right(rhs), operation(op) {}
+
+  double evaluateDouble(Environment& env) const override {
+    const double a = left->evaluateDouble(env);
+    return Arithmetic::apply(operation, a, right->evaluateDouble(env));
+  }
+  Value evaluate(Environment& env) const override {
+    return Value(evaluateDouble(env));
+  }
+
+  Value visit(Environment&) const override { return Value(); }
+
+  std::string to_string(int indent = 0) const override {
+    return std::string(indent, ' ') + "DOUBLE-EXPR: (" + left->to_string() +
+           " " + operation + " " + right->to_string() + ")";
+  }
+};
+
+struct IntToDoubleNode : public ExpressionNode {
+  static constexpr NodeKind KIND = NodeKind::IntToDouble;
+
+  ExpressionNode* operand;
+
+  explicit IntToDoubleNode(ExpressionNode* operand)
+      : ExpressionNode(KIND), operand(operand) {}
+
+  double evaluateDouble(Environment& env) const override {
+    return operand->evaluateInt(env);
+  }
+  Value evaluate(Environment& env) const override {
+    return Value(evaluateDouble(env));
+  }
+
+  Value visit(Environment&) const override { return Value(); }
+
+  std::string to_string(int indent = 0) const override {
+    return std::string(indent, ' ') + "TO-DOUBLE: (" + operand->to_string() +
+           ")";
+  }
+};
+
 struct AssignmentNode : public ASTNode {
-  std::string name;
-  std::unique_ptr<ExpressionNode> expression;
-
-  AssignmentNode(const std::string& name, std::unique_ptr<ExpressionNode> expr)
-      : name(name), expression(std::move(expr)) {}
-
-  Value visit(std::unordered_map<std::string, Value>& variables,
-              const std::unordered_map<
-                  std::string, std::function<Value(const std::vector<Value>&)>>&
-                  builtInFunctions) const override {
-    if (variables.find(name) == variables.end())
-      throw std::runtime_error("Variable '" + name + "' is not declared!");
-    if (!variables[name].isMutable())
-      throw std::runtime_error("Variable '" + name + "' is immutable!");
-    variables[name] = expression->evaluate(variables, builtInFunctions);
+  static constexpr NodeKind KIND = NodeKind::Assignment;
+
+  Symbol name;
+  ExpressionNode* expression;
+  int slot = -1;  // set by the Resolver, which also checks mutability
+
+  AssignmentNode(Symbol name, ExpressionNode* expr)
+      : ASTNode(KIND), name(name), expression(expr) {}
+
+  Value visit(Environment& env) const override {
+    env.define(slot, expression->evaluate(env), true);
     return Value();
   }
 
   std::string to_string(int indent = 0) const override {
-    return std::string(indent, ' ') + "Assignment: " + name + " = (" +
+    return std::string(indent, ' ') + "Assignment: " + symbolName(name) + " = (" +
            expression->to_string() + ")";
   }
 };
 
-struct LambdaNode : public ExpressionNode,
-                    public std::enable_shared_from_this<LambdaNode> {
+struct LambdaNode : public ExpressionNode {
  public:
-  std::string functionName;
-  std::vector<std::string> arguments;
-  std::unique_ptr<ExpressionNode> body;
-
-  LambdaNode(std::string functionName, std::vector<std::string> arguments,
-             std::unique_ptr<ExpressionNode> body)
-      : functionName(functionName),
+  static constexpr NodeKind KIND = NodeKind::Lambda;
+
+  Symbol functionName;
+  std::vector<Symbol> arguments;
+  ExpressionNode* body;
+  // aliases the arena's owner, values made from it keep the arena alive
+  std::weak_ptr<const LambdaNode> self;
+  // set by the Resolver for a memo lambda it found to be pure
+  std::unique_ptr<MemoCache> cache;
+  mutable JitProfile jit;
+
+  LambdaNode(Symbol functionName, std::vector<Symbol> arguments,
+             ExpressionNode* body)
+      : ExpressionNode(KIND),
+        functionName(functionName),
         arguments(arguments),
-        body(std::move(body)) {}
-
-  LambdaNode(std::unique_ptr<LambdaNode> ptr)
-      : functionName(ptr->functionName),
-        arguments(ptr->arguments),
-        body(std::move(ptr->body)) {}
+        body(body) {}
 
-  Value evaluate(
-      std::unordered_map<std::string, Value>& variables,
-      const std::unordered_map<std::string,
-                               std::function<Value(const std::vector<Value>&)>>&
-          builtInFunctions) const override {
-    return Value(shared_from_this());
+  Value evaluate(Environment& env) const override {
+    return Value(self.lock());
   }
 
-  Value visit(std::unordered_map<std::string, Value>& variables,
-              const std::unordered_map<
-                  std::string, std::function<Value(const std::vector<Value>&)>>&
-                  builtInFunctions) const override {
-    Value exprResult = body->evaluate(variables, builtInFunctions);
-    for (std::string arg : arguments)
-      variables.erase(arg);  // very safe way to clean out local scope
-    return exprResult;
+  // the caller has already pushed the arguments as the current frame
+  Value visit(Environment& env) const override { return body->evaluate(env); }
+
+  // runs the body on the arguments pushed since base and pops them again.
+  // position is the call site's, for the profiler
+  Value call(Environment& env, size_t base, int position = -1) const {
+    Profiler::Call profile(functionName, false, position);
+    Trace::Scope trace(Trace::Kind::Lambda, functionName);
+    Value result;
+    if (cache &&
+        cache->find(env.stack.data() + base, arguments.size(), result)) {
+      env.stack.resize(base);
+      return result;
+    }
+    Environment::Frame frame(env, base);
+    if (!Jit::call(*this, env.stack.data() + base, arguments.size(), env,
+                   result))
+      result = visit(env);
+    // the arguments are still in place, the body only pushes above them
+    if (cache)
+      cache->insert(env.stack.data() + base, arguments.size(), result);
+    return result;
   }
 
-  std::string to_string(int indent = 0) const override { return ""; }
+  std::string to_string(int indent = 0) const override {
+    std::string str = std::string(indent, ' ') + "LAMBDA (";
+    for (size_t i = 0; i < arguments.size(); i++)
+      str += (i ? ", " : "") + symbolName(arguments[i]);
+    return str + ") => " + body->to_string();
+  }
 };
 
 // for expressions like let x = 54;
 struct VariableDeclarationNode : public ASTNode {
-  std::string name;
-  std::optional<std::unique_ptr<ExpressionNode>> expression;
-  std::optional<std::shared_ptr<LambdaNode>> lambdaExpr;
-  bool mut;
+  static constexpr NodeKind KIND = NodeKind::VariableDeclaration;
 
-  VariableDeclarationNode(const std::string& name,
-                          std::optional<std::unique_ptr<ExpressionNode>> expr,
-                          std::optional<std::shared_ptr<LambdaNode>> lambdaExpr,
-                          bool mut)
-      : name(name),
-        expression(std::move(expr)),
-        lambdaExpr(std::move(lambdaExpr)),
-        mut(mut) {}
-
-  Value visit(std::unordered_map<std::string, Value>& variables,
-              const std::unordered_map<
-                  std::string, std::function<Value(const std::vector<Value>&)>>&
-                  builtInFunctions) const override {
-    if (variables.find(name) != variables.end())
+  Symbol name;
+  std::optional<ExpressionNode*> expression;
+  std::optional<LambdaNode*> lambdaExpr;
+  bool mut;
+  bool memo;  // let f memo = (x) => ...; caches the lambda's results
+  int slot = -1;  // set by the Resolver
+
+  VariableDeclarationNode(Symbol name,
+                          std::optional<ExpressionNode*> expr,
+                          std::optional<LambdaNode*> lambdaExpr,
+                          bool mut,
+                          bool memo = false)
+      : ASTNode(KIND),
+        name(name),
+        expression(expr),
+        lambdaExpr(lambdaExpr),
+        mut(mut),
+        memo(memo) {}
+
+  Value visit(Environment& env) const override {
+    if (env.defined[slot])
       throw std::runtime_error("Variable with identifier already exists!");
     Value value;
     if (!expression.has_value() && !lambdaExpr.has_value())
       value = Value();
     else if (expression.has_value() && !lambdaExpr.has_value())
-      value = (*expression)->evaluate(variables, builtInFunctions);
+      value = (*expression)->evaluate(env);
     else
-      value = Value((*lambdaExpr));
-    value.setMutable(mut);
-    variables[name] = value;
+      value = (*lambdaExpr)->evaluate(env);
+    env.define(slot, value, mut);
     return value;
   }
 
   std::string to_string(int indent = 0) const override {
     std::string result =
-        std::string(indent, ' ') + "Variable Declaration: " + name;
+        std::string(indent, ' ') + "Variable Declaration: " + symbolName(name);
     if (expression) result += " = (" + (*expression)->to_string() + ")";
+    if (lambdaExpr) result += " = " + (*lambdaExpr)->to_string();
     return result;
   }
 };
 
 // all function calls for both built-in and user-defined functions
 struct FunctionCallNode : public ExpressionNode {
-  std::string functionName;
-  std::vector<std::unique_ptr<ExpressionNode>> arguments;
-
-  FunctionCallNode(const std::string& name,
-                   std::vector<std::unique_ptr<ExpressionNode>> args)
-      : functionName(name), arguments(std::move(args)) {}
-
-  Value evaluate(
-      std::unordered_map<std::string, Value>& variables,
-      const std::unordered_map<std::string,
-                               std::function<Value(const std::vector<Value>&)>>&
-          builtInFunctions) const override {
-    std::vector<Value> evaluatedArgs;
-    for (const std::unique_ptr<ExpressionNode>& arg : arguments)
-      evaluatedArgs.push_back(arg->evaluate(variables, builtInFunctions));
-
-    // for built-in functions
-    auto func = builtInFunctions.find(functionName);
-    if (func != builtInFunctions.end()) return func->second(evaluatedArgs);
-
-    // for lambda functions
-    for (auto& var : variables) {
-      auto lambda = var.second.asLambda();
-      // this means that a global var already exists with the same name as the
-      // arg
-      if (functionName != var.first || !var.second.isLambda()) continue;
-      for (std::string arg : lambda->arguments)
-        if (variables.find(arg) != variables.end())
-          throw std::runtime_error("Variable with identifier already exists!");
-      if (evaluatedArgs.size() != lambda->arguments.size())
-        throw std::runtime_error("Input count mismatch");
-      for (int i = 0; i < evaluatedArgs.size(); i++)
-        variables[lambda->arguments[i]] = evaluatedArgs[i];
-      return lambda->visit(variables, builtInFunctions);
+  static constexpr NodeKind KIND = NodeKind::FunctionCall;
+
+  Symbol functionName;
+  NodeList<ExpressionNode> arguments;
+  int builtIn = -1;  // set by the Resolver, index into Environment::builtIns
+  int slot = -1;     // otherwise the global slot holding the lambda
+  int local = -1;    // or the argument index holding it
+  bool piped = false;  // a pipeline stage, the piped value comes first
+  int position = -1;   // offset of the name in the source, -1 if made up
+
+  FunctionCallNode(Symbol name,
+                   NodeList<ExpressionNode> args)
+      : ExpressionNode(KIND), functionName(name), arguments(args) {}
+
+  size_t argumentCount() const { return arguments.size() + (piped ? 1 : 0); }
+
+  Value evaluate(Environment& env) const override { return call(env, nullptr); }
+
+  // the arguments are evaluated onto the environment's stack. a built-in
+  // reads them there, for a lambda they become the callee's frame
+  Value call(Environment& env, Value* pipedValue) const {
+    const size_t base = env.stack.size();
+    if (pipedValue) env.stack.push_back(std::move(*pipedValue));
+    for (const ExpressionNode* arg : arguments)
+      env.stack.push_back(arg->evaluate(env));
+
+    if (builtIn >= 0) {
+      Profiler::Call profile(functionName, true, position);
+      Trace::Scope trace(Trace::Kind::BuiltIn, functionName);
+      Value result = (*env.builtIns[builtIn])(
+          Arguments{env.stack.data() + base, env.stack.size() - base, &env});
+      env.stack.resize(base);
+      return result;
     }
-    throw std::runtime_error("Unknown function: " + functionName);
+
+    const Value& callee =
+        local >= 0 ? env.stack[env.frameBase + local] : env.globals[slot];
+    if ((local < 0 && !env.defined[slot]) || !callee.isLambda())
+      throw std::runtime_error("Unknown function: " + symbolName(functionName));
+    const LambdaNode* lambda = callee.asLambda().get();
+    if (env.stack.size() - base != lambda->arguments.size())
+      throw std::runtime_error("Input count mismatch");
+    return lambda->call(env, base, position);
   }
 
-  Value visit(std::unordered_map<std::string, Value>& variables,
-              const std::unordered_map<
-                  std::string, std::function<Value(const std::vector<Value>&)>>&
-                  builtInFunctions) const override {
-    return evaluate(variables, builtInFunctions);
+  Value visit(Environment& env) const override {
+    return evaluate(env);
   }
 
   std::string to_string(int indent = 0) const override {
     std::string str =
-        std::string(indent, ' ') + "FunctionCall: " + functionName + "(";
+        std::string(indent, ' ') + "FunctionCall: " + symbolName(functionName) + "(";
+    if (piped) str += "|>, ";
     for (const auto& arg : arguments) str += arg->to_string() + ", ";
-    str.pop_back();
-    str.pop_back();
+    if (argumentCount() > 0) {
+      str.pop_back();
+      str.pop_back();
+    }
     str += ")";
     return str;
   }
 };
 
 struct UnaryOperationNode : public ExpressionNode {
- private:
+  static constexpr NodeKind KIND = NodeKind::UnaryOperation;
+
   char op;  // The unary operator ('-' or '+')
-  std::unique_ptr<ExpressionNode> operand;
+  ExpressionNode* operand;
 
- public:
-  UnaryOperationNode(char op, std::unique_ptr<ExpressionNode> operand)
-      : op(op), operand(std::move(operand)) {}
+  UnaryOperationNode(char op, ExpressionNode* operand)
+      : ExpressionNode(KIND), op(op), operand(operand) {}
 
-  Value visit(std::unordered_map<std::string, Value>& variables,
-              const std::unordered_map<
-                  std::string, std::function<Value(const std::vector<Value>&)>>&
-                  builtInFunctions) const override {
+  Value visit(Environment& env) const override {
     /* Doesn't do anything right now */
     return Value();
   }
 
-  Value evaluate(
-      std::unordered_map<std::string, Value>& variables,
-      const std::unordered_map<std::string,
-                               std::function<Value(const std::vector<Value>&)>>&
-          builtInFunctions) const override {
-    Value value = operand->evaluate(variables, builtInFunctions);
+  Value evaluate(Environment& env) const override {
+    Value value = operand->evaluate(env);
+    if (value.isArray()) return op == '-' ? value * Value(-1) : value;
     if (!value.isNumeric()) throw std::runtime_error("Invalid Unary Operand");
     if (op == '-') {
       if (value.isInt())
-        return Value(-value.asInt());
+        return Value(Arithmetic::subtract(0, value.asInt()));
       else if (value.isDouble())
         return Value(-value.asDouble());
     } else
@@ -362,6 +530,126 @@ struct UnaryOperationNode : public ExpressionNode {
   }
 
   std::string to_string(int indent = 0) const override {
-    return "Unary Operation";
+    return std::string(indent, ' ') + "UNARY-EXPR: (" + op +
+           operand->to_string() + ")";
+  }
+};
+
+/*
+x |> f |> g(y), the source's value is passed through every stage in turn.
+the stages are calls marked piped, which take it as their first argument
+*/
+struct PipelineNode : public ExpressionNode {
+  static constexpr NodeKind KIND = NodeKind::Pipeline;
+
+  ExpressionNode* source;
+  NodeList<FunctionCallNode> stages;
+
+  PipelineNode(ExpressionNode* source, NodeList<FunctionCallNode> stages)
+      : ExpressionNode(KIND), source(source), stages(stages) {}
+
+  Value evaluate(Environment& env) const override {
+    Value value = source->evaluate(env);
+    for (const FunctionCallNode* stage : stages)
+      value = stage->call(env, &value);
+    return value;
+  }
+
+  Value visit(Environment& env) const override { return evaluate(env); }
+
+  std::string to_string(int indent = 0) const override {
+    std::string str =
+        std::string(indent, ' ') + "PIPELINE: " + source->to_string();
+    for (const FunctionCallNode* stage : stages)
+      str += " |> " + stage->to_string();
+    return str;
+  }
+};
+
+// array literals like [1, 2.5, x]
+struct ArrayNode : public ExpressionNode {
+  static constexpr NodeKind KIND = NodeKind::Array;
+
+  NodeList<ExpressionNode> elements;
+
+  ArrayNode(NodeList<ExpressionNode> elements)
+      : ExpressionNode(KIND), elements(elements) {}
+
+  // the elements are evaluated onto the stack and copied out from there
+  Value evaluate(Environment& env) const override {
+    const size_t base = env.stack.size();
+    for (const ExpressionNode* element : elements)
+      env.stack.push_back(element->evaluate(env));
+    Value array = Value::array(env.stack.data() + base, elements.size());
+    env.stack.resize(base);
+    return array;
+  }
+
+  // like the other operations, a statement on its own doesn't run
+  Value visit(Environment&) const override { return Value(); }
+
+  std::string to_string(int indent = 0) const override {
+    std::string str = std::string(indent, ' ') + "ARRAY: [";
+    for (const ExpressionNode* element : elements)
+      str += element->to_string() + ", ";
+    if (!elements.empty()) {
+      str.pop_back();
+      str.pop_back();
+    }
+    return str + "]";
+  }
+};
+
+// a[i]
+struct IndexNode : public ExpressionNode {
+  static constexpr NodeKind KIND = NodeKind::Index;
+
+  ExpressionNode* array;
+  ExpressionNode* index;
+
+  IndexNode(ExpressionNode* array, ExpressionNode* index)
+      : ExpressionNode(KIND), array(array), index(index) {}
+
+  Value evaluate(Environment& env) const override {
+    return array->evaluate(env)[index->evaluate(env)];
+  }
+
+  // like the other operations, a statement on its own doesn't run
+  Value visit(Environment&) const override { return Value(); }
+
+  std::string to_string(int indent = 0) const override {
+    return std::string(indent, ' ') + "INDEX: (" + array->to_string() + "[" +
+           index->to_string() + "])";
+  }
+};
+
+/*
+binds value to a frame local for as long as body runs, reads of it are
+VariableNodes with that local index. only the optimizer creates these, at the
+root of a statement or lambda body, where `local` is the next free slot of
+the frame.
+*/
+struct LocalBindingNode : public ExpressionNode {
+  static constexpr NodeKind KIND = NodeKind::LocalBinding;
+
+  int local;
+  ExpressionNode* value;
+  ExpressionNode* body;
+
+  LocalBindingNode(int local, ExpressionNode* value, ExpressionNode* body)
+      : ExpressionNode(KIND), local(local), value(value), body(body) {}
+
+  Value evaluate(Environment& env) const override {
+    env.stack.push_back(value->evaluate(env));
+    Value result = body->evaluate(env);
+    env.stack.pop_back();
+    return result;
+  }
+
+  Value visit(Environment& env) const override { return evaluate(env); }
+
+  std::string to_string(int indent = 0) const override {
+    return std::string(indent, ' ') + "LOCAL $" + std::to_string(local) +
+           " = (" + value->to_string() + ") IN " + body->to_string();
   }
 };
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../Runtime/Memory.h"
+
+/*
+bump allocator for AST nodes. memory comes from a few large blocks and is
+only given back when the arena dies, at which point the destructors of
+everything that needs one run in reverse order of construction.
+*/
+class Arena {
+ public:
+  static constexpr size_t FIRST_BLOCK_SIZE = 16 * 1024;
+  static constexpr size_t MAX_BLOCK_SIZE = 1024 * 1024;
+
+  Arena() = default;
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+  ~Arena() {
+    for (Cleanup* c = cleanups; c; c = c->next) c->destroy(c->object);
+    for (Block& block : blocks) {
+      Memory::freed(Memory::Ast, block.size);
+      ::operator delete(block.data);
+    }
+  }
+
+  void* allocate(size_t size, size_t alignment) {
+    uintptr_t aligned = (reinterpret_cast<uintptr_t>(cursor) + alignment - 1) &
+                        ~(uintptr_t(alignment) - 1);
+    if (!cursor || aligned + size > reinterpret_cast<uintptr_t>(limit)) {
+      grow(size + alignment);
+      aligned = (reinterpret_cast<uintptr_t>(cursor) + alignment - 1) &
+                ~(uintptr_t(alignment) - 1);
+    }
+    cursor = reinterpret_cast<char*>(aligned + size);
+    used += size;
+    return reinterpret_cast<void*>(aligned);
+  }
+
+  template <typename T, typename... Args>
+  T* make(Args&&... args) {
+    T* object = new (allocate(sizeof(T), alignof(T)))
+        T(std::forward<Args>(args)...);
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+      Cleanup* c = new (allocate(sizeof(Cleanup), alignof(Cleanup)))
+          Cleanup{[](void* p) { static_cast<T*>(p)->~T(); }, object, cleanups};
+      cleanups = c;
+    }
+    return object;
+  }
+
+  // a copy of items that lives as long as the arena
+  template <typename T>
+  T* copy(const std::vector<T>& items) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    if (items.empty()) return nullptr;
+    T* data = static_cast<T*>(allocate(sizeof(T) * items.size(), alignof(T)));
+    std::uninitialized_copy(items.begin(), items.end(), data);
+    return data;
+  }
+
+  size_t bytesUsed() const { return used; }
+  size_t bytesReserved() const { return reserved; }
+  size_t blockCount() const { return blocks.size(); }
+
+ private:
+  struct Block {
+    char* data;
+    size_t size;
+  };
+  struct Cleanup {
+    void (*destroy)(void*);
+    void* object;
+    Cleanup* next;
+  };
+
+  void grow(size_t atLeast) {
+    size_t size = blocks.empty() ? FIRST_BLOCK_SIZE
+                                 : std::min(blocks.back().size * 2,
+                                            MAX_BLOCK_SIZE);
+    if (size < atLeast) size = atLeast;
+    char* data = static_cast<char*>(::operator new(size));
+    Memory::allocated(Memory::Ast, size);
+    blocks.push_back({data, size});
+    cursor = data;
+    limit = data + size;
+    reserved += size;
+  }
+
+  std::vector<Block> blocks;
+  char* cursor = nullptr;
+  char* limit = nullptr;
+  Cleanup* cleanups = nullptr;
+  size_t used = 0;
+  size_t reserved = 0;
+};
+
+// a fixed list of child nodes stored in an arena
+template <typename T>
+struct NodeList {
+  T** items = nullptr;
+  size_t count = 0;
+
+  NodeList() = default;
+  NodeList(Arena& arena, const std::vector<T*>& nodes)
+      : items(arena.copy(nodes)), count(nodes.size()) {}
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  T*& operator[](size_t i) { return items[i]; }
+  T* operator[](size_t i) const { return items[i]; }
+  T** begin() { return items; }
+  T** end() { return items + count; }
+  T* const* begin() const { return items; }
+  T* const* end() const { return items + count; }
+};
@@ -0,0 +1,17 @@
+#include "Environment.h"
+
+#include "AST.h"
+
+Value Environment::call(const Value& callee, const Value* arguments,
+                        size_t count) {
+  if (!callee.isLambda()) throw std::runtime_error("Expected a lambda");
+  // the value keeps the lambda, and the arena it lives in, alive
+  const Value function = callee;
+  const LambdaNode* lambda = function.asLambda().get();
+  if (count != lambda->arguments.size())
+    throw std::runtime_error("Input count mismatch");
+
+  const size_t base = stack.size();
+  stack.insert(stack.end(), arguments, arguments + count);
+  return lambda->call(*this, base);
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../Runtime/Memory.h"
+#include "../Types/Symbol.h"
+#include "../Types/Value.h"
+
+struct Environment;
+
+// the evaluated arguments of a built-in call, read in place from wherever
+// the caller put them
+struct Arguments {
+  const Value* values;
+  size_t count;
+  // the caller's, for built-ins that call lambdas. the values may live on
+  // its stack, so copy them before calling into it
+  Environment* env = nullptr;
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  const Value& operator[](size_t i) const { return values[i]; }
+  const Value* begin() const { return values; }
+  const Value* end() const { return values + count; }
+};
+
+using BuiltInFunction = std::function<Value(Arguments)>;
+struct BuiltIn {
+  BuiltInFunction function;
+  bool pure;  // no side effects, same arguments give the same result
+  // impure only through the lambdas it runs, which its caller passed in and
+  // so accounts for (see StatementGraph). nothing it does on its own shows
+  bool throughLambdas = false;
+};
+using BuiltInMap = std::unordered_map<Symbol, BuiltIn>;
+
+// where a run's output goes. lambdas run by map, filter and reduce may print
+// from several threads at once, so lines are written under the lock
+struct Output {
+  std::ostream& stream;
+  std::mutex mutex;
+
+  explicit Output(std::ostream& stream) : stream(stream) {}
+  static Output& standard() {
+    static Output out(std::cout);
+    return out;
+  }
+
+  void line(const std::string& text) {
+    std::lock_guard<std::mutex> guard(mutex);
+    stream << text << "\n";
+  }
+};
+
+// runtime storage for a resolved program, every name is an index by now
+struct Environment {
+  // deep enough for real pipelines, shallow enough for the host stack
+  static constexpr size_t MAX_CALL_DEPTH = 2048;
+
+  // flags kept per binding in `defined`, mutability belongs to the name
+  static constexpr uint8_t DEFINED = 1;
+  static constexpr uint8_t MUTABLE = 2;
+
+  template <typename T>
+  using Slots = std::vector<T, CountedAllocator<T, Memory::Globals>>;
+
+  Slots<Value> globals;    // one slot per name the Resolver bound
+  Slots<uint8_t> defined;  // zero until a slot holds a value
+  std::vector<const BuiltInFunction*> builtIns;  // in ProgramNode::builtIns order
+  Output* output = &Output::standard();  // hosts may capture a run's output
+
+  // lambda arguments, every active call owns the values from frameBase up
+  std::vector<Value> stack;
+  size_t frameBase = 0;
+  size_t depth = 0;
+
+  Environment(size_t globalCount, std::vector<const BuiltInFunction*> builtIns)
+      : globals(globalCount), defined(globalCount, 0), builtIns(builtIns) {
+    stack.reserve(256);
+  }
+
+  void define(int slot, Value value, bool mut) {
+    globals[slot] = std::move(value);
+    defined[slot] = DEFINED | (mut ? MUTABLE : 0);
+  }
+  bool isMutable(int slot) const { return defined[slot] & MUTABLE; }
+  // make the values pushed since `base` the current frame. past the depth
+  // limit the values are popped again and nothing else changes
+  void enter(size_t base) {
+    if (depth >= MAX_CALL_DEPTH) {
+      stack.resize(base);
+      throw std::runtime_error("Stack overflow");
+    }
+    depth++;
+    frameBase = base;
+  }
+  // pop the current frame and return to the caller's
+  void leave(size_t base, size_t callerBase) {
+    stack.resize(base);
+    frameBase = callerBase;
+    depth--;
+  }
+
+  // the current frame for as long as it's in scope, left even when the body
+  // throws so an environment that outlives an error is back at its caller's
+  class Frame {
+   public:
+    Frame(Environment& env, size_t base)
+        : env(env), base(base), callerBase(env.frameBase) {
+      env.enter(base);
+    }
+    Frame(const Frame&) = delete;
+    Frame& operator=(const Frame&) = delete;
+    ~Frame() { env.leave(base, callerBase); }
+
+   private:
+    Environment& env;
+    size_t base;
+    size_t callerBase;
+  };
+
+  // calls a lambda value from outside the tree, e.g. from a built-in.
+  // arguments must not point into this environment's stack
+  Value call(const Value& callee, const Value* arguments, size_t count);
+
+  // an environment for another thread running lambdas of this program. it
+  // sees the same globals, which nothing assigns while lambdas run, and has
+  // a stack of its own
+  Environment worker() const {
+    Environment env(0, builtIns);
+    env.output = output;
+    env.globals = globals;
+    env.defined = defined;
+    return env;
+  }
+};
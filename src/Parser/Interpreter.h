@@ -1,13 +1,224 @@
 #pragma once
 
 #include "AST.h"
+#include "Parser.h"
+#include "Resolver.h"
+#include "StatementGraph.h"
+#include "../Lexer/Lexer.h"
+#include "../Lexer/StatementReader.h"
+#include "../Optimizer/PassManager.h"
+#include "../Runtime/Memory.h"
+#include "../Runtime/Parallel.h"
+#include "../Runtime/ThreadPool.h"
+#include "../Runtime/Trace.h"
+#include "../VM/Compiler.h"
+#include "../VM/VM.h"
 
+#include <iostream>
 #include <memory>
 
+enum class ExecutionMode {
+    Bytecode,  // compile to bytecode and run it on the VM
+    TreeWalk   // reference mode, visit the AST directly
+};
+
+struct RunOptions {
+    ExecutionMode mode = ExecutionMode::Bytecode;
+    bool optimize = true;         // run the optimizer's passes first
+    bool dumpOptimized = false;   // print the tree the passes leave behind
+    bool inlineReport = false;    // print what the inliner did and didn't do
+    bool typeReport = false;      // print the arithmetic left untyped
+    bool memoStats = false;       // print the memo lambdas' cache hits
+    bool jitStats = false;        // print how much the JIT compiled
+    bool parallel = false;        // run independent statements at once
+    Output* output = nullptr;     // where it prints, std::cout if null
+};
+
 class Interpreter {
 public:
-    static void walkAST(const std::unique_ptr<ProgramNode>& program) {
-        std::unordered_map<std::string, Value> variables;
-        program->visit(variables, Lexer::BUILT_IN_FUNCTIONS);
+    static void walkAST(const std::unique_ptr<ProgramNode>& program,
+                        const RunOptions& options = {}) {
+        Memory::Scope memory(Memory::Eval);
+        {
+            Trace::Scope trace(Trace::Kind::Phase, Trace::Resolve);
+            Resolver::resolve(*program, Lexer::BUILT_IN_FUNCTIONS);
+        }
+        if (options.optimize) {
+            Trace::Scope trace(Trace::Kind::Phase, Trace::Optimize);
+            optimizer(options).run(*program);
+        }
+        Environment env = makeEnvironment(*program);
+        if (options.output) env.output = options.output;
+        if (options.parallel) {
+            walkParallel(*program, env, options);
+        } else if (options.mode == ExecutionMode::TreeWalk) {
+            Trace::Scope trace(Trace::Kind::Phase, Trace::Run);
+            program->visit(env);
+        } else if (Trace::isEnabled()) {
+            // statement by statement, so each gets its own span
+            BytecodeProgram bytecode;
+            Compiler compiler(bytecode, *program);
+            VM vm(bytecode);
+            const auto& statements = program->statements;
+            for (size_t i = 0; i < statements.size(); i++) {
+                Trace::Scope statement(Trace::Kind::Statement,
+                                       static_cast<uint32_t>(i));
+                Trace::Scope compile(Trace::Kind::Phase, Trace::Compile);
+                Function script = compiler.compileScript(*statements[i]);
+                compile.close();
+                Trace::Scope run(Trace::Kind::Phase, Trace::Run);
+                vm.run(env, script);
+            }
+        } else {
+            BytecodeProgram bytecode = Compiler::compile(*program);
+            VM(bytecode).run(env);
+        }
+        printStats(*program, options);
+    }
+
+    // the statements a level of the StatementGraph at a time, each level's
+    // on the thread pool
+    static void walkParallel(const ProgramNode& program, Environment& env,
+                             const RunOptions& options) {
+        const StatementGraph graph(program, Lexer::BUILT_IN_FUNCTIONS);
+        const auto& statements = program.statements;
+        if (options.mode == ExecutionMode::TreeWalk) {
+            Trace::Scope trace(Trace::Kind::Phase, Trace::Run);
+            Parallel::runStatements(
+                graph, env, [&](size_t i, Environment& in, size_t) {
+                    statements[i]->visit(in);
+                });
+            return;
+        }
+
+        BytecodeProgram bytecode;
+        std::vector<Function> scripts;
+        {
+            Trace::Scope trace(Trace::Kind::Phase, Trace::Compile);
+            Compiler compiler(bytecode, program);
+            for (const ASTNode* stmt : statements)
+                scripts.push_back(compiler.compileScript(*stmt));
+        }
+        // a VM per pool slot, made by the slot's thread
+        std::vector<std::unique_ptr<VM>> vms(
+            ThreadPool::shared().workerCount());
+        Trace::Scope trace(Trace::Kind::Phase, Trace::Run);
+        Parallel::runStatements(
+            graph, env, [&](size_t i, Environment& in, size_t worker) {
+                if (!vms[worker]) vms[worker] = std::make_unique<VM>(bytecode);
+                vms[worker]->run(in, scripts[i]);
+            });
+    }
+
+    // lexes, parses and runs one top-level statement at a time as the source
+    // is read, only the statement being run is ever held in memory
+    static void walkStream(Source& source, const RunOptions& options = {}) {
+        StatementReader reader(source);
+        ProgramNode globals({}, nullptr);  // only collects the Resolver's tables
+        Resolver resolver(globals, Lexer::BUILT_IN_FUNCTIONS);
+        PassManager passes = optimizer(options);
+        Environment env = makeEnvironment(globals);
+        if (options.output) env.output = options.output;
+        BytecodeProgram bytecode;
+        Compiler compiler(bytecode, globals);
+        VM vm(bytecode);
+
+        std::string_view text;
+        uint32_t index = 0;
+        while (reader.next(text)) {
+            if (Profiler::isEnabled())
+                Profiler::addSource(text, reader.offset());
+            Trace::Scope statement(Trace::Kind::Statement, index++);
+            TokenStream tokens = lex(text);
+            Parser parser(tokens, static_cast<int>(reader.offset()));
+            while (ASTNode* stmt = parse(parser)) {
+                Memory::Scope memory(Memory::Eval);
+                {
+                    Trace::Scope trace(Trace::Kind::Phase, Trace::Resolve);
+                    resolver.resolveStatement(*stmt);
+                }
+                if (options.optimize) {
+                    Trace::Scope trace(Trace::Kind::Phase, Trace::Optimize);
+                    passes.runStatement(stmt, globals, parser.getArena());
+                }
+                syncEnvironment(globals, env);
+                if (options.mode == ExecutionMode::TreeWalk) {
+                    Trace::Scope trace(Trace::Kind::Phase, Trace::Run);
+                    stmt->visit(env);
+                    continue;
+                }
+                Trace::Scope compile(Trace::Kind::Phase, Trace::Compile);
+                Function script = compiler.compileScript(*stmt);
+                compile.close();
+                Trace::Scope run(Trace::Kind::Phase, Trace::Run);
+                vm.run(env, script);
+            }
+        }
+        printStats(globals, options);
+    }
+
+    // the front end's phases, as --trace and --mem-stats see them
+    static TokenStream lex(std::string_view text) {
+        Trace::Scope trace(Trace::Kind::Phase, Trace::Lex);
+        Memory::Scope memory(Memory::Lex);
+        return Lexer::tokenize(text);
+    }
+    static std::unique_ptr<ProgramNode> parse(const TokenStream& tokens) {
+        Trace::Scope trace(Trace::Kind::Phase, Trace::Parse);
+        Memory::Scope memory(Memory::Parse);
+        return Parser(tokens).parse();
+    }
+    // the next statement, nullptr once the parser's tokens run out
+    static ASTNode* parse(Parser& parser) {
+        Trace::Scope trace(Trace::Kind::Phase, Trace::Parse);
+        Memory::Scope memory(Memory::Parse);
+        return parser.parseStatement();
+    }
+
+    // to stderr, so it doesn't mix with what the program prints
+    static void printStats(const ProgramNode& program,
+                           const RunOptions& options) {
+        if (options.jitStats)
+            std::cerr << "jit: " << Jit::compiledCount()
+                      << " functions compiled, " << Jit::bailoutCount()
+                      << " bailouts\n";
+        if (!options.memoStats) return;
+        for (const auto& lambda : program.memoized) {
+            std::cerr << "memo " << symbolName(lambda->functionName) << ": ";
+            if (!lambda->cache)
+                std::cerr << (MemoCache::isEnabled() ? "not pure, not cached"
+                                                     : "disabled");
+            else
+                std::cerr << lambda->cache->hits() << " hits, "
+                          << lambda->cache->misses() << " misses, "
+                          << lambda->cache->size() << " cached";
+            std::cerr << "\n";
+        }
+    }
+
+    // the reports go to stderr, like the stats, so they don't mix with what
+    // the program prints
+    static PassManager optimizer(const RunOptions& options) {
+        std::ostream* out = &std::cerr;
+        PassManager passes = PassManager::standard(
+            Lexer::BUILT_IN_FUNCTIONS, options.inlineReport ? out : nullptr,
+            options.typeReport ? out : nullptr);
+        if (options.dumpOptimized) passes.dump = out;
+        return passes;
+    }
+
+    static Environment makeEnvironment(const ProgramNode& program) {
+        Environment env(0, {});
+        syncEnvironment(program, env);
+        return env;
+    }
+
+    // grow the environment to cover every slot and built-in bound so far
+    static void syncEnvironment(const ProgramNode& program, Environment& env) {
+        env.globals.resize(program.globals.size());
+        env.defined.resize(program.globals.size(), 0);
+        for (size_t i = env.builtIns.size(); i < program.builtIns.size(); i++)
+            env.builtIns.push_back(
+                &Lexer::BUILT_IN_FUNCTIONS.at(program.builtIns[i]).function);
     }
-};
\ No newline at end of file
+};
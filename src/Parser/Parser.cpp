@@ -1,5 +1,6 @@
 #include "Parser.h"
 
+#include <charconv>
 #include <memory>
 #include <optional>
 #include <stdexcept>
@@ -9,70 +10,61 @@
 // HELPER METHODS
 //
 
-bool Parser::check(TokenType type, std::string value) const {
-  return !isAtEnd() && tokens[current].type == type &&
-         tokens[current].value == value;
+bool Parser::is(size_t index, TokenType type, Symbol symbol) const {
+  return index < tokens.size() && tokens.type(index) == type &&
+         tokens.symbol(index) == symbol;
+}
+
+bool Parser::check(TokenType type, Symbol symbol) const {
+  return !isAtEnd() && is(current, type, symbol);
 }
 
 bool Parser::check(TokenType type) const {
-  return !isAtEnd() && tokens[current].type == type;
+  return !isAtEnd() && tokens.type(current) == type;
 }
 
 bool Parser::checkNext(TokenType type) const {
   return !isAtEnd() && current + 1 < tokens.size() &&
-         tokens[current + 1].type == type;
+         tokens.type(current + 1) == type;
 }
 
-bool Parser::checkNext(TokenType type, std::string value) const {
-  return !isAtEnd() && current + 1 < tokens.size() &&
-         tokens[current + 1].type == type && tokens[current + 1].value == value;
+bool Parser::checkNext(TokenType type, Symbol symbol) const {
+  return !isAtEnd() && is(current + 1, type, symbol);
 }
 
-const Token& Parser::expect(TokenType type) {
-  if (isAtEnd() || tokens[current].type != type) {
-    std::cout << (tokens[current].type != type);
-    std::cout << "\nExpected " + tokens[current].tokenTypeToString(type) +
-                     " but got " +
-                     tokens[current].tokenTypeToString(tokens[current].type) +
-                     "\n";
-    throw std::runtime_error(
-        "Expected " + tokens[current].tokenTypeToString(type) + " but got " +
-        tokens[current].tokenTypeToString(type));
-  }
-  return tokens[current++];
+Symbol Parser::expect(TokenType type) {
+  if (isAtEnd() || tokens.type(current) != type) throw unexpected(type);
+  return tokens.symbol(current++);
 }
 
-const Token& Parser::expect(TokenType type, const std::string& value) {
-  if (isAtEnd() || tokens[current].type != type ||
-      tokens[current].value != value) {
-    std::cout << "\nExpected " + tokens[current].tokenTypeToString(type) +
-                     " but got " +
-                     tokens[current].tokenTypeToString(tokens[current].type) +
-                     "\n";
-    std::cout << current << '\n';
-    throw std::runtime_error(
-        "Expected " + tokens[current].tokenTypeToString(type) + " but got " +
-        tokens[current].tokenTypeToString(type));
-  }
-  return tokens[current++];
+Symbol Parser::expect(TokenType type, Symbol symbol) {
+  if (isAtEnd() || !is(current, type, symbol)) throw unexpected(type);
+  return tokens.symbol(current++);
+}
+
+std::runtime_error Parser::unexpected(TokenType expected) const {
+  const std::string got = current < tokens.size()
+                              ? Token::tokenTypeToString(tokens.type(current))
+                              : "the end of the input";
+  return std::runtime_error("Expected " + Token::tokenTypeToString(expected) +
+                            " but got " + got);
 }
 
 bool Parser::isAtEnd() const {
   return current >= tokens.size() ||
-         tokens[current].type == TokenType::EndOfFile;
+         tokens.type(current) == TokenType::EndOfFile;
 }
 
 bool Parser::match(TokenType type) {
-  if (!isAtEnd() && tokens[current].type == type) {
+  if (!isAtEnd() && tokens.type(current) == type) {
     advance();
     return true;
   }
   return false;
 }
 
-bool Parser::match(TokenType type, std::string value) {
-  if (!isAtEnd() && tokens[current].type == type &&
-      tokens[current].value == value) {
+bool Parser::match(TokenType type, Symbol symbol) {
+  if (!isAtEnd() && is(current, type, symbol)) {
     advance();
     return true;
   }
@@ -83,9 +75,38 @@ void Parser::advance() {
   if (!isAtEnd()) current++;
 }
 
-Token Parser::previous() {
+// `(` `)` `=>`, `(` ident `)` `=>` or `(` ident `,` starts a lambda
+bool Parser::isLambdaAhead() const {
+  if (!check(TokenType::Delimiter, Symbols::LeftParen)) return false;
+  if (is(current + 1, TokenType::Delimiter, Symbols::RightParen))
+    return is(current + 2, TokenType::Operator, Symbols::Arrow);
+  if (current + 1 >= tokens.size() ||
+      tokens.type(current + 1) != TokenType::Identifier)
+    return false;
+  if (is(current + 2, TokenType::Delimiter, Symbols::Comma)) return true;
+  return is(current + 2, TokenType::Delimiter, Symbols::RightParen) &&
+         is(current + 3, TokenType::Operator, Symbols::Arrow);
+}
+
+std::string_view Parser::previous() const {
+  if (current <= 0) throw std::runtime_error("Invalid operation");
+  return tokens.value(current - 1);
+}
+
+Symbol Parser::previousSymbol() const {
   if (current <= 0) throw std::runtime_error("Invalid operation");
-  return tokens[current - 1];
+  return tokens.symbol(current - 1);
+}
+
+// numeric literals are parsed straight from the source, no copies
+template <typename T>
+static T parseNumber(std::string_view text) {
+  T result{};
+  auto [end, error] =
+      std::from_chars(text.data(), text.data() + text.size(), result);
+  if (error != std::errc()) throw std::runtime_error("Invalid number literal");
+  (void)end;
+  return result;
 }
 
 //
@@ -93,209 +114,249 @@ Token Parser::previous() {
 //
 
 std::unique_ptr<ProgramNode> Parser::parse() {
-  std::vector<std::unique_ptr<ASTNode>> statements;
-  while (!isAtEnd()) {
-    if (match(TokenType::LetKeyword))
-      statements.push_back(parseVariableDeclaration());
-    else if (check(TokenType::Identifier) &&
-             checkNext(TokenType::Operator, "="))
-      statements.push_back(parseAssignment());
-    else if (match(TokenType::Identifier))
-      statements.push_back(parseFunctionOrExpression());
-    else
-      throw std::runtime_error("Unexpected token");
-  }
-  return std::make_unique<ProgramNode>(std::move(statements));
+  std::vector<ASTNode*> statements;
+  while (ASTNode* stmt = parseStatement()) statements.push_back(stmt);
+  return std::make_unique<ProgramNode>(std::move(statements), arena);
+}
+
+ASTNode* Parser::parseStatement() {
+  if (isAtEnd()) return nullptr;
+  if (match(TokenType::LetKeyword)) return parseVariableDeclaration();
+  if (check(TokenType::Identifier) &&
+      checkNext(TokenType::Operator, Symbols::Equals))
+    return parseAssignment();
+  return parseExpressionStatement();
 }
 
-std::unique_ptr<ASTNode> Parser::parseFunctionOrExpression() {
-  if (check(TokenType::Delimiter, "(")) {
-    std::unique_ptr<ExpressionNode> v = parseFunctionCall();
-    expect(TokenType::Delimiter, ";");
-    return v;
-  } else
-    return parseExpression();
+// calls like print(x); as well as pipes like 5 |> increment |> print;
+ASTNode* Parser::parseExpressionStatement() {
+  ExpressionNode* expr = parseExpression();
+  expect(TokenType::Delimiter, Symbols::Semicolon);
+  return expr;
 }
 
-std::unique_ptr<ExpressionNode> Parser::parseTerm() {
+ExpressionNode* Parser::parseTerm() {
   if (match(TokenType::Int))
-    return std::make_unique<NumberNode>(std::stoi(previous().value));
+    return arena->make<NumberNode>(parseNumber<int>(previous()));
   else if (match(TokenType::Double))
-    return std::make_unique<NumberNode>(std::stod(previous().value));
+    return arena->make<NumberNode>(parseNumber<double>(previous()));
   else if (match(TokenType::Identifier))
-    return std::make_unique<VariableNode>(previous().value);
+    return arena->make<VariableNode>(previousSymbol());
 
   throw std::runtime_error("Expected a term (number or identifier)");
 }
 
-std::unique_ptr<ExpressionNode> Parser::parseExpression() {
+// a whole |> chain becomes one PipelineNode, f(y) in x |> f(y) is f(x, y)
+ExpressionNode* Parser::parseExpression() {
   auto left = parseAdditionSubtraction();
+  if (!check(TokenType::Operator, Symbols::Pipe)) return left;
 
-  while (match(TokenType::Operator, "|>")) {
+  std::vector<FunctionCallNode*> stages;
+  while (match(TokenType::Operator, Symbols::Pipe)) {
     if (!check(TokenType::Identifier))
       throw std::runtime_error("Expected function name after '|>' operator");
-    std::string functionName = expect(TokenType::Identifier).value;
+    const int position = offset + tokens.position(current);
+    Symbol functionName = expect(TokenType::Identifier);
 
-    std::vector<std::unique_ptr<ExpressionNode>> arguments;
-    arguments.push_back(std::move(left));
-
-    if (match(TokenType::Delimiter, "(")) {
+    std::vector<ExpressionNode*> arguments;
+    if (match(TokenType::Delimiter, Symbols::LeftParen)) {
       do {
         arguments.push_back(parseExpression());
-      } while (match(TokenType::Delimiter, ","));
-      expect(TokenType::Delimiter, ")");
+      } while (match(TokenType::Delimiter, Symbols::Comma));
+      expect(TokenType::Delimiter, Symbols::RightParen);
     }
 
-    left =
-        std::make_unique<FunctionCallNode>(functionName, std::move(arguments));
+    stages.push_back(arena->make<FunctionCallNode>(
+        functionName, NodeList<ExpressionNode>(*arena, arguments)));
+    stages.back()->piped = true;
+    stages.back()->position = position;
   }
 
-  return left;
+  return arena->make<PipelineNode>(
+      left, NodeList<FunctionCallNode>(*arena, stages));
 }
 
-std::unique_ptr<LambdaNode> Parser::parseLambdaExpression() {
-  std::string funcName = tokens[current - 2].value;
-  expect(TokenType::Delimiter, "(");
-  std::vector<std::string> arguments;
+LambdaNode* Parser::parseLambdaExpression() {
+  Symbol funcName = tokens.symbol(current - 2);
+  expect(TokenType::Delimiter, Symbols::LeftParen);
+  std::vector<Symbol> arguments;
 
-  if (!check(TokenType::Delimiter, ")")) {
+  if (!check(TokenType::Delimiter, Symbols::RightParen)) {
     do {
-      arguments.push_back(expect(TokenType::Identifier).value);
-    } while (match(TokenType::Delimiter, ","));
+      arguments.push_back(expect(TokenType::Identifier));
+    } while (match(TokenType::Delimiter, Symbols::Comma));
   }
-  expect(TokenType::Delimiter, ")");
-  expect(TokenType::Operator, "=>");
-  std::unique_ptr<ExpressionNode> body = parseExpression();
+  expect(TokenType::Delimiter, Symbols::RightParen);
+  expect(TokenType::Operator, Symbols::Arrow);
+  ExpressionNode* body = parseExpression();
 
-  return std::make_unique<LambdaNode>(funcName, arguments, std::move(body));
+  return arena->make<LambdaNode>(funcName, arguments, body);
 }
 
-std::unique_ptr<ExpressionNode> Parser::parsePipeExpression() {
+ExpressionNode* Parser::parsePipeExpression() {
   auto left = parseUnary();
 
-  while (match(TokenType::Operator, "|>")) {
+  while (match(TokenType::Operator, Symbols::Pipe)) {
     if (!check(TokenType::Identifier)) {
       throw std::runtime_error("Expected function name after '|>' operator");
     }
-    std::string functionName = expect(TokenType::Identifier).value;
-    std::vector<std::unique_ptr<ExpressionNode>> arguments;
-    arguments.push_back(std::move(left));
-    if (match(TokenType::Delimiter, "(")) {
+    Symbol functionName = expect(TokenType::Identifier);
+    std::vector<ExpressionNode*> arguments;
+    arguments.push_back(left);
+    if (match(TokenType::Delimiter, Symbols::LeftParen)) {
       do {
-      } while (match(TokenType::Delimiter, ","));
-      expect(TokenType::Delimiter, ")");
+      } while (match(TokenType::Delimiter, Symbols::Comma));
+      expect(TokenType::Delimiter, Symbols::RightParen);
     }
-    left =
-        std::make_unique<FunctionCallNode>(functionName, std::move(arguments));
+    left = arena->make<FunctionCallNode>(
+        functionName, NodeList<ExpressionNode>(*arena, arguments));
   }
 
   return left;
 }
 
-std::unique_ptr<ExpressionNode> Parser::parseAdditionSubtraction() {
-  std::unique_ptr<ExpressionNode> left = parseMultiplicationDivision();
+ExpressionNode* Parser::parseAdditionSubtraction() {
+  ExpressionNode* left = parseMultiplicationDivision();
 
   bool isOp = match(TokenType::Operator),
-       isAddOrSub = previous().value == "*" || previous().value == "/";
+       isAddOrSub = previousSymbol() == Symbols::Plus ||
+                   previousSymbol() == Symbols::Minus;
   while (isOp && isAddOrSub) {
-    char op = previous().value[0];
-    std::unique_ptr<ExpressionNode> right = parseMultiplicationDivision();
-    left = std::make_unique<BinaryOperationNode>(std::move(left), op,
-                                                 std::move(right));
+    char op = previous()[0];
+    ExpressionNode* right = parseMultiplicationDivision();
+    left = arena->make<BinaryOperationNode>(left, op, right);
+
+    isOp = match(TokenType::Operator);
+    isAddOrSub = previousSymbol() == Symbols::Plus ||
+                   previousSymbol() == Symbols::Minus;
   }
   if (isOp && !isAddOrSub) current--;
   return left;
 }
 
-std::unique_ptr<ExpressionNode> Parser::parseUnary() {
-  if (match(TokenType::Operator, "-")) {
+ExpressionNode* Parser::parseUnary() {
+  if (match(TokenType::Operator, Symbols::Minus)) {
     auto operand = parseUnary();
     // current++;
-    return std::make_unique<UnaryOperationNode>('-', std::move(operand));
-  } else if (match(TokenType::Operator, "+"))
+    return arena->make<UnaryOperationNode>('-', operand);
+  } else if (match(TokenType::Operator, Symbols::Plus))
     return parseUnary();
   else
-    return parsePrimary();
+    return parseIndex();
+}
+
+// a[i], also on any other primary like [1, 2][0] or f(x)[1]
+ExpressionNode* Parser::parseIndex() {
+  ExpressionNode* expr = parsePrimary();
+  while (match(TokenType::Delimiter, Symbols::LeftBracket)) {
+    ExpressionNode* index = parseExpression();
+    expect(TokenType::Delimiter, Symbols::RightBracket);
+    expr = arena->make<IndexNode>(expr, index);
+  }
+  return expr;
 }
 
-std::unique_ptr<ExpressionNode> Parser::parseMultiplicationDivision() {
-  std::unique_ptr<ExpressionNode> left = parseUnary();
+ExpressionNode* Parser::parseMultiplicationDivision() {
+  ExpressionNode* left = parseUnary();
 
   bool isOp = match(TokenType::Operator),
-       isMulOrDiv = previous().value == "*" || previous().value == "/";
+       isMulOrDiv = previousSymbol() == Symbols::Star ||
+                   previousSymbol() == Symbols::Slash;
   while (isOp && isMulOrDiv) {
-    char op = previous().value[0];
-    std::unique_ptr<ExpressionNode> right = parseUnary();
-    left = std::make_unique<BinaryOperationNode>(std::move(left), op,
-                                                 std::move(right));
+    char op = previous()[0];
+    ExpressionNode* right = parseUnary();
+    left = arena->make<BinaryOperationNode>(left, op, right);
 
     isOp = match(TokenType::Operator);
-    isMulOrDiv = previous().value == "*" || previous().value == "/";
+    isMulOrDiv = previousSymbol() == Symbols::Star ||
+                   previousSymbol() == Symbols::Slash;
   }
   if (isOp && !isMulOrDiv) current--;
   return left;
 }
 
-std::unique_ptr<ExpressionNode> Parser::parsePrimary() {
+ExpressionNode* Parser::parsePrimary() {
   if (match(TokenType::Int))
-    return std::make_unique<NumberNode>(std::stoi(previous().value));
+    return arena->make<NumberNode>(parseNumber<int>(previous()));
   else if (match(TokenType::Double))
-    return std::make_unique<NumberNode>(std::stod(previous().value));
+    return arena->make<NumberNode>(parseNumber<double>(previous()));
   else if (match(TokenType::Identifier)) {
-    std::string identifier = previous().value;
-    if (check(TokenType::Delimiter, "(")) return parseFunctionCall();
-    return std::make_unique<VariableNode>(identifier);
-  } else if (match(TokenType::Delimiter, "(")) {
-    std::unique_ptr<ExpressionNode> expr = parseExpression();
-    expect(TokenType::Delimiter, ")");
+    Symbol identifier = previousSymbol();
+    if (check(TokenType::Delimiter, Symbols::LeftParen)) return parseFunctionCall();
+    return arena->make<VariableNode>(identifier);
+  } else if (match(TokenType::Delimiter, Symbols::LeftParen)) {
+    ExpressionNode* expr = parseExpression();
+    expect(TokenType::Delimiter, Symbols::RightParen);
     return expr;
+  } else if (match(TokenType::Delimiter, Symbols::LeftBracket)) {
+    std::vector<ExpressionNode*> elements;
+    if (!check(TokenType::Delimiter, Symbols::RightBracket)) {
+      do {
+        elements.push_back(parseExpression());
+      } while (match(TokenType::Delimiter, Symbols::Comma));
+    }
+    expect(TokenType::Delimiter, Symbols::RightBracket);
+    return arena->make<ArrayNode>(NodeList<ExpressionNode>(*arena, elements));
   }
   throw std::runtime_error("Unexpected token in expression");
 }
 
-std::unique_ptr<VariableDeclarationNode> Parser::parseVariableDeclaration() {
-  const std::string varName = expect(TokenType::Identifier).value;
+VariableDeclarationNode* Parser::parseVariableDeclaration() {
+  const Symbol varName = expect(TokenType::Identifier);
   const bool mut = match(TokenType::MutableKeyword);
+  // memo is only a keyword here, elsewhere it's a name like any other
+  const bool memo = match(TokenType::Identifier, Symbols::Memo);
 
-  std::optional<std::unique_ptr<ExpressionNode>> expr = std::nullopt;
-  std::optional<std::shared_ptr<LambdaNode>> lambdaExpr =
+  std::optional<ExpressionNode*> expr = std::nullopt;
+  std::optional<LambdaNode*> lambdaExpr =
       std::nullopt;  // issues with lambdaExpr being not a nullptr but
                      // expression is, causing issues with Value having weird
                      // types
 
-  if (match(TokenType::Operator, "=")) {
-    if (current < tokens.size() - 2 && check(TokenType::Delimiter, "(") &&
-        tokens[current + 2].value == ",")
-      lambdaExpr = std::make_shared<LambdaNode>(parseLambdaExpression());
-    else
+  if (match(TokenType::Operator, Symbols::Equals)) {
+    if (isLambdaAhead()) {
+      // lambda values share ownership of the whole arena, so they stay valid
+      // after the program or a streamed statement is dropped
+      LambdaNode* lambda = parseLambdaExpression();
+      lambda->functionName = varName;  // not a mut or memo in between
+      lambda->self = std::shared_ptr<const LambdaNode>(arena, lambda);
+      lambdaExpr = lambda;
+    } else
       expr = parseExpression();
   }
-  if (tokens[current - 1].value != ";") expect(TokenType::Delimiter, ";");
+  if (memo && !lambdaExpr.has_value())
+    throw std::runtime_error("Only lambdas can be memoized");
+  if (tokens.symbol(current - 1) != Symbols::Semicolon)
+    expect(TokenType::Delimiter, Symbols::Semicolon);
 
-  return std::make_unique<VariableDeclarationNode>(varName, std::move(expr),
-                                                   std::move(lambdaExpr), mut);
+  return arena->make<VariableDeclarationNode>(varName, expr, lambdaExpr, mut,
+                                             memo);
 }
 
-std::unique_ptr<ExpressionNode> Parser::parseFunctionCall() {
-  std::string functionName = previous().value;
-  expect(TokenType::Delimiter, "(");
+ExpressionNode* Parser::parseFunctionCall() {
+  Symbol functionName = previousSymbol();
+  const int position = offset + tokens.position(current - 1);
+  expect(TokenType::Delimiter, Symbols::LeftParen);
 
-  std::vector<std::unique_ptr<ExpressionNode>> arguments;
+  std::vector<ExpressionNode*> arguments;
 
-  if (!check(TokenType::Delimiter, ")")) {
+  if (!check(TokenType::Delimiter, Symbols::RightParen)) {
     do {
       arguments.push_back(parseExpression());
-    } while (match(TokenType::Delimiter, ","));
+    } while (match(TokenType::Delimiter, Symbols::Comma));
   }
 
-  expect(TokenType::Delimiter, ")");
-  return std::make_unique<FunctionCallNode>(functionName, std::move(arguments));
+  expect(TokenType::Delimiter, Symbols::RightParen);
+  FunctionCallNode* call = arena->make<FunctionCallNode>(
+      functionName, NodeList<ExpressionNode>(*arena, arguments));
+  call->position = position;
+  return call;
 }
 
-std::unique_ptr<AssignmentNode> Parser::parseAssignment() {
-  std::string name = expect(TokenType::Identifier).value;
-  expect(TokenType::Operator, "=");
-  std::unique_ptr<ExpressionNode> expression = parseExpression();
-  expect(TokenType::Delimiter, ";");
-  return std::make_unique<AssignmentNode>(name, std::move(expression));
+AssignmentNode* Parser::parseAssignment() {
+  Symbol name = expect(TokenType::Identifier);
+  expect(TokenType::Operator, Symbols::Equals);
+  ExpressionNode* expression = parseExpression();
+  expect(TokenType::Delimiter, Symbols::Semicolon);
+  return arena->make<AssignmentNode>(name, expression);
 }
@@ -1,50 +1,71 @@
 #pragma once
 
 #include <memory>
-#include <vector>
+#include <stdexcept>
+#include <string_view>
 
 #include "../Types/Token.h"
 #include "AST.h"
 
 class Parser {
  public:
-  Parser(const std::vector<Token>& tokens) : tokens(tokens), current(0) {}
+  // the stream is read in place, it has to outlive the parser. offset is
+  // where the tokens' source starts in the whole input, positions count
+  // from there
+  Parser(const TokenStream& tokens, int offset = 0)
+      : tokens(tokens),
+        current(0),
+        offset(offset),
+        arena(std::make_shared<Arena>()) {}
 
+  // the program takes shared ownership of the arena holding its nodes
   std::unique_ptr<ProgramNode> parse();
+  // the next top-level statement, nullptr once the tokens run out. the node
+  // lives in the parser's arena
+  ASTNode* parseStatement();
+
+  Arena& getArena() { return *arena; }
 
  private:
-  std::vector<Token> tokens;
+  const TokenStream& tokens;
   size_t current;
+  int offset;
+  std::shared_ptr<Arena> arena;
 
  private:
   bool isAtEnd() const;
+  bool is(size_t index, TokenType type, Symbol symbol) const;
 
   bool match(TokenType type);
   bool check(TokenType type) const;
   bool checkNext(TokenType type) const;
 
-  bool check(TokenType type, std::string value) const;
-  bool checkNext(TokenType type, std::string value) const;
-  bool match(TokenType type, std::string value);
+  bool check(TokenType type, Symbol symbol) const;
+  bool checkNext(TokenType type, Symbol symbol) const;
+  bool match(TokenType type, Symbol symbol);
 
   void advance();
-  const Token& expect(TokenType type);
-  const Token& expect(TokenType type, const std::string& value);
+  Symbol expect(TokenType type);
+  Symbol expect(TokenType type, Symbol symbol);
+  std::runtime_error unexpected(TokenType expected) const;
 
-  Token previous();
+  std::string_view previous() const;
+  Symbol previousSymbol() const;
+  bool isLambdaAhead() const;
 
-  std::unique_ptr<ExpressionNode> parseExpression();
-  std::unique_ptr<ExpressionNode> parseTerm();
-  std::unique_ptr<ExpressionNode> parseAdditionSubtraction();
-  std::unique_ptr<ExpressionNode> parseMultiplicationDivision();
-  std::unique_ptr<ExpressionNode> parsePrimary();
-  std::unique_ptr<ExpressionNode> parseFunctionCall();
-  std::unique_ptr<ExpressionNode> parseUnary();
+  ExpressionNode* parseExpression();
+  ExpressionNode* parseTerm();
+  ExpressionNode* parseAdditionSubtraction();
+  ExpressionNode* parseMultiplicationDivision();
+  ExpressionNode* parsePrimary();
+  ExpressionNode* parseIndex();
+  ExpressionNode* parseFunctionCall();
+  ExpressionNode* parseUnary();
 
  private:
-  std::unique_ptr<ASTNode> parseFunctionOrExpression();
-  std::unique_ptr<VariableDeclarationNode> parseVariableDeclaration();
-  std::unique_ptr<AssignmentNode> parseAssignment();
-  std::unique_ptr<ExpressionNode> parsePipeExpression();
-  std::unique_ptr<LambdaNode> parseLambdaExpression();
+  ASTNode* parseExpressionStatement();
+  VariableDeclarationNode* parseVariableDeclaration();
+  AssignmentNode* parseAssignment();
+  ExpressionNode* parsePipeExpression();
+  LambdaNode* parseLambdaExpression();
 };
@@ -0,0 +1,243 @@
+#include "Resolver.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+void Resolver::resolve(ProgramNode& program,
+                       const BuiltInMap& builtInFunctions,
+                       const std::vector<Symbol>& inputs) {
+  if (program.resolved) return;
+  Resolver resolver(program, builtInFunctions);
+  resolver.wholeProgram = true;
+
+  // inputs get the first slots, then globals, in declaration order
+  for (Symbol input : inputs) {
+    if (resolver.declared.count(input))
+      throw std::runtime_error("Duplicate input '" + symbolName(input) + "'");
+    resolver.declarations[input] = {true, -1, nullptr};
+    resolver.slot(input);
+    resolver.declared.insert(input);
+  }
+  resolver.hasInputs = !inputs.empty();
+  for (const ASTNode* stmt : program.statements)
+    if (auto decl = stmt->as<VariableDeclarationNode>())
+      resolver.declare(*decl);
+
+  for (ASTNode* stmt : program.statements)
+    resolver.resolveStatement(*stmt);
+
+  // once every lambda a memo lambda might call has been resolved
+  for (ASTNode* stmt : program.statements)
+    if (auto decl = stmt->as<VariableDeclarationNode>())
+      if (decl->memo) resolver.memoize(*decl);
+  program.resolved = true;
+}
+
+void Resolver::declare(const VariableDeclarationNode& decl) {
+  const LambdaNode* lambda = decl.lambdaExpr.value_or(nullptr);
+  declarations[decl.name] = {
+      decl.mut, lambda ? static_cast<int>(lambda->arguments.size()) : -1,
+      lambda};
+  slot(decl.name);
+}
+
+void Resolver::resolveStatement(ASTNode& node) {
+  if (auto decl = node.as<VariableDeclarationNode>()) {
+    if (declared.count(decl->name))
+      throw std::runtime_error("Variable with identifier already exists!");
+    if (!wholeProgram) declare(*decl);
+    if (decl->lambdaExpr.has_value())
+      resolveLambda(**decl->lambdaExpr);
+    else if (decl->expression.has_value())
+      resolveExpression(**decl->expression, nullptr);
+    decl->slot = slot(decl->name);
+    declared.insert(decl->name);
+    if (decl->memo && !wholeProgram) memoize(*decl);
+  } else if (auto assign = node.as<AssignmentNode>()) {
+    if (!declared.count(assign->name))
+      throw std::runtime_error("Variable '" + symbolName(assign->name) +
+                               "' is not declared!");
+    if (!declarations.at(assign->name).mut)
+      throw std::runtime_error("Variable '" + symbolName(assign->name) +
+                               "' is immutable!");
+    resolveExpression(*assign->expression, nullptr);
+    assign->slot = slot(assign->name);
+  } else if (auto expr = node.as<ExpressionNode>()) {
+    resolveExpression(*expr, nullptr);
+  }
+}
+
+void Resolver::resolveExpression(ExpressionNode& node,
+                                 const LambdaNode* scope) {
+  if (auto variable = node.as<VariableNode>()) {
+    variable->local = argumentIndex(variable->name, scope);
+    if (variable->local >= 0) return;
+    if (!isVisible(variable->name, scope))
+      throw std::runtime_error("Undefined variable: " +
+                               symbolName(variable->name));
+    variable->slot = slot(variable->name);
+  } else if (auto binary = node.as<BinaryOperationNode>()) {
+    resolveExpression(*binary->left, scope);
+    resolveExpression(*binary->right, scope);
+  } else if (auto unary = node.as<UnaryOperationNode>()) {
+    resolveExpression(*unary->operand, scope);
+  } else if (auto call = node.as<FunctionCallNode>()) {
+    for (ExpressionNode* arg : call->arguments)
+      resolveExpression(*arg, scope);
+
+    // built-ins shadow user definitions of the same name
+    if (builtInFunctions.find(call->functionName) != builtInFunctions.end()) {
+      call->builtIn = builtIn(call->functionName);
+      return;
+    }
+    // a lambda passed in as an argument, only known once it's called
+    call->local = argumentIndex(call->functionName, scope);
+    if (call->local >= 0) return;
+    if (!isVisible(call->functionName, scope))
+      throw std::runtime_error("Unknown function: " +
+                               symbolName(call->functionName));
+    call->slot = slot(call->functionName);
+
+    // an immutable lambda binding can be checked right here
+    auto decl = declarations.find(call->functionName);
+    if (decl != declarations.end() && !decl->second.mut &&
+        decl->second.arity >= 0 &&
+        static_cast<size_t>(decl->second.arity) != call->argumentCount())
+      throw std::runtime_error("Input count mismatch");
+  } else if (auto pipeline = node.as<PipelineNode>()) {
+    resolveExpression(*pipeline->source, scope);
+    for (FunctionCallNode* stage : pipeline->stages)
+      resolveExpression(*stage, scope);
+  } else if (auto array = node.as<ArrayNode>()) {
+    for (ExpressionNode* element : array->elements)
+      resolveExpression(*element, scope);
+  } else if (auto index = node.as<IndexNode>()) {
+    resolveExpression(*index->array, scope);
+    resolveExpression(*index->index, scope);
+  } else if (auto lambda = node.as<LambdaNode>()) {
+    resolveLambda(*lambda);
+  }
+}
+
+void Resolver::resolveLambda(LambdaNode& lambda) {
+  for (size_t i = 0; i < lambda.arguments.size(); i++)
+    for (size_t j = 0; j < i; j++)
+      if (lambda.arguments[i] == lambda.arguments[j])
+        throw std::runtime_error("Duplicate argument '" +
+                                 symbolName(lambda.arguments[i]) + "' in " +
+                                 symbolName(lambda.functionName));
+  resolveExpression(*lambda.body, &lambda);
+}
+
+// while streaming, lambdas that aren't declared yet can't be looked at, so
+// calling one makes a memo lambda impure
+void Resolver::memoize(VariableDeclarationNode& decl) {
+  LambdaNode& lambda = **decl.lambdaExpr;
+  program.memoized.push_back(lambda.self.lock());
+  // globals computed from the inputs differ from run to run, a cache would
+  // hand one run's results to the next
+  if (MemoCache::isEnabled() && !hasInputs && isPure(lambda))
+    lambda.cache = std::make_unique<MemoCache>();
+}
+
+// a lambda is pure unless it, or a lambda it can call, has a side effect or
+// reads something that can change. recursion is fine, every lambda is only
+// looked at once
+bool Resolver::isPure(const LambdaNode& lambda) const {
+  std::unordered_set<const LambdaNode*> seen{&lambda};
+  std::vector<const LambdaNode*> pending{&lambda};
+  while (!pending.empty()) {
+    const LambdaNode* next = pending.back();
+    pending.pop_back();
+    std::vector<const LambdaNode*> callees;
+    if (!isLocallyPure(*next->body, callees)) return false;
+    for (const LambdaNode* callee : callees)
+      if (seen.insert(callee).second) pending.push_back(callee);
+  }
+  return true;
+}
+
+// node on its own, the immutable lambdas it calls are added to callees.
+// calls of impure built-ins, of lambdas passed in as arguments and of
+// mutable bindings, and reads of mutable globals, make it impure
+bool Resolver::isLocallyPure(const ExpressionNode& node,
+                             std::vector<const LambdaNode*>& callees) const {
+  auto immutable = [&](int slot) -> const Declaration* {
+    auto decl = declarations.find(program.globals[slot]);
+    return decl != declarations.end() && !decl->second.mut ? &decl->second
+                                                           : nullptr;
+  };
+
+  if (node.as<NumberNode>()) return true;
+  if (auto variable = node.as<VariableNode>())
+    return variable->local >= 0 || immutable(variable->slot);
+  if (auto binary = node.as<BinaryOperationNode>())
+    return isLocallyPure(*binary->left, callees) &&
+           isLocallyPure(*binary->right, callees);
+  if (auto unary = node.as<UnaryOperationNode>())
+    return isLocallyPure(*unary->operand, callees);
+  // typed arithmetic, a lambda resolved earlier in the stream may have some
+  if (auto typed = node.as<IntArithmeticNode>())
+    return isLocallyPure(*typed->left, callees) &&
+           isLocallyPure(*typed->right, callees);
+  if (auto typed = node.as<DoubleArithmeticNode>())
+    return isLocallyPure(*typed->left, callees) &&
+           isLocallyPure(*typed->right, callees);
+  if (auto conversion = node.as<IntToDoubleNode>())
+    return isLocallyPure(*conversion->operand, callees);
+  if (auto call = node.as<FunctionCallNode>()) {
+    for (const ExpressionNode* arg : call->arguments)
+      if (!isLocallyPure(*arg, callees)) return false;
+    if (call->builtIn >= 0)
+      return builtInFunctions.at(call->functionName).pure;
+    if (call->local >= 0) return false;
+    const Declaration* callee = immutable(call->slot);
+    if (!callee || !callee->lambda) return false;
+    callees.push_back(callee->lambda);
+    return true;
+  }
+  if (auto pipeline = node.as<PipelineNode>()) {
+    if (!isLocallyPure(*pipeline->source, callees)) return false;
+    for (const FunctionCallNode* stage : pipeline->stages)
+      if (!isLocallyPure(*stage, callees)) return false;
+    return true;
+  }
+  if (auto array = node.as<ArrayNode>()) {
+    for (const ExpressionNode* element : array->elements)
+      if (!isLocallyPure(*element, callees)) return false;
+    return true;
+  }
+  if (auto index = node.as<IndexNode>())
+    return isLocallyPure(*index->array, callees) &&
+           isLocallyPure(*index->index, callees);
+  return false;
+}
+
+int Resolver::slot(Symbol name) {
+  auto it = slots.find(name);
+  if (it != slots.end()) return it->second;
+  program.globals.push_back(name);
+  return slots[name] = static_cast<int>(program.globals.size() - 1);
+}
+
+int Resolver::builtIn(Symbol name) {
+  auto it = builtInSlots.find(name);
+  if (it != builtInSlots.end()) return it->second;
+  program.builtIns.push_back(name);
+  return builtInSlots[name] = static_cast<int>(program.builtIns.size() - 1);
+}
+
+// top-level code sees what was declared above it, lambda bodies see every
+// global, since they only run once they're called
+bool Resolver::isVisible(Symbol name, const LambdaNode* scope) const {
+  if (!scope) return declared.count(name) > 0;
+  return !wholeProgram || declarations.count(name) > 0;
+}
+
+// arguments shadow globals of the same name
+int Resolver::argumentIndex(Symbol name, const LambdaNode* scope) {
+  if (!scope) return -1;
+  auto it = std::find(scope->arguments.begin(), scope->arguments.end(), name);
+  if (it == scope->arguments.end()) return -1;
+  return static_cast<int>(it - scope->arguments.begin());
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "AST.h"
+
+/*
+binds every identifier and call site of a parsed program to a lambda argument,
+a global slot or a built-in index, so the interpreter never looks a name up
+at runtime.
+unknown names, redeclarations and writes to immutable bindings are reported
+here instead of halfway through execution.
+memo lambdas get a result cache here, if they turn out to be pure.
+*/
+class Resolver {
+ public:
+  // inputs are globals the host defines before every run, see Server. they
+  // take the first slots, in order, and are mut: a resolved program runs
+  // again with other values
+  static void resolve(ProgramNode& program, const BuiltInMap& builtInFunctions,
+                      const std::vector<Symbol>& inputs = {});
+
+  // for resolving a program one statement at a time as it's read. lambdas
+  // may then refer to globals that haven't been declared yet, which is only
+  // checked once they run
+  Resolver(ProgramNode& program, const BuiltInMap& builtInFunctions)
+      : program(program), builtInFunctions(builtInFunctions) {}
+
+  void resolveStatement(ASTNode& node);
+
+ private:
+  struct Declaration {
+    bool mut;
+    int arity;                 // -1 unless it's bound to a lambda
+    const LambdaNode* lambda;  // likewise nullptr
+  };
+
+  void declare(const VariableDeclarationNode& decl);
+  void resolveExpression(ExpressionNode& node, const LambdaNode* scope);
+  void resolveLambda(LambdaNode& lambda);
+  void memoize(VariableDeclarationNode& decl);
+  bool isPure(const LambdaNode& lambda) const;
+  bool isLocallyPure(const ExpressionNode& node,
+                     std::vector<const LambdaNode*>& callees) const;
+
+  int slot(Symbol name);
+  int builtIn(Symbol name);
+  bool isVisible(Symbol name, const LambdaNode* scope) const;
+  static int argumentIndex(Symbol name, const LambdaNode* scope);
+
+ private:
+  ProgramNode& program;
+  const BuiltInMap& builtInFunctions;
+  bool wholeProgram = false;
+  bool hasInputs = false;
+  std::unordered_map<Symbol, int> slots;
+  std::unordered_map<Symbol, int> builtInSlots;
+  // every top-level declaration, lambdas may refer to ones declared later
+  std::unordered_map<Symbol, Declaration> declarations;
+  std::unordered_set<Symbol> declared;  // declared so far, in order
+};
@@ -0,0 +1,159 @@
+#include "StatementGraph.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+// the globals an expression reads itself, without looking into the lambdas
+// it calls, and whether it calls a built-in with effects of its own
+struct Uses {
+  std::vector<int> slots;
+  bool effects = false;
+};
+
+// the most common kinds of node are tried first
+void collect(const ExpressionNode& node, const BuiltInMap& builtIns,
+             Uses& uses) {
+  if (node.as<NumberNode>()) return;
+  if (auto variable = node.as<VariableNode>()) {
+    if (variable->local < 0) uses.slots.push_back(variable->slot);
+  } else if (auto typed = node.as<IntArithmeticNode>()) {
+    collect(*typed->left, builtIns, uses);
+    collect(*typed->right, builtIns, uses);
+  } else if (auto binary = node.as<BinaryOperationNode>()) {
+    collect(*binary->left, builtIns, uses);
+    collect(*binary->right, builtIns, uses);
+  } else if (auto typed = node.as<DoubleArithmeticNode>()) {
+    collect(*typed->left, builtIns, uses);
+    collect(*typed->right, builtIns, uses);
+  } else if (auto unary = node.as<UnaryOperationNode>()) {
+    collect(*unary->operand, builtIns, uses);
+  } else if (auto conversion = node.as<IntToDoubleNode>()) {
+    collect(*conversion->operand, builtIns, uses);
+  } else if (auto call = node.as<FunctionCallNode>()) {
+    for (const ExpressionNode* arg : call->arguments)
+      collect(*arg, builtIns, uses);
+    if (call->builtIn >= 0) {
+      const BuiltIn& builtIn = builtIns.at(call->functionName);
+      if (!builtIn.pure && !builtIn.throughLambdas) uses.effects = true;
+    } else if (call->local < 0) {
+      uses.slots.push_back(call->slot);
+    }
+  } else if (auto pipeline = node.as<PipelineNode>()) {
+    collect(*pipeline->source, builtIns, uses);
+    for (const FunctionCallNode* stage : pipeline->stages)
+      collect(*stage, builtIns, uses);
+  } else if (auto array = node.as<ArrayNode>()) {
+    for (const ExpressionNode* element : array->elements)
+      collect(*element, builtIns, uses);
+  } else if (auto index = node.as<IndexNode>()) {
+    collect(*index->array, builtIns, uses);
+    collect(*index->index, builtIns, uses);
+  } else if (auto binding = node.as<LocalBindingNode>()) {
+    collect(*binding->value, builtIns, uses);
+    collect(*binding->body, builtIns, uses);
+  } else if (auto lambda = node.as<LambdaNode>()) {
+    collect(*lambda->body, builtIns, uses);
+  }
+}
+
+// numbers and arrays of them, never a lambda or a stream
+bool isInert(const ExpressionNode& node) {
+  return node.as<NumberNode>() || node.as<BinaryOperationNode>() ||
+         node.as<UnaryOperationNode>() || node.as<IntArithmeticNode>() ||
+         node.as<DoubleArithmeticNode>() || node.as<IntToDoubleNode>() ||
+         node.as<ArrayNode>() || node.as<IndexNode>();
+}
+
+}  // namespace
+
+StatementGraph::StatementGraph(const ProgramNode& program,
+                               const BuiltInMap& builtIns) {
+  const size_t count = program.statements.size();
+  const size_t slots = program.globals.size();
+
+  // what using a global may read later: a lambda's body, or what the
+  // initializer read that may have handed it a lambda or a stream
+  std::vector<Uses> later(slots);
+  std::vector<Uses> direct(count);
+  std::vector<uint8_t> mut(slots, 0);
+  std::vector<std::vector<uint32_t>> writers(slots);
+  written.assign(count, -1);
+  for (size_t i = 0; i < count; i++) {
+    const ASTNode* stmt = program.statements[i];
+    const ExpressionNode* value = nullptr;
+    if (auto decl = stmt->as<VariableDeclarationNode>()) {
+      written[i] = decl->slot;
+      mut[decl->slot] = decl->mut;
+      if (decl->lambdaExpr.has_value())
+        collect(*(*decl->lambdaExpr)->body, builtIns, later[decl->slot]);
+      else if (decl->expression.has_value())
+        value = *decl->expression;
+    } else if (auto assign = stmt->as<AssignmentNode>()) {
+      written[i] = assign->slot;
+      value = assign->expression;
+    } else if (auto expr = stmt->as<ExpressionNode>()) {
+      collect(*expr, builtIns, direct[i]);
+    }
+    if (value) {
+      collect(*value, builtIns, direct[i]);
+      if (!isInert(*value)) {
+        std::vector<int>& into = later[written[i]].slots;
+        into.insert(into.end(), direct[i].slots.begin(),
+                    direct[i].slots.end());
+      }
+    }
+    if (written[i] >= 0) writers[written[i]].push_back(i);
+  }
+
+  readSlots.resize(count);
+  ordered.assign(count, 0);
+  levelOf.assign(count, 0);
+  std::vector<uint32_t> seen(slots, std::numeric_limits<uint32_t>::max());
+  std::vector<uint32_t> minimum(count, 0);  // from the reads of earlier ones
+  uint32_t top = 0;
+  for (size_t i = 0; i < count; i++) {
+    const uint32_t stamp = static_cast<uint32_t>(i);
+    std::vector<int>& reach = readSlots[i];
+    bool effects = direct[i].effects;
+    std::vector<int> pending = direct[i].slots;
+    while (!pending.empty()) {
+      const int slot = pending.back();
+      pending.pop_back();
+      if (seen[slot] == stamp) continue;
+      seen[slot] = stamp;
+      reach.push_back(slot);
+      effects = effects || later[slot].effects;
+      for (int next : later[slot].slots)
+        if (seen[next] != stamp) pending.push_back(next);
+    }
+    std::sort(reach.begin(), reach.end());
+
+    bool isOrdered = effects || (written[i] >= 0 && mut[written[i]]);
+    uint32_t level = minimum[i];
+    for (int slot : reach) {
+      // immutable globals have the one writer, reading one before it ran
+      // prints and throws
+      if (mut[slot] || writers[slot].empty() || writers[slot].front() >= i)
+        isOrdered = true;
+      else
+        level = std::max(level, levelOf[writers[slot].front()] + 1);
+    }
+    if (isOrdered && i > 0) level = std::max(level, top + 1);
+    // a later declaration of something this reads waits for it. later
+    // writes of a mut global are ordered already
+    for (int slot : reach)
+      if (!mut[slot] && !writers[slot].empty() && writers[slot].front() > i)
+        minimum[writers[slot].front()] =
+            std::max(minimum[writers[slot].front()], level + 1);
+
+    ordered[i] = isOrdered;
+    levelOf[i] = level;
+    top = std::max(top, level);
+  }
+
+  groups.resize(count ? top + 1 : 0);
+  for (size_t i = 0; i < count; i++)
+    groups[levelOf[i]].push_back(static_cast<uint32_t>(i));
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "AST.h"
+
+/*
+the order a resolved program's top-level statements really have to run in,
+so independent ones can run at the same time. a statement waits for the
+statement that declares a global it reads, and what it reads includes what
+the lambdas it may end up calling read, following every global that may
+hold a lambda or a stream of them.
+statements that print, touch a mut binding, read a global before it's
+declared or may call anything that does are ordered: they wait for every
+statement before them, so output, and the first error, are those of running
+the program in order.
+statements are grouped into levels, each only waits for ones in lower
+levels, so the statements of a level can run together.
+*/
+class StatementGraph {
+ public:
+  StatementGraph(const ProgramNode& program, const BuiltInMap& builtIns);
+
+  size_t size() const { return levelOf.size(); }
+  // the globals statement i may read, sorted, and the one it writes or -1
+  const std::vector<int>& reads(size_t i) const { return readSlots[i]; }
+  int writes(size_t i) const { return written[i]; }
+  bool isOrdered(size_t i) const { return ordered[i]; }
+  uint32_t level(size_t i) const { return levelOf[i]; }
+  // the statements of each level, in program order
+  const std::vector<std::vector<uint32_t>>& levels() const { return groups; }
+
+ private:
+  std::vector<std::vector<int>> readSlots;
+  std::vector<int> written;
+  std::vector<uint8_t> ordered;
+  std::vector<uint32_t> levelOf;
+  std::vector<std::vector<uint32_t>> groups;
+};
@@ -0,0 +1,144 @@
+#include "Batch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+
+#include "ThreadPool.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t SLOWEST = 10;  // scripts the summary lists by time
+
+Batch::Result runScript(const std::string& path, const RunOptions& options,
+                        std::ostream& printed) {
+  Batch::Result result;
+  result.path = path;
+  const Clock::time_point start = Clock::now();
+  Output output(printed);
+  RunOptions run = options;
+  run.output = &output;
+  try {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) throw std::runtime_error("Can't open " + path);
+    const std::string code(std::istreambuf_iterator<char>(file), {});
+    TokenStream tokens = Interpreter::lex(code);
+    std::unique_ptr<ProgramNode> program = Interpreter::parse(tokens);
+    Interpreter::walkAST(program, run);
+  } catch (const std::exception& e) {
+    result.ok = false;
+    result.error = e.what();
+  }
+  result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  return result;
+}
+
+}  // namespace
+
+namespace Batch {
+
+std::vector<std::string> discover(const std::vector<std::string>& paths) {
+  namespace fs = std::filesystem;
+  std::vector<std::string> files;
+  for (const std::string& path : paths) {
+    std::error_code error;
+    if (!fs::is_directory(path, error)) {
+      files.push_back(path);
+      continue;
+    }
+    std::vector<std::string> found;
+    for (const fs::directory_entry& entry :
+         fs::recursive_directory_iterator(path))
+      if (entry.is_regular_file() && entry.path().extension() == ".palm")
+        found.push_back(entry.path().string());
+    std::sort(found.begin(), found.end());
+    files.insert(files.end(), found.begin(), found.end());
+  }
+  return files;
+}
+
+std::vector<Result> run(const std::vector<std::string>& files,
+                        const RunOptions& options, std::ostream& out) {
+  std::vector<Result> results(files.size());
+  std::vector<std::string> printed(files.size());
+  std::vector<uint8_t> done(files.size(), 0);
+  size_t next = 0;  // the first script not written out yet
+  std::mutex mutex;
+  ThreadPool::shared().parallelFor(
+      files.size(), 1, [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; i++) {
+          std::ostringstream buffer;
+          results[i] = runScript(files[i], options, buffer);
+          std::lock_guard<std::mutex> lock(mutex);
+          printed[i] = buffer.str();
+          done[i] = 1;
+          for (; next < files.size() && done[next]; next++) {
+            out << "==> " << files[next] << " <==\n" << printed[next];
+            std::string().swap(printed[next]);
+          }
+        }
+      });
+  out.flush();
+  return results;
+}
+
+void summary(const std::vector<Result>& results, double seconds,
+             std::ostream& out) {
+  std::vector<const Result*> byTime;
+  size_t failed = 0;
+  for (const Result& result : results) {
+    byTime.push_back(&result);
+    failed += !result.ok;
+  }
+  std::sort(byTime.begin(), byTime.end(),
+            [](const Result* a, const Result* b) {
+              return a->seconds > b->seconds;
+            });
+
+  char line[160];
+  std::snprintf(line, sizeof line, "batch: %zu scripts, %zu failed, %.3f s\n",
+                results.size(), failed, seconds);
+  out << line;
+  if (!byTime.empty()) {
+    auto percentile = [&](double p) {
+      const double rank = (100 - p) / 100 * (byTime.size() - 1);
+      return byTime[static_cast<size_t>(rank + 0.5)]->seconds * 1e3;
+    };
+    std::snprintf(line, sizeof line,
+                  "per script: p50 %.3f ms, p90 %.3f ms, max %.3f ms\n",
+                  percentile(50), percentile(90), percentile(100));
+    out << line;
+  }
+
+  if (failed) {
+    out << "failed:\n";
+    for (const Result& result : results)
+      if (!result.ok)
+        out << "  " << result.path << ": " << result.error << '\n';
+  }
+  if (!byTime.empty()) out << "slowest:\n";
+  for (size_t i = 0; i < std::min(SLOWEST, byTime.size()); i++) {
+    std::snprintf(line, sizeof line, "  %10.3f ms  ",
+                  byTime[i]->seconds * 1e3);
+    out << line << byTime[i]->path << '\n';
+  }
+}
+
+void writeTimings(const std::vector<Result>& results, std::ostream& out) {
+  char milliseconds[32];
+  for (const Result& result : results) {
+    std::snprintf(milliseconds, sizeof milliseconds, "%.3f",
+                  result.seconds * 1e3);
+    out << result.path << '\t' << (result.ok ? "ok" : "error") << '\t'
+        << milliseconds << '\n';
+  }
+}
+
+}  // namespace Batch
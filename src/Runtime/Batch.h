@@ -0,0 +1,40 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "../Parser/Interpreter.h"
+
+/*
+palmtree run: many scripts at once, each one a chunk of a job on the shared
+ThreadPool, so --jobs sizes the pool. every script is lexed, parsed and run
+on its own tree and environment, the built-ins are all they share. what a
+script prints is held until it's done and every script before it has been
+written out, so the output is that of running them one after another.
+*/
+namespace Batch {
+
+struct Result {
+  std::string path;
+  bool ok = true;
+  std::string error;
+  double seconds = 0;  // reading, lexing, parsing and running it
+};
+
+// the .palm files under each directory, in path order, and every other
+// path as it is
+std::vector<std::string> discover(const std::vector<std::string>& paths);
+
+// runs every file, each one's output goes to out after a "==> path <=="
+// line
+std::vector<Result> run(const std::vector<std::string>& files,
+                        const RunOptions& options, std::ostream& out);
+
+// the totals, every failure and the slowest scripts
+void summary(const std::vector<Result>& results, double seconds,
+             std::ostream& out);
+// a line per script: path, ok or error and milliseconds, tab separated
+void writeTimings(const std::vector<Result>& results, std::ostream& out);
+
+}  // namespace Batch
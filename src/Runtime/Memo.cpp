@@ -0,0 +1,63 @@
+#include "Memo.h"
+
+bool MemoCache::memoize = true;
+
+bool MemoCache::find(const Value* arguments, size_t count, Value& result) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = index.find({arguments, count});
+  if (it == index.end()) {
+    missCount++;
+    return false;
+  }
+  entries.splice(entries.begin(), entries, it->second);
+  result = it->second->result;
+  hitCount++;
+  return true;
+}
+
+void MemoCache::insert(const Value* arguments, size_t count,
+                       const Value& result) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (index.count({arguments, count})) return;
+  entries.push_front(
+      {std::vector<Value>(arguments, arguments + count), result});
+  const std::vector<Value>& key = entries.front().arguments;
+  index.emplace(Key{key.data(), key.size()}, entries.begin());
+
+  if (entries.size() > CAPACITY) {
+    const std::vector<Value>& oldest = entries.back().arguments;
+    index.erase({oldest.data(), oldest.size()});
+    entries.pop_back();
+  }
+}
+
+size_t MemoCache::hits() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return hitCount;
+}
+
+size_t MemoCache::misses() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return missCount;
+}
+
+size_t MemoCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return entries.size();
+}
+
+size_t MemoCache::KeyHash::operator()(const Key& key) const {
+  uint64_t hash = 14695981039346656037ull;  // FNV-1a over the identities
+  for (size_t i = 0; i < key.count; i++) {
+    hash ^= key.values[i].identity();
+    hash *= 1099511628211ull;
+  }
+  return static_cast<size_t>(hash ^ (hash >> 32));
+}
+
+bool MemoCache::KeyEqual::operator()(const Key& a, const Key& b) const {
+  if (a.count != b.count) return false;
+  for (size_t i = 0; i < a.count; i++)
+    if (a.values[i].identity() != b.values[i].identity()) return false;
+  return true;
+}
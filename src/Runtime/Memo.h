@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "../Types/Value.h"
+
+/*
+the results of one memoized lambda, keyed by its arguments. only the
+least recently used CAPACITY entries are kept.
+arguments are compared by identity: the same number, or the same array,
+string or lambda object. the keys keep their objects alive, so an address
+can't be reused by a different one while it's cached.
+lambdas run on several threads at once through map, filter and reduce, so
+every call takes the cache's lock.
+*/
+class MemoCache {
+ public:
+  static constexpr size_t CAPACITY = 1024;  // entries per lambda
+
+  // turns memoization off for every lambda resolved afterwards
+  static void setEnabled(bool enabled) { memoize = enabled; }
+  static bool isEnabled() { return memoize; }
+
+  // the result for these arguments, if it's been cached
+  bool find(const Value* arguments, size_t count, Value& result);
+  // caches the result, unless another call got there first
+  void insert(const Value* arguments, size_t count, const Value& result);
+
+  size_t hits() const;
+  size_t misses() const;
+  size_t size() const;
+
+ private:
+  struct Entry {
+    std::vector<Value> arguments;
+    Value result;
+  };
+  // points at the arguments of a lookup or of an entry
+  struct Key {
+    const Value* values;
+    size_t count;
+  };
+  struct KeyHash {
+    size_t operator()(const Key& key) const;
+  };
+  struct KeyEqual {
+    bool operator()(const Key& a, const Key& b) const;
+  };
+
+  mutable std::mutex mutex;
+  std::list<Entry> entries;  // the most recently used first
+  std::unordered_map<Key, std::list<Entry>::iterator, KeyHash, KeyEqual> index;
+  size_t hitCount = 0;
+  size_t missCount = 0;
+
+  static bool memoize;
+};
@@ -0,0 +1,113 @@
+#include "Memory.h"
+
+#include <sys/resource.h>
+
+#include <atomic>
+#include <cstdio>
+
+namespace {
+
+// allocations, bytes, frees and freed bytes, by phase and category
+std::atomic<uint64_t> counts[Memory::PHASES][Memory::CATEGORIES][4];
+
+double kilobytes(double bytes) { return bytes / 1024; }
+
+}  // namespace
+
+Memory::Counters& Memory::Counters::operator+=(const Counters& other) {
+  allocations += other.allocations;
+  bytes += other.bytes;
+  frees += other.frees;
+  freedBytes += other.freedBytes;
+  return *this;
+}
+
+Memory::Counters Memory::Stats::phase(Phase phase) const {
+  Counters total;
+  for (int category = 0; category < CATEGORIES; category++)
+    total += counters[phase][category];
+  return total;
+}
+
+Memory::Counters Memory::Stats::category(Category category) const {
+  Counters total;
+  for (int phase = 0; phase < PHASES; phase++)
+    total += counters[phase][category];
+  return total;
+}
+
+void Memory::enable() { enabled = true; }
+
+void Memory::reset() {
+  for (auto& phase : counts)
+    for (auto& category : phase)
+      for (std::atomic<uint64_t>& count : category)
+        count.store(0, std::memory_order_relaxed);
+}
+
+void Memory::record(Category category, size_t bytes, bool free) {
+  std::atomic<uint64_t>* count = counts[phase()][category] + (free ? 2 : 0);
+  count[0].fetch_add(1, std::memory_order_relaxed);
+  count[1].fetch_add(bytes, std::memory_order_relaxed);
+}
+
+Memory::Stats Memory::stats() {
+  Stats stats;
+  for (int phase = 0; phase < PHASES; phase++) {
+    for (int category = 0; category < CATEGORIES; category++) {
+      const std::atomic<uint64_t>* count = counts[phase][category];
+      Counters& counters = stats.counters[phase][category];
+      counters.allocations = count[0].load(std::memory_order_relaxed);
+      counters.bytes = count[1].load(std::memory_order_relaxed);
+      counters.frees = count[2].load(std::memory_order_relaxed);
+      counters.freedBytes = count[3].load(std::memory_order_relaxed);
+    }
+  }
+  rusage usage{};
+  if (getrusage(RUSAGE_SELF, &usage) == 0)
+    stats.peakRss = static_cast<size_t>(usage.ru_maxrss) * 1024;  // in KiB
+  return stats;
+}
+
+const char* Memory::name(Phase phase) {
+  static const char* const names[] = {"other", "lex", "parse", "eval"};
+  return phase < PHASES ? names[phase] : "?";
+}
+
+const char* Memory::name(Category category) {
+  static const char* const names[] = {"tokens", "ast", "values", "globals"};
+  return category < CATEGORIES ? names[category] : "?";
+}
+
+void Memory::report(std::ostream& out) {
+  const Stats stats = Memory::stats();
+  char line[160];
+  std::snprintf(line, sizeof line, "memory: peak RSS %.1f MB\n",
+                kilobytes(stats.peakRss) / 1024);
+  out << line
+      << "phase  category       allocs          KB        frees    freed KB\n";
+  auto row = [&](const char* phase, const char* category,
+                 const Counters& counters) {
+    std::snprintf(line, sizeof line, "%-6s %-8s %12llu %11.1f %12llu %11.1f\n",
+                  phase, category,
+                  static_cast<unsigned long long>(counters.allocations),
+                  kilobytes(counters.bytes),
+                  static_cast<unsigned long long>(counters.frees),
+                  kilobytes(counters.freedBytes));
+    out << line;
+  };
+  for (int phase = 0; phase < PHASES; phase++)
+    for (int category = 0; category < CATEGORIES; category++) {
+      const Counters& counters = stats.counters[phase][category];
+      if (counters.allocations || counters.frees)
+        row(name(Phase(phase)), name(Category(category)), counters);
+    }
+
+  // what each category still held when the report was made
+  out << "category     live KB\n";
+  for (int category = 0; category < CATEGORIES; category++) {
+    std::snprintf(line, sizeof line, "%-8s %11.1f\n", name(Category(category)),
+                  kilobytes(stats.category(Category(category)).liveBytes()));
+    out << line;
+  }
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+
+/*
+counts the allocations behind a run for --mem-stats, and for hosts that
+embed the interpreter: the token stream's columns, the arenas the AST lives
+in, the payloads of Values (strings, lambdas, arrays, streams) and the
+environment's globals. every count goes to the phase running when it was
+made, lexing, parsing or evaluating. the phase is the current thread's, so
+runs on different threads don't change each other's, and ThreadPool hands
+the one a job starts in to the threads that run its chunks. counting starts
+at enable(), when it's off an allocation only checks isEnabled().
+*/
+class Memory {
+ public:
+  enum Category : uint8_t { Tokens, Ast, Values, Globals, CATEGORIES };
+  enum Phase : uint8_t { Other, Lex, Parse, Eval, PHASES };
+
+  struct Counters {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    uint64_t frees = 0;
+    uint64_t freedBytes = 0;
+
+    // allocated and not freed yet, as far as the counters saw
+    int64_t liveBytes() const {
+      return static_cast<int64_t>(bytes) - static_cast<int64_t>(freedBytes);
+    }
+    Counters& operator+=(const Counters& other);
+  };
+
+  struct Stats {
+    Counters counters[PHASES][CATEGORIES];
+    size_t peakRss = 0;  // bytes, the whole process's
+
+    Counters phase(Phase phase) const;
+    Counters category(Category category) const;
+  };
+
+  static bool isEnabled() { return enabled; }
+  static void enable();
+  // zeroes the counters, the peak RSS is the operating system's
+  static void reset();
+
+  static void allocated(Category category, size_t bytes) {
+    if (enabled) record(category, bytes, false);
+  }
+  static void freed(Category category, size_t bytes) {
+    if (enabled) record(category, bytes, true);
+  }
+
+  static Phase phase() { return current; }
+  static Stats stats();
+  static const char* name(Phase phase);
+  static const char* name(Category category);
+  // a table of the counters by phase and category, to stderr after a run
+  static void report(std::ostream& out);
+
+  // makes phase the current thread's while in scope
+  class Scope {
+   public:
+    explicit Scope(Phase phase) : previous(current) { current = phase; }
+    ~Scope() { current = previous; }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    Phase previous;
+  };
+
+ private:
+  static void record(Category category, size_t bytes, bool free);
+
+  static inline bool enabled = false;
+  static inline thread_local Phase current = Other;
+};
+
+// a std::allocator that counts what it hands out under category
+template <typename T, Memory::Category category>
+struct CountedAllocator {
+  using value_type = T;
+  template <typename U>
+  struct rebind {
+    using other = CountedAllocator<U, category>;
+  };
+
+  CountedAllocator() = default;
+  template <typename U>
+  CountedAllocator(const CountedAllocator<U, category>&) {}
+
+  T* allocate(size_t count) {
+    Memory::allocated(category, count * sizeof(T));
+    return std::allocator<T>().allocate(count);
+  }
+  void deallocate(T* items, size_t count) {
+    Memory::freed(category, count * sizeof(T));
+    std::allocator<T>().deallocate(items, count);
+  }
+
+  template <typename U>
+  bool operator==(const CountedAllocator<U, category>&) const {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const CountedAllocator<U, category>&) const {
+    return false;
+  }
+};
@@ -0,0 +1,196 @@
+#include "Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../Parser/StatementGraph.h"
+#include "Stream.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+namespace {
+
+// the array and the lambda, copied off the caller's stack
+struct Input {
+  Value array;
+  Value function;
+};
+
+Input input(Arguments args, size_t count, const std::string& name) {
+  if (args.size() != count || !args[0].isArray() || !args[1].isLambda())
+    throw std::runtime_error(name + " expects an array and a lambda" +
+                             (count > 2 ? " and an initial value" : ""));
+  if (!args.env)
+    throw std::runtime_error(name + " can't be called without an environment");
+  return {args[0], args[1]};
+}
+
+Value element(const ArrayObject& array, size_t i) {
+  return Value::number(array.values[i], array.integral);
+}
+
+}  // namespace
+
+Parallel::Workers::Workers(const Environment& parent)
+    : parent(parent), envs(ThreadPool::shared().workerCount()) {}
+
+Environment& Parallel::Workers::operator[](size_t worker) {
+  if (!envs[worker])
+    envs[worker] = std::make_unique<Environment>(parent.worker());
+  return *envs[worker];
+}
+
+bool Parallel::isTrue(const Value& value) {
+  return value.isBool() ? value.asBool() : value != 0;
+}
+
+size_t Parallel::chunkSize(size_t count) {
+  return std::max(MIN_CHUNK, (count + MAX_CHUNKS - 1) / MAX_CHUNKS);
+}
+
+Value Parallel::map(Arguments args) {
+  if (args.size() == 2 && args[0].isStream())
+    return Streams::map(args[0], args[1]);
+  const Input in = input(args, 2, "map");
+  const ArrayObject& array = in.array.asArray();
+
+  // every chunk writes its own part of results
+  std::vector<Value> results(array.size);
+  Workers workers(*args.env);
+  ThreadPool::shared().parallelFor(
+      array.size, chunkSize(array.size),
+      [&](size_t begin, size_t end, size_t worker) {
+        Environment& env = workers[worker];
+        for (size_t i = begin; i < end; i++) {
+          const Value x = element(array, i);
+          results[i] = env.call(in.function, &x, 1);
+        }
+      });
+  return Value::array(results.data(), results.size());
+}
+
+Value Parallel::filter(Arguments args) {
+  if (args.size() == 2 && args[0].isStream())
+    return Streams::filter(args[0], args[1]);
+  const Input in = input(args, 2, "filter");
+  const ArrayObject& array = in.array.asArray();
+
+  const size_t size = chunkSize(array.size);
+  std::vector<std::vector<double>> kept((array.size + size - 1) / size);
+  Workers workers(*args.env);
+  ThreadPool::shared().parallelFor(
+      array.size, size, [&](size_t begin, size_t end, size_t worker) {
+        Environment& env = workers[worker];
+        std::vector<double>& chunk = kept[begin / size];
+        for (size_t i = begin; i < end; i++) {
+          const Value x = element(array, i);
+          const Value keep = env.call(in.function, &x, 1);
+          if (isTrue(keep)) chunk.push_back(array.values[i]);
+        }
+      });
+
+  size_t total = 0;
+  for (const std::vector<double>& chunk : kept) total += chunk.size();
+  auto result = new ArrayObject(total, array.integral);
+  double* out = result->values.get();
+  for (const std::vector<double>& chunk : kept)
+    out = std::copy(chunk.begin(), chunk.end(), out);
+  return Value(result);
+}
+
+Value Parallel::reduce(Arguments args) {
+  if (args.size() == 3 && args[0].isStream() && args.env)
+    return Streams::reduce(args[0], args[1], args[2], *args.env);
+  const Input in = input(args, 3, "reduce");
+  const Value initial = args[2];
+  const ArrayObject& array = in.array.asArray();
+  if (array.size == 0) return initial;
+
+  // the first chunk starts from the initial value, the others from their
+  // first element
+  const size_t size = chunkSize(array.size);
+  std::vector<Value> partial((array.size + size - 1) / size);
+  Workers workers(*args.env);
+  ThreadPool::shared().parallelFor(
+      array.size, size, [&](size_t begin, size_t end, size_t worker) {
+        Environment& env = workers[worker];
+        Value total = begin == 0 ? initial : element(array, begin);
+        for (size_t i = begin == 0 ? 0 : begin + 1; i < end; i++) {
+          const Value pair[2] = {std::move(total), element(array, i)};
+          total = env.call(in.function, pair, 2);
+        }
+        partial[begin / size] = std::move(total);
+      });
+
+  Value total = std::move(partial[0]);
+  for (size_t i = 1; i < partial.size(); i++) {
+    const Value pair[2] = {std::move(total), std::move(partial[i])};
+    total = args.env->call(in.function, pair, 2);
+  }
+  return total;
+}
+
+void Parallel::runStatements(const StatementGraph& graph, Environment& env,
+                             const Statement& run) {
+  ThreadPool& pool = ThreadPool::shared();
+  std::atomic<size_t> failed{graph.size()};
+  std::mutex errorMutex;
+  std::exception_ptr error;
+  auto attempt = [&](size_t i, Environment& in, size_t worker) {
+    if (i > failed.load(std::memory_order_relaxed)) return;
+    try {
+      Trace::Scope trace(Trace::Kind::Statement, static_cast<uint32_t>(i));
+      run(i, in, worker);
+    } catch (...) {
+      std::lock_guard<std::mutex> guard(errorMutex);
+      if (i < failed.load(std::memory_order_relaxed)) {
+        failed.store(i, std::memory_order_relaxed);
+        error = std::current_exception();
+      }
+    }
+  };
+
+  std::vector<std::unique_ptr<Environment>> envs(pool.workerCount());
+  for (const std::vector<uint32_t>& level : graph.levels()) {
+    // nothing else runs, it can have env to itself. the calling thread is
+    // the pool's last slot
+    if (level.size() == 1) {
+      attempt(level[0], env, pool.workerCount() - 1);
+      continue;
+    }
+    const size_t chunk = (level.size() + MAX_CHUNKS - 1) / MAX_CHUNKS;
+    pool.parallelFor(
+        level.size(), chunk, [&](size_t begin, size_t end, size_t worker) {
+          if (!envs[worker]) {
+            envs[worker] = std::make_unique<Environment>(env.globals.size(),
+                                                         env.builtIns);
+            envs[worker]->output = env.output;
+          }
+          Environment& local = *envs[worker];
+          // no statement of the level writes what another one reads
+          for (size_t k = begin; k < end; k++) {
+            const size_t i = level[k];
+            for (int slot : graph.reads(i)) {
+              local.globals[slot] = env.globals[slot];
+              local.defined[slot] = env.defined[slot];
+            }
+            attempt(i, local, worker);
+            if (const int slot = graph.writes(i); slot >= 0) {
+              env.globals[slot] = std::move(local.globals[slot]);
+              env.defined[slot] = local.defined[slot];
+              local.defined[slot] = 0;
+            }
+            for (int slot : graph.reads(i)) {
+              local.globals[slot] = Value();
+              local.defined[slot] = 0;
+            }
+          }
+        });
+  }
+  if (error) std::rethrow_exception(error);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "../Parser/Environment.h"
+
+class StatementGraph;
+
+/*
+map, filter and reduce over arrays, run on the shared ThreadPool. each
+worker walks the lambda in an environment of its own (see
+Environment::worker), lambdas can't assign, so the globals they read don't
+change underneath them.
+arrays are split the same way whatever the number of threads, so a reduce
+with an associative lambda gives the same result every run.
+*/
+namespace Parallel {
+
+// elements per chunk below which a job isn't split any further
+constexpr size_t MIN_CHUNK = 512;
+// an upper bound on the chunks of one job, larger arrays get larger chunks
+constexpr size_t MAX_CHUNKS = 64;
+
+size_t chunkSize(size_t count);
+
+// one environment per pool slot, made by the slot's thread when it first
+// runs a chunk of the job
+class Workers {
+ public:
+  explicit Workers(const Environment& parent);
+  Environment& operator[](size_t worker);
+
+ private:
+  const Environment& parent;
+  std::vector<std::unique_ptr<Environment>> envs;
+};
+
+// what filter keeps, a true bool or a non-zero number
+bool isTrue(const Value& value);
+
+// on a stream these queue a stage instead, see Streams
+Value map(Arguments args);     // map(array, f), f(x) for every element
+Value filter(Arguments args);  // filter(array, f), elements where f(x) != 0
+// reduce(array, f, initial), f(f(initial, a[0]), a[1])... f has to be
+// associative, chunks are reduced on their own and then combined in order
+Value reduce(Arguments args);
+
+// runs top-level statement i in env on the pool slot worker
+using Statement =
+    std::function<void(size_t i, Environment& env, size_t worker)>;
+
+// runs every statement of graph, a level at a time (see StatementGraph). a
+// level's statements run on the pool in environments of their own, which
+// get the globals each reads from env and hand back the one it writes.
+// once a statement fails the ones after it aren't started, the error of
+// the first to fail is thrown when the others are done
+void runStatements(const StatementGraph& graph, Environment& env,
+                   const Statement& run);
+
+}  // namespace Parallel
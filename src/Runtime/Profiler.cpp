@@ -0,0 +1,247 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// a function is its name and whether it's a built-in
+using Key = uint64_t;
+constexpr Key SCRIPT = ~Key(0);  // the root of the enabling thread's tree
+
+Key key(Symbol function, bool builtIn) {
+  return static_cast<Key>(function) << 1 | (builtIn ? 1 : 0);
+}
+
+std::string name(Key key) {
+  if (key == SCRIPT) return "script";
+  const std::string function = symbolName(static_cast<Symbol>(key >> 1));
+  return key & 1 ? function + " (built-in)" : function;
+}
+
+struct Totals {
+  uint64_t calls = 0;
+  Clock::duration inclusive{};  // only the outermost of recursive calls
+  Clock::duration exclusive{};
+};
+
+// one node per distinct stack of calls leading here
+struct Node {
+  Key key;
+  Clock::duration exclusive{};
+  std::unordered_map<Key, uint32_t> children;
+};
+
+struct Frame {
+  Key key;
+  int position;
+  uint32_t node;
+  Clock::time_point start;
+  Clock::duration callees{};
+};
+
+// everything one thread recorded. only that thread touches it until the
+// program is done and the report reads it
+struct Thread {
+  bool main = false;
+  std::vector<Frame> stack;
+  std::vector<Node> tree{Node{SCRIPT, {}, {}}};
+  std::unordered_map<Key, Totals> functions;
+  std::map<std::pair<int, Key>, Totals> sites;
+  std::unordered_map<Key, uint32_t> active;  // frames on the stack, per key
+};
+
+constexpr size_t ROWS = 20;  // of each table in the report
+
+std::mutex threadsLock;
+std::vector<std::unique_ptr<Thread>> threads;
+std::vector<size_t> lineStarts;
+Clock::time_point started;
+
+Thread& current() {
+  thread_local Thread* thread = nullptr;
+  if (!thread) {
+    std::lock_guard<std::mutex> guard(threadsLock);
+    threads.push_back(std::make_unique<Thread>());
+    thread = threads.back().get();
+  }
+  return *thread;
+}
+
+void push(Thread& thread, Key key, int position, Clock::time_point now) {
+  const uint32_t parent = thread.stack.empty() ? 0 : thread.stack.back().node;
+  auto child = thread.tree[parent].children.find(key);
+  uint32_t node;
+  if (key == SCRIPT) {
+    node = 0;
+  } else if (child != thread.tree[parent].children.end()) {
+    node = child->second;
+  } else {
+    node = static_cast<uint32_t>(thread.tree.size());
+    thread.tree[parent].children.emplace(key, node);
+    thread.tree.push_back(Node{key, {}, {}});
+  }
+  thread.stack.push_back({key, position, node, now, {}});
+  if (key == SCRIPT) return;
+  thread.functions[key].calls++;
+  thread.sites[{position, key}].calls++;
+  thread.active[key]++;
+}
+
+void pop(Thread& thread, Clock::time_point now) {
+  const Frame frame = thread.stack.back();
+  thread.stack.pop_back();
+  const Clock::duration elapsed = now - frame.start;
+  const Clock::duration exclusive = elapsed - frame.callees;
+  if (!thread.stack.empty()) thread.stack.back().callees += elapsed;
+  thread.tree[frame.node].exclusive += exclusive;
+  if (frame.key == SCRIPT) return;
+
+  Totals& function = thread.functions[frame.key];
+  Totals& site = thread.sites[{frame.position, frame.key}];
+  function.exclusive += exclusive;
+  site.exclusive += exclusive;
+  if (--thread.active[frame.key] == 0) {
+    function.inclusive += elapsed;
+    site.inclusive += elapsed;
+  }
+}
+
+// frames left open by an error, or the script's own, end now
+void closeAll() {
+  const Clock::time_point now = Clock::now();
+  for (const std::unique_ptr<Thread>& thread : threads)
+    while (!thread->stack.empty()) pop(*thread, now);
+}
+
+std::string position(int offset) {
+  if (offset < 0) return "a built-in";
+  if (lineStarts.empty()) return "offset " + std::to_string(offset);
+  const auto line = std::upper_bound(lineStarts.begin(), lineStarts.end(),
+                                     static_cast<size_t>(offset));
+  const size_t index = line - lineStarts.begin();
+  return "line " + std::to_string(index) + ":" +
+         std::to_string(offset - lineStarts[index - 1] + 1);
+}
+
+double milliseconds(Clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+template <typename K>
+void merge(std::map<K, Totals>& into, const K& key, const Totals& totals) {
+  Totals& merged = into[key];
+  merged.calls += totals.calls;
+  merged.inclusive += totals.inclusive;
+  merged.exclusive += totals.exclusive;
+}
+
+void writeNode(const Thread& thread, uint32_t index, std::string path,
+               std::map<std::string, long long>& stacks) {
+  const Node& node = thread.tree[index];
+  if (index == 0)
+    path = thread.main ? "script" : "worker";
+  else
+    path += ";" + name(node.key);
+  const long long micros =
+      std::chrono::duration_cast<std::chrono::microseconds>(node.exclusive)
+          .count();
+  if (micros > 0) stacks[path] += micros;
+  for (const auto& child : node.children)
+    writeNode(thread, child.second, path, stacks);
+}
+
+}  // namespace
+
+void Profiler::enable() {
+  enabled = true;
+  Thread& thread = current();
+  thread.main = true;
+  started = Clock::now();
+  push(thread, SCRIPT, -1, started);
+}
+
+void Profiler::addSource(std::string_view text, size_t offset) {
+  if (lineStarts.empty()) lineStarts.push_back(0);
+  for (size_t i = 0; i < text.size(); i++)
+    if (text[i] == '\n') lineStarts.push_back(offset + i + 1);
+}
+
+void Profiler::enter(Symbol function, bool builtIn, int position) {
+  push(current(), key(function, builtIn), position, Clock::now());
+}
+
+void Profiler::leave() { pop(current(), Clock::now()); }
+
+void Profiler::report(std::ostream& out) {
+  std::lock_guard<std::mutex> guard(threadsLock);
+  closeAll();
+  std::map<Key, Totals> functions;
+  std::map<std::pair<int, Key>, Totals> sites;
+  for (const std::unique_ptr<Thread>& thread : threads) {
+    for (const auto& function : thread->functions)
+      merge(functions, function.first, function.second);
+    for (const auto& site : thread->sites)
+      merge(sites, site.first, site.second);
+  }
+
+  uint64_t calls = 0;
+  for (const auto& function : functions) calls += function.second.calls;
+  char line[256];
+  std::snprintf(line, sizeof line, "profile: %llu calls in %.3f ms\n",
+                static_cast<unsigned long long>(calls),
+                milliseconds(Clock::now() - started));
+  out << line << "  self ms    total ms       calls  function\n";
+
+  std::vector<std::pair<Key, Totals>> byTime(functions.begin(),
+                                             functions.end());
+  std::sort(byTime.begin(), byTime.end(), [](const auto& a, const auto& b) {
+    return a.second.exclusive > b.second.exclusive;
+  });
+  for (size_t i = 0; i < byTime.size() && i < ROWS; i++) {
+    const auto& function = byTime[i];
+    std::snprintf(line, sizeof line, "%9.3f %11.3f %11llu  %s\n",
+                  milliseconds(function.second.exclusive),
+                  milliseconds(function.second.inclusive),
+                  static_cast<unsigned long long>(function.second.calls),
+                  name(function.first).c_str());
+    out << line;
+  }
+
+  // call sites by the time spent in what they called
+  std::vector<std::pair<std::pair<int, Key>, Totals>> bySite(sites.begin(),
+                                                             sites.end());
+  std::sort(bySite.begin(), bySite.end(), [](const auto& a, const auto& b) {
+    return a.second.inclusive > b.second.inclusive;
+  });
+  out << "   total ms       calls  call site\n";
+  for (size_t i = 0; i < bySite.size() && i < ROWS; i++) {
+    const auto& site = bySite[i];
+    std::snprintf(line, sizeof line, "%11.3f %11llu  %s from %s\n",
+                  milliseconds(site.second.inclusive),
+                  static_cast<unsigned long long>(site.second.calls),
+                  name(site.first.second).c_str(),
+                  position(site.first.first).c_str());
+    out << line;
+  }
+}
+
+void Profiler::writeStacks(std::ostream& out) {
+  std::lock_guard<std::mutex> guard(threadsLock);
+  closeAll();
+  std::map<std::string, long long> stacks;
+  for (const std::unique_ptr<Thread>& thread : threads)
+    writeNode(*thread, 0, "", stacks);
+  for (const auto& stack : stacks)
+    out << stack.first << ' ' << stack.second << '\n';
+}
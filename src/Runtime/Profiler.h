@@ -0,0 +1,54 @@
+#pragma once
+
+#include <ostream>
+#include <string_view>
+
+#include "../Types/Symbol.h"
+
+/*
+counts the calls of every lambda and built-in and the time spent in them,
+both inclusive and without their callees, along with the call site they
+came from (a FunctionCallNode's position). every thread records into its
+own call tree, the report is made from all of them once the program is done
+and gives the hotspots and the collapsed stacks flamegraph tools read.
+when profiling is off a call only checks isEnabled().
+*/
+class Profiler {
+ public:
+  static bool isEnabled() { return enabled; }
+  // before anything runs, the calling thread's time counts as the script's
+  static void enable();
+  // the text call site positions point into, for line and column numbers.
+  // offset is where it starts in the whole input, text read in pieces is
+  // added in order
+  static void addSource(std::string_view text, size_t offset = 0);
+
+  // function is the lambda's binding name or the built-in's. position is the
+  // call site's offset in the source, -1 if a built-in made the call
+  static void enter(Symbol function, bool builtIn, int position);
+  static void leave();
+
+  // the hotspots, by time spent in each function and at each call site
+  static void report(std::ostream& out);
+  // one "caller;callee;... microseconds" line per distinct stack
+  static void writeStacks(std::ostream& out);
+
+  // records a call for as long as it's in scope, when profiling
+  class Call {
+   public:
+    Call(Symbol function, bool builtIn, int position) : active(enabled) {
+      if (active) enter(function, builtIn, position);
+    }
+    ~Call() {
+      if (active) leave();
+    }
+    Call(const Call&) = delete;
+    Call& operator=(const Call&) = delete;
+
+   private:
+    bool active;
+  };
+
+ private:
+  static inline bool enabled = false;
+};
@@ -0,0 +1,244 @@
+#include "Stream.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+#include "../Types/ArrayKernels.h"
+#include "Parallel.h"
+#include "ThreadPool.h"
+
+Value::Value(StreamObject* v) : bits(fromObject(v)) {}
+
+const StreamObject& Value::asStream() const {
+  if (!isStream()) throw std::runtime_error("Value is not a stream");
+  return *static_cast<const StreamObject*>(object());
+}
+
+namespace {
+
+// n values, ints if integral, after every stage has run on them
+using Sink = std::function<void(const double* values, size_t n, bool integral)>;
+
+// runs the stages over elements [begin, end) of the range
+void pull(const StreamObject& stream, Environment& env, size_t begin,
+          size_t end, const Sink& sink) {
+  double block[Streams::BLOCK_SIZE];
+  for (size_t at = begin; at < end; at += Streams::BLOCK_SIZE) {
+    size_t n = std::min(Streams::BLOCK_SIZE, end - at);
+    for (size_t i = 0; i < n; i++)
+      block[i] = static_cast<double>(stream.start) +
+                 static_cast<double>(at + i);
+    bool integral = true;
+
+    for (const StreamObject::Stage& stage : stream.stages) {
+      size_t kept = 0;
+      bool mapped = true;
+      for (size_t i = 0; i < n; i++) {
+        const Value x = Value::number(block[i], integral);
+        const Value result = env.call(stage.function, &x, 1);
+        if (stage.kind == StreamObject::StageKind::Filter) {
+          if (Parallel::isTrue(result)) block[kept++] = block[i];
+          continue;
+        }
+        if (!result.isNumeric())
+          throw std::runtime_error("Stream elements must be numeric");
+        mapped = mapped && result.isInt();
+        block[kept++] = result.isInt() ? result.asInt() : result.asDouble();
+      }
+      n = kept;
+      if (stage.kind == StreamObject::StageKind::Map) integral = mapped;
+    }
+    if (n > 0) sink(block, n, integral);
+  }
+}
+
+// pulls the whole stream on the pool into one accumulator per chunk
+template <typename Partial, typename Consume>
+std::vector<Partial> pullChunks(const Value& value, Environment& env,
+                                std::vector<Partial> partial,
+                                Consume consume) {
+  const StreamObject& stream = value.asStream();
+  const size_t size = Parallel::chunkSize(stream.count);
+  partial.resize((stream.count + size - 1) / size);
+  Parallel::Workers workers(env);
+  ThreadPool::shared().parallelFor(
+      stream.count, size, [&](size_t begin, size_t end, size_t worker) {
+        Environment& local = workers[worker];
+        Partial& into = partial[begin / size];
+        pull(stream, local, begin, end,
+             [&](const double* values, size_t n, bool integral) {
+               consume(into, local, values, n, integral);
+             });
+      });
+  return partial;
+}
+
+Value stage(const Value& stream, const Value& function,
+            StreamObject::StageKind kind, const char* name) {
+  if (!function.isLambda())
+    throw std::runtime_error(std::string(name) +
+                             " expects a stream and a lambda");
+  const StreamObject& source = stream.asStream();
+  std::vector<StreamObject::Stage> stages = source.stages;
+  stages.push_back({kind, function});
+  return Value(
+      new StreamObject(source.start, source.count, std::move(stages)));
+}
+
+struct Extreme {
+  bool any = false;
+  double value = 0;
+  bool integral = true;
+};
+
+template <typename Better>
+Value extreme(const Value& stream, Environment& env, ReduceKernel kernel,
+              Better better, const char* name) {
+  const std::vector<Extreme> partial = pullChunks(
+      stream, env, std::vector<Extreme>(),
+      [&](Extreme& into, Environment&, const double* values, size_t n,
+          bool integral) {
+        const double value = kernel(values, n);
+        if (!into.any || better(value, into.value)) into.value = value;
+        into.any = true;
+        into.integral = into.integral && integral;
+      });
+
+  Extreme result;
+  for (const Extreme& chunk : partial) {
+    if (!chunk.any) continue;
+    if (!result.any || better(chunk.value, result.value))
+      result.value = chunk.value;
+    result.any = true;
+    result.integral = result.integral && chunk.integral;
+  }
+  if (!result.any)
+    throw std::runtime_error(std::string(name) + " of an empty stream");
+  return Value::number(result.value, result.integral);
+}
+
+}  // namespace
+
+Value Streams::range(Arguments args) {
+  if (args.size() != 2 || !args[0].isInt() || !args[1].isInt())
+    throw std::runtime_error("range expects two int arguments");
+  const int start = args[0].asInt(), end = args[1].asInt();
+  const size_t count =
+      end > start ? static_cast<size_t>(static_cast<int64_t>(end) - start) : 0;
+  return Value(new StreamObject(start, count, {}));
+}
+
+Value Streams::map(const Value& stream, const Value& function) {
+  return stage(stream, function, StreamObject::StageKind::Map, "map");
+}
+
+Value Streams::filter(const Value& stream, const Value& function) {
+  return stage(stream, function, StreamObject::StageKind::Filter, "filter");
+}
+
+Value Streams::length(const Value& stream, Environment& env) {
+  // without filters the stages don't change the length, but they still run
+  const std::vector<size_t> partial = pullChunks(
+      stream, env, std::vector<size_t>(),
+      [](size_t& into, Environment&, const double*, size_t n, bool) {
+        into += n;
+      });
+  size_t total = 0;
+  for (size_t count : partial) total += count;
+  return Value::number(static_cast<double>(total), true);
+}
+
+Value Streams::sum(const Value& stream, Environment& env) {
+  struct Total {
+    double value = 0;
+    bool integral = true;
+  };
+  const std::vector<Total> partial = pullChunks(
+      stream, env, std::vector<Total>(),
+      [](Total& into, Environment&, const double* values, size_t n,
+         bool integral) {
+        into.value += arrayKernels().sum(values, n);
+        into.integral = into.integral && integral;
+      });
+  Total total;
+  for (const Total& chunk : partial) {
+    total.value += chunk.value;
+    total.integral = total.integral && chunk.integral;
+  }
+  return Value::number(total.value, total.integral);
+}
+
+Value Streams::min(const Value& stream, Environment& env) {
+  return extreme(stream, env, arrayKernels().min,
+                 [](double a, double b) { return a < b; }, "min");
+}
+
+Value Streams::max(const Value& stream, Environment& env) {
+  return extreme(stream, env, arrayKernels().max,
+                 [](double a, double b) { return a > b; }, "max");
+}
+
+// like reduce on an array, the first chunk starts from the initial value
+// and the others from their first element
+Value Streams::reduce(const Value& stream, const Value& function,
+                      const Value& initial, Environment& env) {
+  if (!function.isLambda())
+    throw std::runtime_error(
+        "reduce expects a stream and a lambda and an initial value");
+  if (stream.asStream().count == 0) return initial;
+  struct Total {
+    bool any = false;
+    Value value;
+  };
+  std::vector<Total> start(1);
+  start[0] = {true, initial};
+  std::vector<Total> partial = pullChunks(
+      stream, env, std::move(start),
+      [&](Total& into, Environment& local, const double* values, size_t n,
+          bool integral) {
+        for (size_t i = 0; i < n; i++) {
+          Value x = Value::number(values[i], integral);
+          if (!into.any) {
+            into = {true, std::move(x)};
+            continue;
+          }
+          const Value pair[2] = {std::move(into.value), std::move(x)};
+          into.value = local.call(function, pair, 2);
+        }
+      });
+
+  Value total = std::move(partial[0].value);
+  for (size_t i = 1; i < partial.size(); i++) {
+    if (!partial[i].any) continue;
+    const Value pair[2] = {std::move(total), std::move(partial[i].value)};
+    total = env.call(function, pair, 2);
+  }
+  return total;
+}
+
+Value Streams::collect(const Value& stream, Environment& env) {
+  struct Part {
+    std::vector<double> values;
+    bool integral = true;
+  };
+  const std::vector<Part> partial = pullChunks(
+      stream, env, std::vector<Part>(),
+      [](Part& into, Environment&, const double* values, size_t n,
+         bool integral) {
+        into.values.insert(into.values.end(), values, values + n);
+        into.integral = into.integral && integral;
+      });
+
+  size_t total = 0;
+  bool integral = true;
+  for (const Part& part : partial) {
+    total += part.values.size();
+    integral = integral && part.integral;
+  }
+  auto result = new ArrayObject(total, integral);
+  double* out = result->values.get();
+  for (const Part& part : partial)
+    out = std::copy(part.values.begin(), part.values.end(), out);
+  return Value(result);
+}
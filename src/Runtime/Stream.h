@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+
+#include "../Parser/Environment.h"
+
+/*
+a lazy sequence: a range of ints and the map and filter stages queued on it.
+nothing runs until something consumes the stream, which pulls the range
+through every stage a block at a time, so memory use doesn't grow with its
+length. like arrays, streams never change, queuing a stage makes a new one.
+*/
+struct StreamObject : HeapObject {
+  enum class StageKind : uint8_t { Map, Filter };
+  struct Stage {
+    StageKind kind;
+    Value function;
+  };
+
+  const int start;
+  const size_t count;  // the range is [start, start + count)
+  const std::vector<Stage> stages;
+
+  StreamObject(int start, size_t count, std::vector<Stage> stages)
+      : HeapObject(Kind::Stream),
+        start(start),
+        count(count),
+        stages(std::move(stages)) {}
+};
+
+/*
+consuming a stream splits its range into the same chunks an array of that
+length gets (see Parallel::chunkSize), each pulled by one worker and merged
+in order, so results don't depend on the number of threads.
+*/
+namespace Streams {
+
+// elements pulled through the stages at a time, per worker
+constexpr size_t BLOCK_SIZE = 1024;
+
+Value range(Arguments args);  // range(a, b), the ints from a up to b
+
+// a new stream with f queued behind the existing stages
+Value map(const Value& stream, const Value& function);
+Value filter(const Value& stream, const Value& function);
+
+// these run the stages
+Value length(const Value& stream, Environment& env);
+Value sum(const Value& stream, Environment& env);
+Value min(const Value& stream, Environment& env);
+Value max(const Value& stream, Environment& env);
+Value reduce(const Value& stream, const Value& function, const Value& initial,
+             Environment& env);
+Value collect(const Value& stream, Environment& env);  // into an array
+
+}  // namespace Streams
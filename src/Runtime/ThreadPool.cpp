@@ -0,0 +1,150 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <iterator>
+
+// the pool and slot the current thread works in, if any
+static thread_local const ThreadPool* currentPool = nullptr;
+static thread_local size_t currentWorker = 0;
+
+size_t ThreadPool::configuredThreads = 0;
+
+ThreadPool::ThreadPool(size_t threadCount) {
+  const size_t workers = std::max<size_t>(threadCount, 1);
+  for (size_t i = 0; i < workers; i++)
+    queues.push_back(std::make_unique<Queue>());
+  for (size_t i = 0; i + 1 < workers; i++)
+    threads.emplace_back(&ThreadPool::work, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread& thread : threads) thread.join();
+}
+
+ThreadPool& ThreadPool::shared() {
+  static ThreadPool pool(
+      configuredThreads ? configuredThreads
+                        : std::max(1u, std::thread::hardware_concurrency()));
+  return pool;
+}
+
+void ThreadPool::configure(size_t threads) { configuredThreads = threads; }
+
+void ThreadPool::parallelFor(size_t count, size_t chunkSize, const Body& body) {
+  if (count == 0) return;
+  chunkSize = std::max<size_t>(chunkSize, 1);
+  const size_t chunks = (count + chunkSize - 1) / chunkSize;
+
+  // an outside thread works in the last slot for as long as the job runs
+  const bool outsider = currentPool != this;
+  const ThreadPool* previousPool = currentPool;
+  const size_t previousWorker = currentWorker;
+  if (outsider) {
+    currentPool = this;
+    currentWorker = queues.size() - 1;
+  }
+  const size_t worker = currentWorker;
+
+  Job job;
+  job.body = &body;
+  job.phase = Memory::phase();
+  job.pending = chunks;
+  {
+    // the first chunk ends up at the back, where this thread takes from
+    Queue& queue = *queues[worker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    for (size_t i = chunks; i-- > 0;)
+      queue.tasks.push_back({&job, i * chunkSize,
+                             std::min(count, (i + 1) * chunkSize)});
+  }
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    queued += chunks;
+  }
+  if (chunks > 1) wake.notify_all();
+
+  Task task;
+  while (job.pending.load(std::memory_order_acquire) > 0) {
+    if (pop(worker, task, &job) || steal(worker, task, &job))
+      run(task, worker);
+    else
+      std::this_thread::yield();
+  }
+
+  if (outsider) {
+    currentPool = previousPool;
+    currentWorker = previousWorker;
+  }
+  if (job.error) std::rethrow_exception(job.error);
+}
+
+void ThreadPool::work(size_t worker) {
+  currentPool = this;
+  currentWorker = worker;
+  Task task;
+  for (;;) {
+    if (pop(worker, task, nullptr) || steal(worker, task, nullptr)) {
+      run(task, worker);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    wake.wait(lock, [&] { return stopping || queued.load() > 0; });
+    if (stopping) return;
+  }
+}
+
+void ThreadPool::run(const Task& task, size_t worker) {
+  Job& job = *task.job;
+  if (!job.failed.load(std::memory_order_relaxed)) {
+    try {
+      Memory::Scope memory(job.phase);
+      (*job.body)(task.begin, task.end, worker);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(job.errorMutex);
+      if (!job.error) job.error = std::current_exception();
+      job.failed = true;
+    }
+  }
+  // the job may be gone as soon as this drops to zero
+  job.pending.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+// the newest task of the worker's own queue. while waiting for a job only
+// its own tasks are taken, anything else could be holding this thread up.
+// outside threads share a queue, so theirs can be under another job's
+bool ThreadPool::pop(size_t worker, Task& task, const Job* only) {
+  Queue& queue = *queues[worker];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  auto it = queue.tasks.rbegin();
+  if (only)
+    it = std::find_if(queue.tasks.rbegin(), queue.tasks.rend(),
+                      [&](const Task& t) { return t.job == only; });
+  if (it == queue.tasks.rend()) return false;
+  task = *it;
+  queue.tasks.erase(std::next(it).base());
+  queued--;
+  return true;
+}
+
+// the oldest task of another queue, the largest amount of work left there
+bool ThreadPool::steal(size_t worker, Task& task, const Job* only) {
+  for (size_t i = 1; i < queues.size(); i++) {
+    Queue& queue = *queues[(worker + i) % queues.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    auto it = queue.tasks.begin();
+    if (only)
+      it = std::find_if(queue.tasks.begin(), queue.tasks.end(),
+                        [&](const Task& t) { return t.job == only; });
+    if (it == queue.tasks.end()) continue;
+    task = *it;
+    queue.tasks.erase(it);
+    queued--;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Memory.h"
+
+/*
+a work-stealing pool. every worker owns a deque: it takes work from the back
+of its own and steals from the front of the others'. a thread waiting for a
+job helps by running that job's chunks, so jobs can be started from inside
+other jobs without tying up a worker.
+the thread that starts a job takes part in it as one more worker, threads
+outside the pool share the last slot's queue. each only takes its own job's
+chunks from there, so any number of them run jobs at once and no thread runs
+two jobs' chunks under the same worker number.
+*/
+class ThreadPool {
+ public:
+  // body(begin, end, worker) for one chunk, worker is below workerCount()
+  // and no two threads running chunks of the same job share one
+  using Body = std::function<void(size_t, size_t, size_t)>;
+
+  // threads counts the caller, so 1 runs everything on it
+  explicit ThreadPool(size_t threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // the process-wide pool, sized on first use
+  static ThreadPool& shared();
+  // size for the shared pool, 0 for one thread per core. only has an
+  // effect before the pool is first used
+  static void configure(size_t threads);
+
+  size_t workerCount() const { return queues.size(); }
+
+  // runs body over [0, count) split into chunks of chunkSize, returns once
+  // every chunk is done and rethrows the first exception one threw.
+  // chunk boundaries only depend on the arguments, never on scheduling
+  void parallelFor(size_t count, size_t chunkSize, const Body& body);
+
+ private:
+  struct Job {
+    const Body* body;
+    Memory::Phase phase;  // the starting thread's, for --mem-stats
+    std::atomic<size_t> pending;
+    std::atomic<bool> failed{false};
+    std::mutex errorMutex;
+    std::exception_ptr error;
+  };
+
+  struct Task {
+    Job* job;
+    size_t begin, end;
+  };
+
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  void work(size_t worker);
+  void run(const Task& task, size_t worker);
+  bool pop(size_t worker, Task& task, const Job* only);
+  bool steal(size_t worker, Task& task, const Job* only);
+
+  std::vector<std::unique_ptr<Queue>> queues;  // the last is for outsiders
+  std::vector<std::thread> threads;
+
+  std::mutex sleepMutex;
+  std::condition_variable wake;
+  std::atomic<size_t> queued{0};
+  bool stopping = false;
+
+  static size_t configuredThreads;
+};
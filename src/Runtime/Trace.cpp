@@ -0,0 +1,155 @@
+#include "Trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../Types/Symbol.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Event {
+  uint64_t time;  // nanoseconds since tracing was enabled
+  uint32_t id;
+  Trace::Kind kind;
+  char phase;  // 'B' or 'E', as in the trace format
+};
+
+// written only by its own thread. head counts every event ever recorded,
+// the last CAPACITY of them are kept
+struct Buffer {
+  std::unique_ptr<Event[]> events{new Event[Trace::CAPACITY]};
+  std::atomic<uint64_t> head{0};
+  size_t thread;
+};
+
+static_assert((Trace::CAPACITY & (Trace::CAPACITY - 1)) == 0,
+              "the capacity has to be a power of two");
+
+std::mutex buffersLock;  // only taken when a thread records its first event
+std::vector<std::unique_ptr<Buffer>> buffers;
+Clock::time_point started;
+
+Buffer& current() {
+  thread_local Buffer* buffer = nullptr;
+  if (!buffer) {
+    std::lock_guard<std::mutex> guard(buffersLock);
+    buffers.push_back(std::make_unique<Buffer>());
+    buffers.back()->thread = buffers.size() - 1;
+    buffer = buffers.back().get();
+  }
+  return *buffer;
+}
+
+void record(Trace::Kind kind, uint32_t id, char phase) {
+  Buffer& buffer = current();
+  const uint64_t head = buffer.head.load(std::memory_order_relaxed);
+  const uint64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            Clock::now() - started)
+                            .count();
+  buffer.events[head & (Trace::CAPACITY - 1)] = {time, id, kind, phase};
+  buffer.head.store(head + 1, std::memory_order_release);
+}
+
+const char* phaseName(uint32_t phase) {
+  static const char* const names[] = {"read",     "lex",     "parse", "resolve",
+                                      "optimize", "compile", "run"};
+  return phase < sizeof names / sizeof *names ? names[phase] : "phase";
+}
+
+// names are symbols or made up here, neither needs escaping beyond quotes
+std::string quoted(const std::string& text) {
+  std::string out = "\"";
+  for (char c : text) {
+    if (c == '"' || c == '\\') out += '\\';
+    out += c;
+  }
+  return out + "\"";
+}
+
+void writeEvent(std::ostream& out, bool& first, const Event& event,
+                size_t thread) {
+  std::string name, category;
+  switch (event.kind) {
+    case Trace::Kind::Phase:
+      name = phaseName(event.id);
+      category = "phase";
+      break;
+    case Trace::Kind::Statement:
+      name = "statement " + std::to_string(event.id);
+      category = "statement";
+      break;
+    case Trace::Kind::Lambda:
+      name = symbolName(event.id);
+      category = "lambda";
+      break;
+    case Trace::Kind::BuiltIn:
+      name = symbolName(event.id);
+      category = "built-in";
+      break;
+  }
+  char time[32];
+  std::snprintf(time, sizeof time, "%.3f", event.time / 1000.0);
+  out << (first ? "\n" : ",\n") << "{\"name\": " << quoted(name)
+      << ", \"cat\": \"" << category << "\", \"ph\": \"" << event.phase
+      << "\", \"ts\": " << time << ", \"pid\": 1, \"tid\": " << thread << "}";
+  first = false;
+}
+
+}  // namespace
+
+void Trace::enable() {
+  started = Clock::now();
+  enabled = true;
+  current();  // the calling thread is the main one
+}
+
+void Trace::begin(Kind kind, uint32_t id) { record(kind, id, 'B'); }
+
+void Trace::end(Kind kind, uint32_t id) { record(kind, id, 'E'); }
+
+void Trace::write(std::ostream& out) {
+  std::lock_guard<std::mutex> guard(buffersLock);
+  const uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           Clock::now() - started)
+                           .count();
+  bool first = true;
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+  for (const std::unique_ptr<Buffer>& buffer : buffers) {
+    out << (first ? "\n" : ",\n") << "{\"name\": \"thread_name\", \"ph\": "
+        << "\"M\", \"pid\": 1, \"tid\": " << buffer->thread
+        << ", \"args\": {\"name\": \""
+        << (buffer->thread == 0 ? "main" : "worker") << "\"}}";
+    first = false;
+
+    const uint64_t head = buffer->head.load(std::memory_order_acquire);
+    const uint64_t start = head > CAPACITY ? head - CAPACITY : 0;
+    // ends whose begin was overwritten are dropped, begins still open are
+    // ended now
+    std::vector<Event> open;
+    for (uint64_t i = start; i < head; i++) {
+      const Event& event = buffer->events[i & (CAPACITY - 1)];
+      if (event.phase == 'E') {
+        if (open.empty()) continue;
+        open.pop_back();
+      } else {
+        open.push_back(event);
+      }
+      writeEvent(out, first, event, buffer->thread);
+    }
+    while (!open.empty()) {
+      Event event = open.back();
+      open.pop_back();
+      event.time = now;
+      event.phase = 'E';
+      writeEvent(out, first, event, buffer->thread);
+    }
+  }
+  out << "\n]}\n";
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+/*
+a timeline of the run for --trace: begin and end events for the phases
+(reading, lexing, parsing, ...), each top-level statement and each lambda
+and built-in call, written out in the Chrome trace-event format that
+chrome://tracing and Perfetto load.
+every thread records into a ring buffer of its own without taking a lock,
+once it's full the oldest events are overwritten. the buffers are read once
+the program is done. when tracing is off an event only checks isEnabled().
+*/
+class Trace {
+ public:
+  enum class Kind : uint8_t { Phase, Statement, Lambda, BuiltIn };
+  // the ids of Kind::Phase events
+  enum Phase : uint32_t { Read, Lex, Parse, Resolve, Optimize, Compile, Run };
+
+  static constexpr size_t CAPACITY = 1 << 18;  // events kept per thread
+
+  static bool isEnabled() { return enabled; }
+  static void enable();
+
+  // id is a Phase, the statement's index, or the lambda's or built-in's name
+  static void begin(Kind kind, uint32_t id);
+  static void end(Kind kind, uint32_t id);
+
+  // the events as a JSON object, calls still running end now
+  static void write(std::ostream& out);
+
+  // a begin event now and the end when it goes out of scope, when tracing
+  class Scope {
+   public:
+    Scope(Kind kind, uint32_t id) : kind(kind), id(id), active(enabled) {
+      if (active) begin(kind, id);
+    }
+    ~Scope() { close(); }
+    // ends it early, before the scope does
+    void close() {
+      if (active) end(kind, id);
+      active = false;
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    Kind kind;
+    uint32_t id;
+    bool active;
+  };
+
+ private:
+  static inline bool enabled = false;
+};
@@ -0,0 +1,68 @@
+#include "ProgramCache.h"
+
+uint64_t ProgramCache::key(std::string_view source,
+                           const std::vector<Symbol>& inputs) {
+  uint64_t hash = 14695981039346656037ull;  // FNV-1a
+  auto add = [&](unsigned char byte) {
+    hash ^= byte;
+    hash *= 1099511628211ull;
+  };
+  for (char c : source) add(static_cast<unsigned char>(c));
+  // a name can't contain a newline, the script's last line can
+  for (Symbol input : inputs) {
+    add('\0');
+    for (char c : symbolName(input)) add(static_cast<unsigned char>(c));
+  }
+  return hash;
+}
+
+std::shared_ptr<const CompiledProgram> ProgramCache::find(
+    uint64_t key, std::string_view source, const std::vector<Symbol>& inputs) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = index.find(key);
+  if (it == index.end() || it->second->second->source != source ||
+      it->second->second->inputs != inputs) {
+    missCount++;
+    return nullptr;
+  }
+  entries.splice(entries.begin(), entries, it->second);
+  hitCount++;
+  return it->second->second;
+}
+
+std::shared_ptr<const CompiledProgram> ProgramCache::insert(
+    uint64_t key, std::shared_ptr<const CompiledProgram> program) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = index.find(key);
+  if (it != index.end()) {
+    // a collision is replaced, the same program is kept
+    if (it->second->second->source == program->source &&
+        it->second->second->inputs == program->inputs)
+      return it->second->second;
+    entries.erase(it->second);
+    index.erase(it);
+  }
+  entries.emplace_front(key, program);
+  index.emplace(key, entries.begin());
+
+  if (entries.size() > capacity) {
+    index.erase(entries.back().first);
+    entries.pop_back();
+  }
+  return program;
+}
+
+size_t ProgramCache::hits() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return hitCount;
+}
+
+size_t ProgramCache::misses() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return missCount;
+}
+
+size_t ProgramCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return entries.size();
+}
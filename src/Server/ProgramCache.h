@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../Parser/AST.h"
+#include "../VM/Bytecode.h"
+
+// a script lexed, parsed, resolved, optimized and compiled for one set of
+// input names, ready to run any number of times at once
+struct CompiledProgram {
+  std::string source;
+  std::vector<Symbol> inputs;  // in their slots' order
+  std::unique_ptr<ProgramNode> program;
+  BytecodeProgram bytecode;  // empty if requests walk the tree
+};
+
+/*
+the programs palmtree --serve has compiled, keyed by a hash of the script's
+content and its input names. only the least recently used capacity of them
+are kept, one that's dropped lives on until the requests running it are
+done. requests on every worker thread share it, every call takes the lock.
+*/
+class ProgramCache {
+ public:
+  explicit ProgramCache(size_t capacity) : capacity(capacity) {}
+
+  static uint64_t key(std::string_view source,
+                      const std::vector<Symbol>& inputs);
+
+  // the program for source and inputs, if it's been cached. key has to be
+  // theirs, the hash is checked against the program anyway
+  std::shared_ptr<const CompiledProgram> find(
+      uint64_t key, std::string_view source,
+      const std::vector<Symbol>& inputs);
+  // caches program under key, unless another request got there first, and
+  // returns the one cached
+  std::shared_ptr<const CompiledProgram> insert(
+      uint64_t key, std::shared_ptr<const CompiledProgram> program);
+
+  size_t hits() const;
+  size_t misses() const;
+  size_t size() const;
+
+ private:
+  using Entry = std::pair<uint64_t, std::shared_ptr<const CompiledProgram>>;
+
+  const size_t capacity;
+  mutable std::mutex mutex;
+  std::list<Entry> entries;  // the most recently used first
+  std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+  size_t hitCount = 0;
+  size_t missCount = 0;
+};
@@ -0,0 +1,191 @@
+#include "Protocol.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+
+std::runtime_error systemError(const std::string& what) {
+  return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+std::vector<std::string_view> words(std::string_view line) {
+  std::vector<std::string_view> result;
+  size_t pos = 0;
+  while (pos < line.size()) {
+    if (line[pos] == ' ') {
+      pos++;
+      continue;
+    }
+    const size_t end = std::min(line.find(' ', pos), line.size());
+    result.push_back(line.substr(pos, end - pos));
+    pos = end;
+  }
+  return result;
+}
+
+size_t number(std::string_view word, size_t limit) {
+  size_t value = 0;
+  auto [end, error] =
+      std::from_chars(word.data(), word.data() + word.size(), value);
+  if (error != std::errc() || end != word.data() + word.size() ||
+      value > limit)
+    throw std::runtime_error("Malformed message");
+  return value;
+}
+
+}  // namespace
+
+namespace Protocol {
+
+Connection::~Connection() {
+  if (fd >= 0) ::close(fd);
+}
+
+Connection::Connection(Connection&& other) noexcept
+    : fd(other.fd), buffer(std::move(other.buffer)), start(other.start) {
+  other.fd = -1;
+}
+
+Connection& Connection::operator=(Connection&& other) noexcept {
+  if (this != &other) {
+    if (fd >= 0) ::close(fd);
+    fd = other.fd;
+    buffer = std::move(other.buffer);
+    start = other.start;
+    other.fd = -1;
+  }
+  return *this;
+}
+
+Connection Connection::connect(const std::string& path) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof address.sun_path)
+    throw std::runtime_error("Socket path too long: " + path);
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+  Connection connection(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+  if (connection.fd < 0) throw systemError("Can't create a socket");
+  if (::connect(connection.fd, reinterpret_cast<sockaddr*>(&address),
+                sizeof address) != 0)
+    throw systemError("Can't connect to " + path);
+  return connection;
+}
+
+bool Connection::read(Request& request) {
+  std::string line;
+  if (!readLine(line)) return false;
+  const std::vector<std::string_view> header = words(line);
+  if (header.size() != 3 || header[0] != "run")
+    throw std::runtime_error("Malformed request");
+  const size_t bytes = number(header[1], MAX_PAYLOAD);
+  const size_t inputs = number(header[2], MAX_LINE);
+
+  request.inputs.clear();
+  for (size_t i = 0; i < inputs; i++) {
+    if (!readLine(line)) throw std::runtime_error("Connection closed early");
+    const std::vector<std::string_view> input = words(line);
+    if (input.size() != 2)
+      throw std::runtime_error("Malformed input: " + line);
+    request.inputs.emplace_back(input[0], input[1]);
+  }
+  readBytes(bytes, request.script);
+  return true;
+}
+
+bool Connection::read(Reply& reply) {
+  std::string line;
+  if (!readLine(line)) return false;
+  const std::vector<std::string_view> header = words(line);
+  if (header.size() == 2 && header[0] == "ok") {
+    reply.ok = true;
+    readBytes(number(header[1], MAX_PAYLOAD), reply.output);
+    reply.error.clear();
+  } else if (header.size() == 3 && header[0] == "error") {
+    reply.ok = false;
+    const size_t message = number(header[2], MAX_PAYLOAD);
+    readBytes(number(header[1], MAX_PAYLOAD), reply.output);
+    readBytes(message, reply.error);
+  } else {
+    throw std::runtime_error("Malformed reply");
+  }
+  return true;
+}
+
+void Connection::write(const Request& request) {
+  std::string message = "run " + std::to_string(request.script.size()) + " " +
+                        std::to_string(request.inputs.size()) + "\n";
+  for (const auto& [name, value] : request.inputs)
+    message += name + " " + value + "\n";
+  send(message + request.script);
+}
+
+void Connection::write(const Reply& reply) {
+  std::string header =
+      reply.ok ? "ok " + std::to_string(reply.output.size()) + "\n"
+               : "error " + std::to_string(reply.output.size()) + " " +
+                     std::to_string(reply.error.size()) + "\n";
+  send(header + reply.output + (reply.ok ? "" : reply.error));
+}
+
+// false if the stream ended before the line started
+bool Connection::readLine(std::string& line) {
+  size_t end;
+  while ((end = buffer.find('\n', start)) == std::string::npos) {
+    if (buffer.size() - start > MAX_LINE)
+      throw std::runtime_error("Line too long");
+    if (fill()) continue;
+    if (buffer.size() == start) return false;
+    throw std::runtime_error("Connection closed early");
+  }
+  line.assign(buffer, start, end - start);
+  start = end + 1;
+  return true;
+}
+
+void Connection::readBytes(size_t count, std::string& into) {
+  while (buffer.size() - start < count)
+    if (!fill()) throw std::runtime_error("Connection closed early");
+  into.assign(buffer, start, count);
+  start += count;
+}
+
+// false at the end of the stream
+bool Connection::fill() {
+  buffer.erase(0, start);
+  start = 0;
+  char chunk[64 * 1024];
+  for (;;) {
+    const ssize_t count = ::recv(fd, chunk, sizeof chunk, 0);
+    if (count > 0) {
+      buffer.append(chunk, static_cast<size_t>(count));
+      return true;
+    }
+    if (count == 0) return false;
+    if (errno != EINTR) throw systemError("Can't read from the socket");
+  }
+}
+
+// never raises SIGPIPE, a peer that went away is an error like any other
+void Connection::send(const std::string& data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    const ssize_t count =
+        ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (count >= 0)
+      sent += static_cast<size_t>(count);
+    else if (errno != EINTR)
+      throw systemError("Can't write to the socket");
+  }
+}
+
+}  // namespace Protocol
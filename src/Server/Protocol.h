@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+what palmtree --serve and its clients send each other over a unix domain
+socket. a request is a header line, one line per input binding and the
+script itself:
+
+  run <script bytes> <input count>\n
+  <name> <number>\n
+  <script>
+
+the reply is a header line, then what the script printed and, if it
+failed, the error message:
+
+  ok <output bytes>\n<output>
+  error <output bytes> <message bytes>\n<output><message>
+
+a connection carries any number of requests, each one is answered before
+the next is read.
+*/
+namespace Protocol {
+
+constexpr size_t MAX_LINE = 4096;          // header and input lines
+constexpr size_t MAX_PAYLOAD = 64 << 20;  // scripts, output and messages
+
+struct Request {
+  std::string script;
+  std::vector<std::pair<std::string, std::string>> inputs;  // name, number
+};
+
+struct Reply {
+  bool ok = true;
+  std::string output;
+  std::string error;
+};
+
+// a connected socket, closed with the object. malformed messages and
+// failed reads and writes throw
+class Connection {
+ public:
+  explicit Connection(int fd) : fd(fd) {}
+  ~Connection();
+  Connection(Connection&& other) noexcept;
+  Connection& operator=(Connection&& other) noexcept;
+  Connection(const Connection&) = delete;
+  Connection& operator=(const Connection&) = delete;
+
+  // to the server listening at path
+  static Connection connect(const std::string& path);
+
+  // false if the other end closed the connection instead of sending one
+  bool read(Request& request);
+  bool read(Reply& reply);
+  void write(const Request& request);
+  void write(const Reply& reply);
+
+  int descriptor() const { return fd; }
+  // true if more of the stream was read than the requests read so far used
+  bool buffered() const { return start < buffer.size(); }
+
+ private:
+  bool readLine(std::string& line);
+  void readBytes(size_t count, std::string& into);
+  bool fill();
+  void send(const std::string& data);
+
+  int fd;
+  std::string buffer;  // read but not consumed yet, from start
+  size_t start = 0;
+};
+
+}  // namespace Protocol
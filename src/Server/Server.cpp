@@ -0,0 +1,303 @@
+#include "Server.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+std::runtime_error systemError(const std::string& what) {
+  return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+template <typename T>
+bool parse(std::string_view text, T& value) {
+  auto [end, error] =
+      std::from_chars(text.data(), text.data() + text.size(), value);
+  return error == std::errc() && end == text.data() + text.size();
+}
+
+// a number the way the lexer reads one, an int unless it has a decimal
+// point, with a minus in front for a negative one
+Value inputValue(const std::string& name, const std::string& text) {
+  const bool negative = !text.empty() && text[0] == '-';
+  const std::string_view digits = std::string_view(text).substr(negative);
+  const bool digitsOnly =
+      !digits.empty() && std::all_of(digits.begin(), digits.end(), [](char c) {
+        return std::isdigit(static_cast<unsigned char>(c)) || c == '.';
+      });
+  if (digitsOnly && digits.find('.') == std::string_view::npos) {
+    int value;
+    if (parse(digits, value)) return Value(value, negative);
+  } else if (digitsOnly) {
+    double value;
+    if (parse(digits, value)) return Value(value, negative);
+  }
+  throw std::runtime_error("Input '" + name + "' isn't a number: " + text);
+}
+
+// checked before it's interned, a symbol is never freed
+Symbol inputName(const std::string& name) {
+  const bool identifier =
+      !name.empty() && std::isalpha(static_cast<unsigned char>(name[0])) &&
+      std::all_of(name.begin(), name.end(), [](char c) {
+        return std::isalnum(static_cast<unsigned char>(c));
+      });
+  if (!identifier) throw std::runtime_error("Invalid input name: " + name);
+  const Symbol symbol = intern(name);
+  if (Lexer::KEYWORDS.count(symbol))
+    throw std::runtime_error("Invalid input name: " + name);
+  return symbol;
+}
+
+// a client that stops halfway through a request, or stops reading its
+// reply, fails the request instead of holding its worker
+void setTimeouts(int fd) {
+  timeval timeout{};
+  timeout.tv_sec = Server::IO_TIMEOUT;
+  ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+  ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof timeout);
+}
+
+}  // namespace
+
+Server::Server(std::string path, ServeOptions options)
+    : path(std::move(path)),
+      options(options),
+      programs(std::max<size_t>(options.cacheSize, 1)) {}
+
+Server::~Server() {
+  for (int fd : wake)
+    if (fd >= 0) ::close(fd);
+  if (listener < 0) return;
+  ::close(listener);
+  ::unlink(path.c_str());
+}
+
+void Server::run() {
+  listen();
+  const size_t count = options.workers ? options.workers
+                                       : std::thread::hardware_concurrency();
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < std::max<size_t>(count, 1); i++)
+    workers.emplace_back([this] { work(); });
+
+  std::exception_ptr error;
+  std::vector<pollfd> polled;
+  while (!stopping.load()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      polled.assign({{listener, POLLIN, 0}, {wake[0], POLLIN, 0}});
+      for (const Protocol::Connection& connection : idle)
+        polled.push_back({connection.descriptor(), POLLIN, 0});
+    }
+    if (::poll(polled.data(), polled.size(), -1) < 0) {
+      if (errno == EINTR) continue;
+      error = std::make_exception_ptr(systemError("Can't poll"));
+      break;
+    }
+    if (polled[1].revents) {
+      char bytes[64];
+      while (::read(wake[0], bytes, sizeof bytes) > 0) {
+      }
+    }
+
+    {
+      // only this loop takes connections out of idle, so the ones polled
+      // are still the first ones. readable includes hung up, a worker finds
+      // out which
+      std::lock_guard<std::mutex> lock(mutex);
+      std::vector<Protocol::Connection> waiting;
+      for (size_t i = 0; i < idle.size(); i++) {
+        if (i + 2 < polled.size() && polled[i + 2].revents) {
+          pending.push_back(std::move(idle[i]));
+          ready.notify_one();
+        } else {
+          waiting.push_back(std::move(idle[i]));
+        }
+      }
+      idle.swap(waiting);
+    }
+
+    if (!polled[0].revents) continue;
+    const int fd = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd >= 0) {
+      setTimeouts(fd);
+      std::lock_guard<std::mutex> lock(mutex);
+      idle.emplace_back(fd);
+    } else if (!stopping.load() && errno != EINTR && errno != ECONNABORTED &&
+               errno != EAGAIN && errno != EWOULDBLOCK) {
+      error = std::make_exception_ptr(systemError("Can't accept"));
+      break;
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    // a connection being served ends once its current request is answered
+    for (int fd : serving) ::shutdown(fd, SHUT_RD);
+    pending.clear();
+    idle.clear();
+  }
+  ready.notify_all();
+  for (std::thread& worker : workers) worker.join();
+  if (error) std::rethrow_exception(error);
+}
+
+// only async-signal-safe calls
+void Server::stop() {
+  stopping = true;
+  if (listener >= 0) ::shutdown(listener, SHUT_RDWR);
+  wakeup();
+}
+
+Protocol::Reply Server::handle(const Protocol::Request& request) {
+  std::ostringstream printed;
+  Output output(printed);
+  Protocol::Reply reply;
+  try {
+    // the same names in any order are the same program
+    auto bindings = request.inputs;
+    std::sort(bindings.begin(), bindings.end());
+    std::vector<Symbol> names;
+    for (const auto& binding : bindings)
+      names.push_back(inputName(binding.first));
+
+    const uint64_t key = ProgramCache::key(request.script, names);
+    std::shared_ptr<const CompiledProgram> compiled =
+        programs.find(key, request.script, names);
+    if (!compiled)
+      compiled = programs.insert(key, compile(request.script, names));
+
+    const ProgramNode& program = *compiled->program;
+    Environment env = Interpreter::makeEnvironment(program);
+    env.output = &output;
+    for (size_t i = 0; i < bindings.size(); i++)
+      env.define(static_cast<int>(i),
+                 inputValue(bindings[i].first, bindings[i].second), true);
+    Memory::Scope memory(Memory::Eval);
+    if (options.run.mode == ExecutionMode::TreeWalk)
+      program.visit(env);
+    else
+      VM(compiled->bytecode).run(env);
+  } catch (const std::exception& e) {
+    reply.ok = false;
+    reply.error = e.what();
+  }
+  reply.output = printed.str();
+  return reply;
+}
+
+std::shared_ptr<const CompiledProgram> Server::compile(
+    const std::string& script, const std::vector<Symbol>& inputs) const {
+  auto compiled = std::make_shared<CompiledProgram>();
+  compiled->source = script;
+  compiled->inputs = inputs;
+  TokenStream tokens = Interpreter::lex(compiled->source);
+  compiled->program = Interpreter::parse(tokens);
+  ProgramNode& program = *compiled->program;
+  Resolver::resolve(program, Lexer::BUILT_IN_FUNCTIONS, inputs);
+  if (options.run.optimize) Interpreter::optimizer(options.run).run(program);
+  if (options.run.mode == ExecutionMode::Bytecode)
+    compiled->bytecode = Compiler::compile(program);
+  return compiled;
+}
+
+void Server::listen() {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof address.sun_path)
+    throw std::runtime_error("Socket path too long: " + path);
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+  const sockaddr* raw = reinterpret_cast<const sockaddr*>(&address);
+
+  // a socket nothing answers on is left over from a server that's gone
+  struct stat info;
+  if (::lstat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+    const int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    const bool live = probe >= 0 && ::connect(probe, raw, sizeof address) == 0;
+    if (probe >= 0) ::close(probe);
+    if (live) throw std::runtime_error("Already serving on " + path);
+    ::unlink(path.c_str());
+  }
+
+  if (::pipe2(wake, O_CLOEXEC | O_NONBLOCK) != 0)
+    throw systemError("Can't create a pipe");
+  // polled, accept() never waits
+  const int fd =
+      ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+  if (fd < 0) throw systemError("Can't create a socket");
+  if (::bind(fd, raw, sizeof address) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+    const std::runtime_error error = systemError("Can't listen on " + path);
+    ::close(fd);
+    throw error;
+  }
+  listener = fd;
+}
+
+void Server::work() {
+  for (;;) {
+    std::unique_lock<std::mutex> lock(mutex);
+    ready.wait(lock, [&] { return stopping || !pending.empty(); });
+    if (pending.empty()) return;
+    Protocol::Connection connection = std::move(pending.front());
+    pending.pop_front();
+    const int fd = connection.descriptor();
+    serving.insert(fd);
+    lock.unlock();
+    const bool open = serve(connection);
+    lock.lock();
+    // still locked when the connection closes fd, which may then be reused
+    serving.erase(fd);
+    if (!open || stopping) continue;
+    if (connection.buffered()) {
+      // the client sent its next request along with this one
+      pending.push_back(std::move(connection));
+      ready.notify_one();
+    } else {
+      idle.push_back(std::move(connection));
+      wakeup();
+    }
+  }
+}
+
+// answers one request, false if the connection should close
+bool Server::serve(Protocol::Connection& connection) {
+  try {
+    Protocol::Request request;
+    if (!connection.read(request)) return false;
+    connection.write(handle(request));
+    return true;
+  } catch (const std::exception& e) {
+    // a request that can't be read ends the connection, the client is told
+    // why if it's still there
+    Protocol::Reply reply;
+    reply.ok = false;
+    reply.error = e.what();
+    try {
+      connection.write(reply);
+    } catch (const std::exception&) {
+    }
+    return false;
+  }
+}
+
+// only async-signal-safe calls. a full pipe already wakes run()
+void Server::wakeup() {
+  const char byte = 0;
+  if (wake[1] >= 0 && ::write(wake[1], &byte, 1) < 0) {
+  }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "../Parser/Interpreter.h"
+#include "ProgramCache.h"
+#include "Protocol.h"
+
+struct ServeOptions {
+  RunOptions run;
+  size_t workers = 0;     // threads answering requests, 0 for one per core
+  size_t cacheSize = 64;  // programs kept compiled
+};
+
+/*
+palmtree --serve: runs scripts for clients on a unix domain socket (see
+Protocol). a script is lexed, parsed, resolved, optimized and compiled the
+first time it's asked for and kept in a ProgramCache, a request for one
+seen before only runs it.
+every request gets an environment of its own: its inputs are defined in the
+first slots (see Resolver::resolve) and what it prints goes into the reply.
+requests run on worker threads, a worker takes a connection for one request
+and gives it back: between requests run() polls it with the listener, so an
+open connection that sends nothing doesn't hold a worker. once a request
+starts, it and its reply have to move within IO_TIMEOUT seconds. map, filter
+and reduce still run on the shared thread pool.
+the cache is bounded, the SymbolTable isn't: every name a script uses is
+interned for the life of the process, even once the program is evicted or
+if the script doesn't parse. a server fed scripts with ever new names grows
+with them, the count is in the line printed when it stops.
+*/
+class Server {
+ public:
+  static constexpr int IO_TIMEOUT = 30;  // seconds
+
+  Server(std::string path, ServeOptions options);
+  ~Server();
+
+  Server(const Server&) = delete;
+  Server& operator=(const Server&) = delete;
+
+  // listens at the path until stop(), then lets the requests being run
+  // finish. a stale socket left at the path is replaced
+  void run();
+  // from any thread, or a signal handler
+  void stop();
+
+  // runs one request on the calling thread
+  Protocol::Reply handle(const Protocol::Request& request);
+
+  const ProgramCache& cache() const { return programs; }
+
+ private:
+  std::shared_ptr<const CompiledProgram> compile(
+      const std::string& script, const std::vector<Symbol>& inputs) const;
+  void listen();
+  void work();
+  bool serve(Protocol::Connection& connection);
+  void wakeup();
+
+  const std::string path;
+  const ServeOptions options;
+  ProgramCache programs;
+  int listener = -1;
+  std::atomic<bool> stopping{false};
+
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::deque<Protocol::Connection> pending;  // readable, waiting for a worker
+  std::vector<Protocol::Connection> idle;    // between requests, polled
+  std::unordered_set<int> serving;           // each being read by a worker
+  int wake[2] = {-1, -1};  // a byte written wakes run() to poll idle again
+};
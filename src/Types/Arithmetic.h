@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+
+/*
+arithmetic on raw ints and doubles with the semantics of Value's operators,
+for code that already knows its operand types (see TypeInference). ints wrap
+around at 32 bits.
+*/
+namespace Arithmetic {
+
+inline int add(int a, int b) {
+  return static_cast<int>(static_cast<uint32_t>(a) + static_cast<uint32_t>(b));
+}
+inline int subtract(int a, int b) {
+  return static_cast<int>(static_cast<uint32_t>(a) - static_cast<uint32_t>(b));
+}
+inline int multiply(int a, int b) {
+  return static_cast<int>(static_cast<uint32_t>(a) * static_cast<uint32_t>(b));
+}
+inline int divide(int a, int b) {
+  if (b == 0) throw std::runtime_error("Division by zero");
+  // INT_MIN / -1 overflows, and traps on x86
+  if (b == -1) return subtract(0, a);
+  return a / b;
+}
+
+inline double add(double a, double b) { return a + b; }
+inline double subtract(double a, double b) { return a - b; }
+inline double multiply(double a, double b) { return a * b; }
+inline double divide(double a, double b) {
+  if (b == 0) throw std::runtime_error("Division by zero");
+  return a / b;
+}
+
+// op is one of + - * /
+template <typename T>
+T apply(char op, T a, T b) {
+  switch (op) {
+    case '+':
+      return add(a, b);
+    case '-':
+      return subtract(a, b);
+    case '*':
+      return multiply(a, b);
+    case '/':
+      return divide(a, b);
+    default:
+      throw std::runtime_error("Unsupported operation");
+  }
+}
+
+}  // namespace Arithmetic
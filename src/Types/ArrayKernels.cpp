@@ -0,0 +1,284 @@
+#include "ArrayKernels.h"
+
+#include <algorithm>
+
+// the vector paths are compiled per function with target attributes, so the
+// rest of the binary doesn't depend on anything past the x86-64 baseline
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define PALM_X86_KERNELS
+#include <immintrin.h>
+#define PALM_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace {
+
+struct Add {
+  static double apply(double a, double b) { return a + b; }
+#ifdef PALM_X86_KERNELS
+  static __m128d apply(__m128d a, __m128d b) { return _mm_add_pd(a, b); }
+  PALM_AVX2 static __m256d apply(__m256d a, __m256d b) {
+    return _mm256_add_pd(a, b);
+  }
+#endif
+};
+
+struct Subtract {
+  static double apply(double a, double b) { return a - b; }
+#ifdef PALM_X86_KERNELS
+  static __m128d apply(__m128d a, __m128d b) { return _mm_sub_pd(a, b); }
+  PALM_AVX2 static __m256d apply(__m256d a, __m256d b) {
+    return _mm256_sub_pd(a, b);
+  }
+#endif
+};
+
+struct Multiply {
+  static double apply(double a, double b) { return a * b; }
+#ifdef PALM_X86_KERNELS
+  static __m128d apply(__m128d a, __m128d b) { return _mm_mul_pd(a, b); }
+  PALM_AVX2 static __m256d apply(__m256d a, __m256d b) {
+    return _mm256_mul_pd(a, b);
+  }
+#endif
+};
+
+struct Divide {
+  static double apply(double a, double b) { return a / b; }
+#ifdef PALM_X86_KERNELS
+  static __m128d apply(__m128d a, __m128d b) { return _mm_div_pd(a, b); }
+  PALM_AVX2 static __m256d apply(__m256d a, __m256d b) {
+    return _mm256_div_pd(a, b);
+  }
+#endif
+};
+
+//
+// scalar, also the tail of the vector loops
+//
+
+struct Scalar {
+  template <typename Op, Broadcast B>
+  static void binary(const double* a, const double* b, double* out,
+                     size_t n) {
+    for (size_t i = 0; i < n; i++)
+      out[i] = Op::apply(B == Broadcast::Left ? *a : a[i],
+                         B == Broadcast::Right ? *b : b[i]);
+  }
+
+  static double sum(const double* values, size_t n) {
+    double total = 0;
+    for (size_t i = 0; i < n; i++) total += values[i];
+    return total;
+  }
+
+  static double min(const double* values, size_t n) {
+    return *std::min_element(values, values + n);
+  }
+
+  static double max(const double* values, size_t n) {
+    return *std::max_element(values, values + n);
+  }
+
+  static double dot(const double* a, const double* b, size_t n) {
+    double total = 0;
+    for (size_t i = 0; i < n; i++) total += a[i] * b[i];
+    return total;
+  }
+};
+
+// the rest of a vector loop from element i on
+template <typename Op, Broadcast B>
+void binaryTail(const double* a, const double* b, double* out, size_t i,
+                size_t n) {
+  Scalar::binary<Op, B>(B == Broadcast::Left ? a : a + i,
+                        B == Broadcast::Right ? b : b + i, out + i, n - i);
+}
+
+#ifdef PALM_X86_KERNELS
+
+//
+// SSE2, two doubles at a time. always there on x86-64
+//
+
+struct Sse2 {
+  template <typename Op, Broadcast B>
+  static void binary(const double* a, const double* b, double* out,
+                     size_t n) {
+    const __m128d left = _mm_set1_pd(*a), right = _mm_set1_pd(*b);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+      const __m128d x = B == Broadcast::Left ? left : _mm_loadu_pd(a + i);
+      const __m128d y = B == Broadcast::Right ? right : _mm_loadu_pd(b + i);
+      _mm_storeu_pd(out + i, Op::apply(x, y));
+    }
+    binaryTail<Op, B>(a, b, out, i, n);
+  }
+
+  static double horizontalSum(__m128d v) {
+    return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+  }
+
+  static double sum(const double* values, size_t n) {
+    __m128d even = _mm_setzero_pd(), odd = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+      even = _mm_add_pd(even, _mm_loadu_pd(values + i));
+      odd = _mm_add_pd(odd, _mm_loadu_pd(values + i + 2));
+    }
+    return horizontalSum(_mm_add_pd(even, odd)) +
+           Scalar::sum(values + i, n - i);
+  }
+
+  static double min(const double* values, size_t n) {
+    if (n < 2) return Scalar::min(values, n);
+    __m128d best = _mm_loadu_pd(values);
+    size_t i = 2;
+    for (; i + 2 <= n; i += 2)
+      best = _mm_min_pd(best, _mm_loadu_pd(values + i));
+    const double lanes =
+        _mm_cvtsd_f64(_mm_min_sd(best, _mm_unpackhi_pd(best, best)));
+    return i < n ? std::min(lanes, values[i]) : lanes;
+  }
+
+  static double max(const double* values, size_t n) {
+    if (n < 2) return Scalar::max(values, n);
+    __m128d best = _mm_loadu_pd(values);
+    size_t i = 2;
+    for (; i + 2 <= n; i += 2)
+      best = _mm_max_pd(best, _mm_loadu_pd(values + i));
+    const double lanes =
+        _mm_cvtsd_f64(_mm_max_sd(best, _mm_unpackhi_pd(best, best)));
+    return i < n ? std::max(lanes, values[i]) : lanes;
+  }
+
+  static double dot(const double* a, const double* b, size_t n) {
+    __m128d total = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+      total = _mm_add_pd(
+          total, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    return horizontalSum(total) + Scalar::dot(a + i, b + i, n - i);
+  }
+};
+
+//
+// AVX2, four doubles at a time, two vectors per iteration where the loop is
+// bound by the adds rather than by memory
+//
+
+struct Avx2 {
+  template <typename Op, Broadcast B>
+  PALM_AVX2 static void binary(const double* a, const double* b, double* out,
+                               size_t n) {
+    const __m256d left = _mm256_set1_pd(*a), right = _mm256_set1_pd(*b);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+      const __m256d x = B == Broadcast::Left ? left : _mm256_loadu_pd(a + i);
+      const __m256d y =
+          B == Broadcast::Right ? right : _mm256_loadu_pd(b + i);
+      _mm256_storeu_pd(out + i, Op::apply(x, y));
+    }
+    binaryTail<Op, B>(a, b, out, i, n);
+  }
+
+  PALM_AVX2 static double horizontalSum(__m256d v) {
+    const __m128d half = _mm_add_pd(_mm256_castpd256_pd128(v),
+                                    _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+  }
+
+  PALM_AVX2 static double sum(const double* values, size_t n) {
+    __m256d first = _mm256_setzero_pd(), second = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+      first = _mm256_add_pd(first, _mm256_loadu_pd(values + i));
+      second = _mm256_add_pd(second, _mm256_loadu_pd(values + i + 4));
+    }
+    return horizontalSum(_mm256_add_pd(first, second)) +
+           Scalar::sum(values + i, n - i);
+  }
+
+  PALM_AVX2 static double min(const double* values, size_t n) {
+    if (n < 4) return Scalar::min(values, n);
+    __m256d best = _mm256_loadu_pd(values);
+    size_t i = 4;
+    for (; i + 4 <= n; i += 4)
+      best = _mm256_min_pd(best, _mm256_loadu_pd(values + i));
+    double lanes[4];
+    _mm256_storeu_pd(lanes, best);
+    const double rest = i < n ? Scalar::min(values + i, n - i) : lanes[0];
+    return std::min({lanes[0], lanes[1], lanes[2], lanes[3], rest});
+  }
+
+  PALM_AVX2 static double max(const double* values, size_t n) {
+    if (n < 4) return Scalar::max(values, n);
+    __m256d best = _mm256_loadu_pd(values);
+    size_t i = 4;
+    for (; i + 4 <= n; i += 4)
+      best = _mm256_max_pd(best, _mm256_loadu_pd(values + i));
+    double lanes[4];
+    _mm256_storeu_pd(lanes, best);
+    const double rest = i < n ? Scalar::max(values + i, n - i) : lanes[0];
+    return std::max({lanes[0], lanes[1], lanes[2], lanes[3], rest});
+  }
+
+  PALM_AVX2 static double dot(const double* a, const double* b, size_t n) {
+    __m256d first = _mm256_setzero_pd(), second = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+      first = _mm256_add_pd(first, _mm256_mul_pd(_mm256_loadu_pd(a + i),
+                                                 _mm256_loadu_pd(b + i)));
+      second = _mm256_add_pd(
+          second,
+          _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+    }
+    return horizontalSum(_mm256_add_pd(first, second)) +
+           Scalar::dot(a + i, b + i, n - i);
+  }
+};
+
+#endif
+
+template <typename Isa, typename Op>
+void fillRow(BinaryKernel (&row)[static_cast<size_t>(Broadcast::Count)]) {
+  row[static_cast<size_t>(Broadcast::None)] =
+      &Isa::template binary<Op, Broadcast::None>;
+  row[static_cast<size_t>(Broadcast::Left)] =
+      &Isa::template binary<Op, Broadcast::Left>;
+  row[static_cast<size_t>(Broadcast::Right)] =
+      &Isa::template binary<Op, Broadcast::Right>;
+}
+
+template <typename Isa>
+ArrayKernels makeKernels(const char* name) {
+  ArrayKernels kernels{};
+  kernels.name = name;
+  fillRow<Isa, Add>(kernels.binary[static_cast<size_t>(ArrayOp::Add)]);
+  fillRow<Isa, Subtract>(
+      kernels.binary[static_cast<size_t>(ArrayOp::Subtract)]);
+  fillRow<Isa, Multiply>(
+      kernels.binary[static_cast<size_t>(ArrayOp::Multiply)]);
+  fillRow<Isa, Divide>(kernels.binary[static_cast<size_t>(ArrayOp::Divide)]);
+  kernels.sum = &Isa::sum;
+  kernels.min = &Isa::min;
+  kernels.max = &Isa::max;
+  kernels.dot = &Isa::dot;
+  return kernels;
+}
+
+ArrayKernels detectKernels() {
+#ifdef PALM_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return makeKernels<Avx2>("avx2");
+  return makeKernels<Sse2>("sse2");
+#else
+  return makeKernels<Scalar>("scalar");
+#endif
+}
+
+}  // namespace
+
+const ArrayKernels& arrayKernels() {
+  static const ArrayKernels kernels = detectKernels();
+  return kernels;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+enum class ArrayOp : uint8_t { Add, Subtract, Multiply, Divide, Count };
+
+// which side of an element-wise operation is a single value applied to
+// every element of the other
+enum class Broadcast : uint8_t { None, Left, Right, Count };
+
+// out[i] = a[i] op b[i], with a or b read as one value when broadcast
+using BinaryKernel = void (*)(const double* a, const double* b, double* out,
+                              size_t n);
+using ReduceKernel = double (*)(const double* values, size_t n);
+using DotKernel = double (*)(const double* a, const double* b, size_t n);
+
+/*
+the element-wise and reduction loops behind array values, one set per
+instruction set. reductions keep several partial results, so their rounding
+can differ from a left to right loop in the last bits.
+*/
+struct ArrayKernels {
+  const char* name;  // "avx2", "sse2" or "scalar"
+  BinaryKernel binary[static_cast<size_t>(ArrayOp::Count)]
+                     [static_cast<size_t>(Broadcast::Count)];
+  ReduceKernel sum;
+  ReduceKernel min;  // n has to be at least 1 for min and max
+  ReduceKernel max;
+  DotKernel dot;
+};
+
+// the widest set this CPU supports, picked on first use
+const ArrayKernels& arrayKernels();
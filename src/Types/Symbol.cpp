@@ -0,0 +1,42 @@
+#include "Symbol.h"
+
+#include <mutex>
+#include <stdexcept>
+
+SymbolTable& SymbolTable::global() {
+  static SymbolTable table;
+  return table;
+}
+
+SymbolTable::SymbolTable() {
+  // must match the order of the Symbols enum
+  for (const char* name : {"let", "mut", "memo", "|>", "=>", ",", ";", "(",
+                           ")", "[", "]", "%", "+", "-", "/", "*", "="})
+    intern(name);
+}
+
+Symbol SymbolTable::intern(std::string_view name) {
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto it = ids.find(name);
+    if (it != ids.end()) return it->second;
+  }
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  auto it = ids.find(name);
+  if (it != ids.end()) return it->second;
+  const Symbol symbol = static_cast<Symbol>(names.size());
+  names.emplace_back(name);
+  ids.emplace(names.back(), symbol);
+  return symbol;
+}
+
+const std::string& SymbolTable::name(Symbol symbol) const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  if (symbol >= names.size()) throw std::runtime_error("Unknown symbol");
+  return names[symbol];
+}
+
+size_t SymbolTable::size() const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  return names.size();
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// an interned identifier, keyword or punctuator
+using Symbol = uint32_t;
+
+constexpr Symbol NO_SYMBOL = std::numeric_limits<Symbol>::max();
+
+// interned up front in this order, so the lexer and parser can compare
+// against them without a lookup
+namespace Symbols {
+enum : Symbol {
+  Let,
+  Mut,
+  Memo,
+  Pipe,
+  Arrow,
+  Comma,
+  Semicolon,
+  LeftParen,
+  RightParen,
+  LeftBracket,
+  RightBracket,
+  Percent,
+  Plus,
+  Minus,
+  Slash,
+  Star,
+  Equals,
+  Count
+};
+}  // namespace Symbols
+
+/*
+process-wide string <-> id table shared by the lexer, parser and runtime.
+ids are never released, so they stay valid across programs (and threads).
+*/
+class SymbolTable {
+ public:
+  static SymbolTable& global();
+
+  Symbol intern(std::string_view name);
+  const std::string& name(Symbol symbol) const;
+  size_t size() const;
+
+ private:
+  SymbolTable();
+
+  mutable std::shared_mutex mutex;
+  std::deque<std::string> names;  // deque, so the map's keys never move
+  std::unordered_map<std::string_view, Symbol> ids;
+};
+
+inline Symbol intern(std::string_view name) {
+  return SymbolTable::global().intern(name);
+}
+
+inline const std::string& symbolName(Symbol symbol) {
+  return SymbolTable::global().name(symbol);
+}
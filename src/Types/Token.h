@@ -1,9 +1,14 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <vector>
 
-enum class TokenType { 
+#include "Symbol.h"
+#include "../Runtime/Memory.h"
+
+enum class TokenType : uint8_t { 
 	Keyword, Identifier, Operator, Delimiter, EndOfFile,
 
 	Int, Double, String,
@@ -11,12 +16,14 @@ enum class TokenType {
 	LetKeyword, MutableKeyword
 };
 
+// a view of one token, its value points into the source it was lexed from
 struct Token {
 	TokenType type;
-	std::string value;
+	std::string_view value;
 	int position;
+	Symbol symbol = NO_SYMBOL;
 
-	std::string tokenTypeToString(const TokenType type_m) const {
+	static std::string tokenTypeToString(const TokenType type_m) {
 		switch (type_m) {
 		case TokenType::MutableKeyword:
 			return "Keyword";
@@ -42,6 +49,50 @@ struct Token {
 	}
 
 	std::string to_string() const {
-		return "{type: \"" + tokenTypeToString(type) + "\", value: \"" + value + "\"},";
+		const std::string_view text = type == TokenType::EndOfFile ? "EOF" : value;
+		return "{type: \"" + tokenTypeToString(type) + "\", value: \"" + std::string(text) + "\"},";
+	}
+};
+
+/*
+the lexer's output, stored column-wise: a type byte, a source offset, a
+length and the interned symbol (for identifiers, keywords and punctuators)
+per token. nothing is copied out of the source, so it has to outlive the
+stream.
+*/
+class TokenStream {
+public:
+	explicit TokenStream(std::string_view source) : source(source) {
+		// roughly one token every four characters in typical scripts
+		types.reserve(source.size() / 4 + 1);
+		offsets.reserve(source.size() / 4 + 1);
+		lengths.reserve(source.size() / 4 + 1);
+		symbols.reserve(source.size() / 4 + 1);
+	}
+
+	void push(TokenType type, size_t offset, size_t length, Symbol symbol = NO_SYMBOL) {
+		types.push_back(static_cast<uint8_t>(type));
+		offsets.push_back(static_cast<uint32_t>(offset));
+		lengths.push_back(static_cast<uint32_t>(length));
+		symbols.push_back(symbol);
 	}
-};
\ No newline at end of file
+
+	size_t size() const { return types.size(); }
+	TokenType type(size_t i) const { return static_cast<TokenType>(types[i]); }
+	std::string_view value(size_t i) const { return source.substr(offsets[i], lengths[i]); }
+	int position(size_t i) const { return static_cast<int>(offsets[i]); }
+	Symbol symbol(size_t i) const { return symbols[i]; }
+	Token operator[](size_t i) const { return {type(i), value(i), position(i), symbol(i)}; }
+
+	std::string_view getSource() const { return source; }
+
+private:
+	template <typename T>
+	using Column = std::vector<T, CountedAllocator<T, Memory::Tokens>>;
+
+	std::string_view source;
+	Column<uint8_t> types;
+	Column<uint32_t> offsets;
+	Column<uint32_t> lengths;
+	Column<Symbol> symbols;
+};
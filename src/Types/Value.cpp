@@ -1,5 +1,11 @@
 #include "Value.h"
 
+#include <cmath>
+#include <limits>
+
+#include "ArrayKernels.h"
+#include "Arithmetic.h"
+
 int Value::decimalCount() const {
   if (!isDouble()) throw std::runtime_error("Invalid Value Type!");
   std::string str = to_string();
@@ -31,15 +37,114 @@ std::string Value::to_string() const {
     return asBool() ? "true" : "false";  // probably not great
   else if (isString())
     return asString();
+  else if (isArray()) {
+    const ArrayObject& array = asArray();
+    std::string str = "[";
+    for (size_t i = 0; i < array.size; i++) {
+      if (i > 0) str += ", ";
+      // the same digits print shows for a single number
+      std::string element = number(array.values[i], array.integral).to_string();
+      if (element.find('.') != std::string::npos) {
+        element.erase(element.find_last_not_of('0') + 1);
+        if (element.back() == '.') element.pop_back();
+      }
+      str += element;
+    }
+    return str + "]";
+  } else if (isStream())
+    return "<stream>";  // printing one would have to run it
   return "Unmarked Type";
 }
 
+//
+// Arrays
+//
+
+Value Value::array(const Value* elements, size_t count) {
+  bool integral = true;
+  for (size_t i = 0; i < count; i++) {
+    if (!elements[i].isNumeric())
+      throw std::runtime_error("Array elements must be numeric");
+    integral = integral && elements[i].isInt();
+  }
+  auto array = new ArrayObject(count, integral);
+  for (size_t i = 0; i < count; i++)
+    array->values[i] = elements[i].isInt() ? elements[i].asInt()
+                                           : elements[i].asDouble();
+  return Value(array);
+}
+
+Value Value::number(double v, bool integral) {
+  if (integral && v >= std::numeric_limits<int>::min() &&
+      v <= std::numeric_limits<int>::max())
+    return Value(static_cast<int>(v));
+  return Value(v);
+}
+
+Value Value::operator[](const Value& index) const {
+  const ArrayObject& array = asArray();
+  if (!index.isInt()) throw std::runtime_error("Array index must be an int");
+  const int i = index.asInt();
+  if (i < 0 || static_cast<size_t>(i) >= array.size)
+    throw std::runtime_error("Array index out of range");
+  return number(array.values[i], array.integral);
+}
+
+// element-wise, a number on either side is applied to every element
+static Value arrayArithmetic(const Value& left, ArrayOp op, const Value& right,
+                             const char* name) {
+  if (!(left.isArray() || left.isNumeric()) ||
+      !(right.isArray() || right.isNumeric()))
+    throw std::runtime_error(std::string("Unsupported types for ") + name);
+
+  const size_t size =
+      left.isArray() ? left.asArray().size : right.asArray().size;
+  if (left.isArray() && right.isArray() && right.asArray().size != size)
+    throw std::runtime_error("Array length mismatch");
+
+  bool integral = true;
+  double leftNumber = 0, rightNumber = 0;
+  auto operand = [&](const Value& value, double& number) -> const double* {
+    if (value.isArray()) {
+      integral = integral && value.asArray().integral;
+      return value.asArray().values.get();
+    }
+    integral = integral && value.isInt();
+    number = value.isInt() ? value.asInt() : value.asDouble();
+    return &number;
+  };
+  const double* a = operand(left, leftNumber);
+  const double* b = operand(right, rightNumber);
+
+  if (op == ArrayOp::Divide) {
+    const size_t count = right.isArray() ? size : 1;
+    for (size_t i = 0; i < count; i++)
+      if (b[i] == 0) throw std::runtime_error("Division by zero");
+  }
+
+  const Broadcast broadcast = !left.isArray()    ? Broadcast::Left
+                              : !right.isArray() ? Broadcast::Right
+                                                 : Broadcast::None;
+  auto result = new ArrayObject(size, integral);
+  arrayKernels().binary[static_cast<size_t>(op)]
+                       [static_cast<size_t>(broadcast)](
+                           a, b, result->values.get(), size);
+  // matches int division on a single value
+  if (integral && op == ArrayOp::Divide)
+    for (size_t i = 0; i < size; i++)
+      result->values[i] = std::trunc(result->values[i]);
+  return Value(result);
+}
+
 //
 // Operator overloads
 //
 
 Value Value::operator+(const Value& other) const {
-  if (isInt() && other.isInt()) return Value(asInt() + other.asInt());
+  if (isArray() || other.isArray())
+    return arrayArithmetic(*this, ArrayOp::Add, other, "addition");
+  if (isInt() && other.isInt())
+    return Value(Arithmetic::add(asInt(), other.asInt()));
   if (isDouble() && other.isDouble())
     return Value(asDouble() + other.asDouble());
   if (isInt() && other.isDouble()) return Value(asInt() + other.asDouble());
@@ -47,7 +152,10 @@ Value Value::operator+(const Value& other) const {
   throw std::runtime_error("Unsupported types for addition");
 }
 Value Value::operator-(const Value& other) const {
-  if (isInt() && other.isInt()) return Value(asInt() - other.asInt());
+  if (isArray() || other.isArray())
+    return arrayArithmetic(*this, ArrayOp::Subtract, other, "subtraction");
+  if (isInt() && other.isInt())
+    return Value(Arithmetic::subtract(asInt(), other.asInt()));
   if (isDouble() && other.isDouble())
     return Value(asDouble() - other.asDouble());
   if (isInt() && other.isDouble()) return Value(asInt() - other.asDouble());
@@ -55,7 +163,10 @@ Value Value::operator-(const Value& other) const {
   throw std::runtime_error("Unsupported types for subtraction");
 }
 Value Value::operator*(const Value& other) const {
-  if (isInt() && other.isInt()) return Value(asInt() * other.asInt());
+  if (isArray() || other.isArray())
+    return arrayArithmetic(*this, ArrayOp::Multiply, other, "multiplication");
+  if (isInt() && other.isInt())
+    return Value(Arithmetic::multiply(asInt(), other.asInt()));
   if (isDouble() && other.isDouble())
     return Value(asDouble() * other.asDouble());
   if (isInt() && other.isDouble()) return Value(asInt() * other.asDouble());
@@ -63,7 +174,10 @@ Value Value::operator*(const Value& other) const {
   throw std::runtime_error("Unsupported types for multiplication");
 }
 Value Value::operator/(const Value& other) const {
-  if (isInt() && other.isInt()) return Value(asInt() / other.asInt());
+  if (isArray() || other.isArray())
+    return arrayArithmetic(*this, ArrayOp::Divide, other, "division");
+  if (isInt() && other.isInt())
+    return Value(Arithmetic::divide(asInt(), other.asInt()));
   if (isDouble() && other.isDouble())
     return Value(asDouble() / other.asDouble());
   if (isInt() && other.isDouble()) return Value(asInt() / other.asDouble());
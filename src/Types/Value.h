@@ -1,36 +1,136 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <cstring>
 #include <memory>
-#include <optional>
 #include <stdexcept>
 #include <string>
-#include <unordered_map>
-#include <variant>
-#include <vector>
+
+#include "../Runtime/Memory.h"
 
 class LambdaNode;
+struct StreamObject;
+
+// reference counted payloads for the kinds that don't fit in a Value
+struct HeapObject {
+  enum class Kind : uint8_t { String, Lambda, Array, Stream };
+
+  std::atomic<uint32_t> refs{1};
+  const Kind kind;
+
+  explicit HeapObject(Kind kind) : kind(kind) {}
+  virtual ~HeapObject() = default;
+
+  // counted for Memory, the destructor being virtual gives delete the size
+  // of the whole object
+  static void* operator new(size_t size) {
+    Memory::allocated(Memory::Values, size);
+    return ::operator new(size);
+  }
+  static void operator delete(void* object, size_t size) {
+    Memory::freed(Memory::Values, size);
+    ::operator delete(object);
+  }
+};
+
+struct StringObject : HeapObject {
+  std::string value;
+  explicit StringObject(std::string value)
+      : HeapObject(Kind::String), value(std::move(value)) {
+    if (const size_t bytes = buffer()) Memory::allocated(Memory::Values, bytes);
+  }
+  ~StringObject() override {
+    if (const size_t bytes = buffer()) Memory::freed(Memory::Values, bytes);
+  }
+
+  // the characters' own allocation, none when they fit in the string
+  size_t buffer() const {
+    return value.capacity() > std::string().capacity() ? value.capacity() + 1
+                                                       : 0;
+  }
+};
+
+struct LambdaObject : HeapObject {
+  std::shared_ptr<const LambdaNode> lambda;  // keeps the node's arena alive
+  explicit LambdaObject(std::shared_ptr<const LambdaNode> lambda)
+      : HeapObject(Kind::Lambda), lambda(std::move(lambda)) {}
+};
+
+// arrays hold doubles, integral when every element came from an int. they
+// are never changed once built, so values can share one
+struct ArrayObject : HeapObject {
+  const size_t size;
+  const bool integral;
+  const std::unique_ptr<double[]> values;  // left uninitialized for the kernels
+
+  ArrayObject(size_t size, bool integral)
+      : HeapObject(Kind::Array),
+        size(size),
+        integral(integral),
+        values(new double[size]) {
+    Memory::allocated(Memory::Values, size * sizeof(double));
+  }
+  ~ArrayObject() override {
+    Memory::freed(Memory::Values, size * sizeof(double));
+  }
+};
+
+/*
+a NaN-boxed 64 bit value. doubles are stored as themselves, everything else
+lives in the payload of a quiet NaN:
+
+  ints      QNAN | TAG_INT  | 32 bit int
+  null      QNAN | TAG_NULL
+  bools     QNAN | TAG_BOOL | 0 or 1
+  objects   SIGN | QNAN     | 48 bit HeapObject pointer
 
+real NaNs are canonicalized on the way in so they can't collide with a tag.
+*/
 class Value {
  public:
-  using VariantType = std::variant<std::monostate, int, double, std::string,
-                                   bool, std::shared_ptr<const LambdaNode>>;
+  Value() : bits(NULL_BITS) {}
+  Value(int v, bool negative = false)
+      : bits(INT_BITS | static_cast<uint32_t>(negative ? -v : v)) {}
+  Value(double v, bool negative = false) : bits(fromDouble(negative ? -v : v)) {}
+  Value(const std::string& v) : bits(fromObject(new StringObject(v))) {}
+  Value(bool v) : bits(v ? TRUE_BITS : FALSE_BITS) {}
+  Value(std::shared_ptr<const LambdaNode> v)
+      : bits(v ? fromObject(new LambdaObject(std::move(v))) : NULL_BITS) {}
+  explicit Value(ArrayObject* v) : bits(fromObject(v)) {}  // takes ownership
+  explicit Value(StreamObject* v);  // same, see Runtime/Stream.cpp
 
- public:
-  Value() : mut(false) {}
-  Value(int v, bool negative = false) : value(negative ? -v : v), mut(false) {}
-  Value(double v, bool negative = false)
-      : value(negative ? -v : v), mut(false) {}
-  Value(const std::string& v) : value(v), mut(false) {}
-  Value(bool v) : value(v), mut(false) {}
-  Value(std::shared_ptr<const LambdaNode> v) : value(v), mut(false) {}
+  // an array of count numeric values
+  static Value array(const Value* elements, size_t count);
+  // an array element or reduction, an int where it can be one
+  static Value number(double v, bool integral);
 
-  const VariantType& get() const { return value; }
+  Value(const Value& other) : bits(other.bits) { retain(); }
+  Value(Value&& other) noexcept : bits(other.bits) { other.bits = NULL_BITS; }
+  Value& operator=(const Value& other) {
+    if (bits != other.bits) {
+      other.retain();
+      release();
+      bits = other.bits;
+    }
+    return *this;
+  }
+  Value& operator=(Value&& other) noexcept {
+    if (this != &other) {
+      release();
+      bits = other.bits;
+      other.bits = NULL_BITS;
+    }
+    return *this;
+  }
+  ~Value() { release(); }
 
  public:
   Value operator+(const Value& other) const;
   Value operator-(const Value& other) const;
   Value operator*(const Value& other) const;
   Value operator/(const Value& other) const;
+  Value operator[](const Value& index) const;
 
  public:
   bool operator==(const Value& other) const;
@@ -41,32 +141,89 @@ class Value {
   bool operator!=(const int other) const;
 
  public:
-  int asInt() const { return std::get<int>(value); }
-  double asDouble() const { return std::get<double>(value); }
-  std::string asString() const { return std::get<std::string>(value); }
-  bool asBool() const { return std::get<bool>(value); }
-  std::shared_ptr<const LambdaNode> asLambda() const {
-    return std::get<std::shared_ptr<const LambdaNode>>(value);
+  int asInt() const {
+    if (!isInt()) throw std::runtime_error("Value is not an int");
+    return static_cast<int32_t>(static_cast<uint32_t>(bits));
   }
-
-  bool isNumeric() const { return isInt() || isDouble(); }
-  bool isInt() const { return std::holds_alternative<int>(value); }
-  bool isDouble() const { return std::holds_alternative<double>(value); }
-  bool isString() const { return std::holds_alternative<std::string>(value); }
-  bool isBool() const { return std::holds_alternative<bool>(value); }
-  bool isNull() const { return std::holds_alternative<std::monostate>(value); }
-
-  bool isLambda() const {
-    return std::holds_alternative<std::shared_ptr<const LambdaNode>>(value);
+  double asDouble() const {
+    if (!isDouble()) throw std::runtime_error("Value is not a double");
+    double d;
+    std::memcpy(&d, &bits, sizeof d);
+    return d;
   }
+  const std::string& asString() const {
+    if (!isString()) throw std::runtime_error("Value is not a string");
+    return static_cast<const StringObject*>(object())->value;
+  }
+  bool asBool() const {
+    if (!isBool()) throw std::runtime_error("Value is not a bool");
+    return bits == TRUE_BITS;
+  }
+  const std::shared_ptr<const LambdaNode>& asLambda() const {
+    if (!isLambda()) throw std::runtime_error("Value is not a lambda");
+    return static_cast<const LambdaObject*>(object())->lambda;
+  }
+  const ArrayObject& asArray() const {
+    if (!isArray()) throw std::runtime_error("Value is not an array");
+    return *static_cast<const ArrayObject*>(object());
+  }
+  const StreamObject& asStream() const;
 
-  void setMutable(const bool mut) { this->mut = mut; }
-  bool isMutable() const { return mut; }
+  bool isNumeric() const { return isInt() || isDouble(); }
+  bool isInt() const { return (bits & TAG_MASK) == INT_BITS; }
+  bool isDouble() const { return (bits & QNAN) != QNAN; }
+  bool isString() const { return isObject(HeapObject::Kind::String); }
+  bool isBool() const { return (bits & ~uint64_t(1)) == FALSE_BITS; }
+  bool isNull() const { return bits == NULL_BITS; }
+  bool isLambda() const { return isObject(HeapObject::Kind::Lambda); }
+  bool isArray() const { return isObject(HeapObject::Kind::Array); }
+  bool isStream() const { return isObject(HeapObject::Kind::Stream); }
 
   int decimalCount() const;
   std::string to_string() const;
 
+  // equal for the same number or the same object, for hashing
+  uint64_t identity() const { return bits; }
+
  private:
-  VariantType value;
-  bool mut;
+  static constexpr uint64_t SIGN = 0x8000000000000000;
+  static constexpr uint64_t QNAN = 0x7ffc000000000000;
+  static constexpr uint64_t CANONICAL_NAN = 0x7ff8000000000000;
+  static constexpr uint64_t TAG_MASK = SIGN | QNAN | (uint64_t(3) << 48);
+  static constexpr uint64_t INT_BITS = QNAN | (uint64_t(1) << 48);
+  static constexpr uint64_t NULL_BITS = QNAN | (uint64_t(2) << 48);
+  static constexpr uint64_t FALSE_BITS = QNAN | (uint64_t(3) << 48);
+  static constexpr uint64_t TRUE_BITS = FALSE_BITS | 1;
+  static constexpr uint64_t POINTER_MASK = 0x0000ffffffffffff;
+
+  static uint64_t fromDouble(double d) {
+    if (d != d) return CANONICAL_NAN;
+    uint64_t b;
+    std::memcpy(&b, &d, sizeof b);
+    return b;
+  }
+  static uint64_t fromObject(HeapObject* object) {
+    return SIGN | QNAN | reinterpret_cast<uintptr_t>(object);
+  }
+
+  bool isHeap() const { return (bits & (SIGN | QNAN)) == (SIGN | QNAN); }
+  bool isObject(HeapObject::Kind kind) const {
+    return isHeap() && object()->kind == kind;
+  }
+  HeapObject* object() const {
+    return reinterpret_cast<HeapObject*>(bits & POINTER_MASK);
+  }
+
+  void retain() const {
+    if (isHeap()) object()->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+  void release() {
+    if (isHeap() &&
+        object()->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      delete object();
+  }
+
+  uint64_t bits;
 };
+
+static_assert(sizeof(Value) == 8, "Value is expected to be NaN-boxed");
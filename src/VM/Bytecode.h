@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../Parser/Environment.h"
+
+class LambdaNode;
+
+// every opcode the VM understands, in dispatch-table order
+#define PALM_OPCODES(X)                                                     \
+  X(Constant)     /* push the function's constants[operand] */              \
+  X(Null)         /* push an empty value */                                 \
+  X(LoadGlobal)   /* push globals[operand] */                               \
+  X(LoadLocal)    /* push local operand (argument or temporary) */          \
+  X(DefineGlobal) /* pop into globals[operand], argc holds mutability */    \
+  X(AssignGlobal) /* pop into globals[operand] */                           \
+  X(Add)                                                                    \
+  X(Subtract)                                                               \
+  X(Multiply)                                                               \
+  X(Divide)                                                                 \
+  X(AddInt)       /* the same on operands TypeInference proved ints */     \
+  X(SubtractInt)                                                            \
+  X(MultiplyInt)                                                            \
+  X(DivideInt)                                                              \
+  X(AddDouble)    /* or doubles */                                          \
+  X(SubtractDouble)                                                         \
+  X(MultiplyDouble)                                                         \
+  X(DivideDouble)                                                           \
+  X(IntToDouble)                                                            \
+  X(Negate)                                                                 \
+  X(UnaryPlus)    /* only checks that the operand is numeric */             \
+  X(MakeArray)    /* pop operand values into a new array */                 \
+  X(Index)        /* pop an index and an array, push the element */         \
+  X(CallBuiltIn)  /* call Environment::builtIns[operand] with argc values */ \
+  X(Call)         /* call the lambda held in globals[operand] */            \
+  X(CallLocal)    /* call the lambda held in argument operand */            \
+  X(Pop)                                                                    \
+  X(Slide)        /* drop operand values from under the top one */          \
+  X(Return)
+
+enum class OpCode : uint8_t {
+#define PALM_OPCODE_ENUM(name) name,
+  PALM_OPCODES(PALM_OPCODE_ENUM)
+#undef PALM_OPCODE_ENUM
+};
+
+const char* opCodeName(OpCode op);
+
+// 8 bytes per instruction, the operand indexes one of the program's pools
+struct Instruction {
+  OpCode op;
+  uint8_t argc;
+  uint32_t operand;
+};
+
+struct Function {
+  Symbol name = NO_SYMBOL;  // NO_SYMBOL for the top-level script
+  std::vector<Instruction> code;
+  std::vector<Value> constants;
+  const LambdaNode* lambda = nullptr;  // nullptr for the top-level script
+  // the source offsets of the calls, by index into code, for the profiler
+  std::unordered_map<uint32_t, int> positions;
+};
+
+// the linear form of a ProgramNode, functions[0] is the script itself
+struct BytecodeProgram {
+  std::vector<Function> functions;
+  std::vector<Symbol> names;         // ProgramNode::globals
+  std::vector<Symbol> builtInNames;  // ProgramNode::builtIns
+  std::unordered_map<const LambdaNode*, uint32_t> lambdaFunctions;
+
+  std::string to_string() const;  // disassembly for debugging
+};
@@ -0,0 +1,186 @@
+#include "Compiler.h"
+
+#include <limits>
+#include <stdexcept>
+
+BytecodeProgram Compiler::compile(const ProgramNode& program) {
+  if (!program.resolved)
+    throw std::runtime_error("Program must be resolved before compiling");
+  BytecodeProgram bytecode;
+  bytecode.names = program.globals;
+  bytecode.builtInNames = program.builtIns;
+  Compiler compiler(bytecode, program);
+
+  // reserve slot 0 for the script so lambdas compiled on the way land after it
+  bytecode.functions.emplace_back();
+  Function script;
+  for (const ASTNode* stmt : program.statements)
+    compiler.compileStatement(*stmt, script);
+  emit(script, OpCode::Null);
+  emit(script, OpCode::Return);
+  bytecode.functions[0] = std::move(script);
+  return bytecode;
+}
+
+Function Compiler::compileScript(const ASTNode& node) {
+  // pick up whatever the Resolver has bound since the last statement
+  program.names.insert(program.names.end(),
+                       source.globals.begin() + program.names.size(),
+                       source.globals.end());
+  program.builtInNames.insert(
+      program.builtInNames.end(),
+      source.builtIns.begin() + program.builtInNames.size(),
+      source.builtIns.end());
+
+  Function script;
+  compileStatement(node, script);
+  emit(script, OpCode::Null);
+  emit(script, OpCode::Return);
+  return script;
+}
+
+void Compiler::compileStatement(const ASTNode& node, Function& function) {
+  if (auto decl = node.as<VariableDeclarationNode>()) {
+    if (decl->lambdaExpr.has_value())
+      compileExpression(**decl->lambdaExpr, function);
+    else if (decl->expression.has_value())
+      compileExpression(**decl->expression, function);
+    else
+      emit(function, OpCode::Null);
+    emit(function, OpCode::DefineGlobal, decl->slot, decl->mut ? 1 : 0);
+  } else if (auto assign = node.as<AssignmentNode>()) {
+    compileExpression(*assign->expression, function);
+    emit(function, OpCode::AssignGlobal, assign->slot);
+  } else if (node.as<FunctionCallNode>() || node.as<PipelineNode>() ||
+             node.as<LocalBindingNode>()) {
+    compileExpression(static_cast<const ExpressionNode&>(node), function);
+    emit(function, OpCode::Pop);
+  }
+  // any other expression statement is a no-op, same as its visit()
+}
+
+void Compiler::compileExpression(const ExpressionNode& node,
+                                 Function& function) {
+  if (auto number = node.as<NumberNode>()) {
+    emit(function, OpCode::Constant, constant(function, number->value));
+  } else if (auto variable = node.as<VariableNode>()) {
+    if (variable->local >= 0)
+      emit(function, OpCode::LoadLocal, variable->local);
+    else
+      emit(function, OpCode::LoadGlobal, variable->slot);
+  } else if (auto binary = node.as<BinaryOperationNode>()) {
+    compileExpression(*binary->left, function);
+    compileExpression(*binary->right, function);
+    switch (binary->operation) {
+      case '+':
+        emit(function, OpCode::Add);
+        break;
+      case '-':
+        emit(function, OpCode::Subtract);
+        break;
+      case '*':
+        emit(function, OpCode::Multiply);
+        break;
+      case '/':
+        emit(function, OpCode::Divide);
+        break;
+      default:
+        throw std::runtime_error("Unsupported operation");
+    }
+  } else if (auto typed = node.as<IntArithmeticNode>()) {
+    compileExpression(*typed->left, function);
+    compileExpression(*typed->right, function);
+    emit(function, typedOp(typed->operation, OpCode::AddInt));
+  } else if (auto typed = node.as<DoubleArithmeticNode>()) {
+    compileExpression(*typed->left, function);
+    compileExpression(*typed->right, function);
+    emit(function, typedOp(typed->operation, OpCode::AddDouble));
+  } else if (auto conversion = node.as<IntToDoubleNode>()) {
+    compileExpression(*conversion->operand, function);
+    emit(function, OpCode::IntToDouble);
+  } else if (auto unary = node.as<UnaryOperationNode>()) {
+    compileExpression(*unary->operand, function);
+    emit(function, unary->op == '-' ? OpCode::Negate : OpCode::UnaryPlus);
+  } else if (auto call = node.as<FunctionCallNode>()) {
+    compileCall(*call, function);
+  } else if (auto pipeline = node.as<PipelineNode>()) {
+    // each stage's result stays on the stack as the next one's first argument
+    compileExpression(*pipeline->source, function);
+    for (const FunctionCallNode* stage : pipeline->stages)
+      compileCall(*stage, function);
+  } else if (auto array = node.as<ArrayNode>()) {
+    for (const ExpressionNode* element : array->elements)
+      compileExpression(*element, function);
+    emit(function, OpCode::MakeArray,
+         static_cast<uint32_t>(array->elements.size()));
+  } else if (auto index = node.as<IndexNode>()) {
+    compileExpression(*index->array, function);
+    compileExpression(*index->index, function);
+    emit(function, OpCode::Index);
+  } else if (auto binding = node.as<LocalBindingNode>()) {
+    // the value lands in the frame's next slot, which is binding->local
+    compileExpression(*binding->value, function);
+    compileExpression(*binding->body, function);
+    emit(function, OpCode::Slide, 1);
+  } else if (auto lambda = node.as<LambdaNode>()) {
+    compileLambda(*lambda);
+    emit(function, OpCode::Constant,
+         constant(function, Value(lambda->self.lock())));
+  } else {
+    throw std::runtime_error("Cannot compile expression: " + node.to_string());
+  }
+}
+
+// a piped call finds its first argument on the stack already
+void Compiler::compileCall(const FunctionCallNode& call, Function& function) {
+  if (call.argumentCount() > std::numeric_limits<uint8_t>::max())
+    throw std::runtime_error("Too many arguments in call to " +
+                             symbolName(call.functionName));
+  for (const ExpressionNode* arg : call.arguments)
+    compileExpression(*arg, function);
+  const uint8_t argc = static_cast<uint8_t>(call.argumentCount());
+  if (call.builtIn >= 0)
+    emit(function, OpCode::CallBuiltIn, call.builtIn, argc);
+  else if (call.local >= 0)
+    emit(function, OpCode::CallLocal, call.local, argc);
+  else
+    emit(function, OpCode::Call, call.slot, argc);
+  if (call.position >= 0)
+    function.positions[function.code.size() - 1] = call.position;
+}
+
+uint32_t Compiler::compileLambda(const LambdaNode& lambda) {
+  auto it = program.lambdaFunctions.find(&lambda);
+  if (it != program.lambdaFunctions.end()) return it->second;
+
+  const uint32_t index = static_cast<uint32_t>(program.functions.size());
+  program.lambdaFunctions[&lambda] = index;
+  program.functions.emplace_back();
+
+  Function function;
+  function.name = lambda.functionName;
+  function.lambda = &lambda;
+  compileExpression(*lambda.body, function);
+  emit(function, OpCode::Return);
+  program.functions[index] = std::move(function);
+  return index;
+}
+
+// the typed opcodes come in + - * / order, starting at add
+OpCode Compiler::typedOp(char operation, OpCode add) {
+  static const char order[] = "+-*/";
+  for (uint8_t i = 0; i < 4; i++)
+    if (order[i] == operation)
+      return static_cast<OpCode>(static_cast<uint8_t>(add) + i);
+  throw std::runtime_error("Unsupported operation");
+}
+
+uint32_t Compiler::constant(Function& function, const Value& value) {
+  function.constants.push_back(value);
+  return static_cast<uint32_t>(function.constants.size() - 1);
+}
+
+void Compiler::emit(Function& function, OpCode op, uint32_t operand,
+                    uint8_t argc) {
+  function.code.push_back({op, argc, operand});
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+
+#include "../Parser/AST.h"
+#include "Bytecode.h"
+
+// lowers a parsed ProgramNode into a BytecodeProgram for the VM
+class Compiler {
+ public:
+  // the program has to be resolved, calls and variables compile to slots
+  static BytecodeProgram compile(const ProgramNode& program);
+
+  // for compiling one resolved statement at a time, source holds the global
+  // and built-in tables the Resolver keeps growing
+  Compiler(BytecodeProgram& program, const ProgramNode& source)
+      : program(program), source(source) {}
+
+  // a standalone script for the statement, the lambdas it declares are added
+  // to the program so they outlive it
+  Function compileScript(const ASTNode& node);
+
+ private:
+  void compileStatement(const ASTNode& node, Function& function);
+  void compileExpression(const ExpressionNode& node, Function& function);
+  void compileCall(const FunctionCallNode& call, Function& function);
+  uint32_t compileLambda(const LambdaNode& lambda);
+
+  static OpCode typedOp(char operation, OpCode add);
+  static uint32_t constant(Function& function, const Value& value);
+
+  static void emit(Function& function, OpCode op, uint32_t operand = 0,
+                   uint8_t argc = 0);
+
+ private:
+  BytecodeProgram& program;
+  const ProgramNode& source;
+};
@@ -0,0 +1,373 @@
+#include "VM.h"
+
+#include <sstream>
+#include <stdexcept>
+
+#include "../Parser/AST.h"
+
+const char* opCodeName(OpCode op) {
+  switch (op) {
+#define PALM_OPCODE_NAME(name) \
+  case OpCode::name:           \
+    return #name;
+    PALM_OPCODES(PALM_OPCODE_NAME)
+#undef PALM_OPCODE_NAME
+  }
+  return "Unknown";
+}
+
+std::string BytecodeProgram::to_string() const {
+  std::ostringstream out;
+  for (size_t i = 0; i < functions.size(); i++) {
+    const Function& function = functions[i];
+    out << "fn #" << i << " "
+        << (function.name == NO_SYMBOL ? "<script>" : symbolName(function.name))
+        << ":\n";
+    for (size_t pc = 0; pc < function.code.size(); pc++) {
+      const Instruction& in = function.code[pc];
+      out << "  " << pc << "\t" << opCodeName(in.op);
+      switch (in.op) {
+        case OpCode::Constant:
+          if (function.constants[in.operand].isLambda())
+            out << " <lambda "
+                << symbolName(
+                       function.constants[in.operand].asLambda()->functionName)
+                << ">";
+          else
+            out << " " << function.constants[in.operand].to_string();
+          break;
+        case OpCode::LoadGlobal:
+        case OpCode::DefineGlobal:
+        case OpCode::AssignGlobal:
+          out << " " << symbolName(names[in.operand]);
+          break;
+        case OpCode::CallBuiltIn:
+          out << " " << symbolName(builtInNames[in.operand]) << "/"
+              << int(in.argc);
+          break;
+        case OpCode::Call:
+          out << " " << symbolName(names[in.operand]) << "/" << int(in.argc);
+          break;
+        case OpCode::LoadLocal:
+          out << " $" << in.operand;
+          break;
+        case OpCode::CallLocal:
+          out << " $" << in.operand << "/" << int(in.argc);
+          break;
+        default:
+          break;
+      }
+      out << "\n";
+    }
+  }
+  return out.str();
+}
+
+#if defined(PALM_COMPUTED_GOTO) && defined(__GNUC__)
+// labels-as-values is a GNU extension
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+Value VM::run(Environment& env) { return run(env, program.functions[0]); }
+
+Value VM::run(Environment& env, const Function& entry) {
+  stack.clear();
+  frames.clear();
+  stack.reserve(256);
+  frames.reserve(64);
+
+  frames.push_back({&entry, entry.code.data(), 0});
+  const Instruction* ip = frames.back().ip;
+  const Value* constants = entry.constants.data();
+
+  // the arguments are already on the stack, they become the callee's frame.
+  // a cached or natively computed result replaces them right away, like a
+  // return would
+  // where the call at ip[-1] is in the source
+  auto position = [&]() {
+    const Function& function = *frames.back().function;
+    auto call = function.positions.find(
+        static_cast<uint32_t>(ip - 1 - function.code.data()));
+    return call != function.positions.end() ? call->second : -1;
+  };
+
+  auto enterLambda = [&](const Value& callee, const std::string& name,
+                         uint8_t argc) {
+    if (!callee.isLambda())
+      throw std::runtime_error("Unknown function: " + name);
+    const LambdaNode* lambda = callee.asLambda().get();
+    if (argc != lambda->arguments.size())
+      throw std::runtime_error("Input count mismatch");
+    if (Profiler::isEnabled())
+      Profiler::enter(lambda->functionName, false, position());
+    if (Trace::isEnabled())
+      Trace::begin(Trace::Kind::Lambda, lambda->functionName);
+    {
+      const Value* arguments = stack.data() + stack.size() - argc;
+      Value result;
+      const bool cached =
+          lambda->cache && lambda->cache->find(arguments, argc, result);
+      if (cached || Jit::call(*lambda, arguments, argc, env, result)) {
+        if (!cached && lambda->cache)
+          lambda->cache->insert(arguments, argc, result);
+        stack.resize(stack.size() - argc);
+        stack.push_back(std::move(result));
+        if (Profiler::isEnabled()) Profiler::leave();
+        if (Trace::isEnabled())
+          Trace::end(Trace::Kind::Lambda, lambda->functionName);
+        return;
+      }
+    }
+    if (frames.size() > Environment::MAX_CALL_DEPTH)
+      throw std::runtime_error("Stack overflow");
+
+    const Function& function =
+        program.functions[program.lambdaFunctions.at(lambda)];
+    frames.back().ip = ip;
+    frames.push_back({&function, function.code.data(), stack.size() - argc});
+    ip = function.code.data();
+    constants = function.constants.data();
+  };
+
+#ifdef PALM_COMPUTED_GOTO
+  static void* const dispatchTable[] = {
+#define PALM_OPCODE_LABEL(name) &&op_##name,
+      PALM_OPCODES(PALM_OPCODE_LABEL)
+#undef PALM_OPCODE_LABEL
+  };
+// an indirect goto skips destructors, so handlers keep no locals that own
+// memory across VM_NEXT()
+#define VM_CASE(name) op_##name:
+#define VM_NEXT() goto* dispatchTable[static_cast<uint8_t>((ip++)->op)]
+#define VM_DISPATCH() VM_NEXT();
+#else
+#define VM_CASE(name) case OpCode::name:
+#define VM_NEXT() continue
+#define VM_DISPATCH() switch ((ip++)->op)
+#endif
+
+  for (;;) {
+    VM_DISPATCH() {
+      VM_CASE(Constant) {
+        stack.push_back(constants[ip[-1].operand]);
+        VM_NEXT();
+      }
+      VM_CASE(Null) {
+        stack.emplace_back();
+        VM_NEXT();
+      }
+      VM_CASE(LoadGlobal) {
+        const uint32_t slot = ip[-1].operand;
+        if (!env.defined[slot]) {
+          const std::string& name = symbolName(program.names[slot]);
+          env.output->line("Undefined variable: " + name);
+          throw std::runtime_error("Undefined variable: " + name);
+        }
+        stack.push_back(env.globals[slot]);
+        VM_NEXT();
+      }
+      VM_CASE(LoadLocal) {
+        stack.push_back(stack[frames.back().base + ip[-1].operand]);
+        VM_NEXT();
+      }
+      VM_CASE(DefineGlobal) {
+        env.define(ip[-1].operand, std::move(stack.back()), ip[-1].argc != 0);
+        stack.pop_back();
+        VM_NEXT();
+      }
+      VM_CASE(AssignGlobal) {
+        env.define(ip[-1].operand, std::move(stack.back()), true);
+        stack.pop_back();
+        VM_NEXT();
+      }
+      VM_CASE(Add) {
+        stack.end()[-2] = stack.end()[-2] + stack.back();
+        stack.pop_back();
+        VM_NEXT();
+      }
+      VM_CASE(Subtract) {
+        stack.end()[-2] = stack.end()[-2] - stack.back();
+        stack.pop_back();
+        VM_NEXT();
+      }
+      VM_CASE(Multiply) {
+        stack.end()[-2] = stack.end()[-2] * stack.back();
+        stack.pop_back();
+        VM_NEXT();
+      }
+      VM_CASE(Divide) {
+        if (!stack.back().isArray() && !(stack.back() != 0))
+          throw std::runtime_error("Division by zero");
+        stack.end()[-2] = stack.end()[-2] / stack.back();
+        stack.pop_back();
+        VM_NEXT();
+      }
+      // typed operands are known to hold ints or doubles, only the result
+      // needs a Value
+      VM_CASE(AddInt) {
+        stack.end()[-2] = Value(
+            Arithmetic::add(stack.end()[-2].asInt(), stack.back().asInt()));
+        stack.pop_back();
+        VM_NEXT();
+      }
+      VM_CASE(SubtractInt) {
+        stack.end()[-2] = Value(Arithmetic::subtract(stack.end()[-2].asInt(),
+                                                     stack.back().asInt()));
+        stack.pop_back();
+        VM_NEXT();
+      }
+      VM_CASE(MultiplyInt) {
+        stack.end()[-2] = Value(Arithmetic::multiply(stack.end()[-2].asInt(),
+                                                     stack.back().asInt()));
+        stack.pop_back();
+        VM_NEXT();
+      }
+      VM_CASE(DivideInt) {
+        stack.end()[-2] = Value(
+            Arithmetic::divide(stack.end()[-2].asInt(), stack.back().asInt()));
+        stack.pop_back();
+        VM_NEXT();
+      }
+      VM_CASE(AddDouble) {
+        stack.end()[-2] = Value(Arithmetic::add(stack.end()[-2].asDouble(),
+                                                stack.back().asDouble()));
+        stack.pop_back();
+        VM_NEXT();
+      }
+      VM_CASE(SubtractDouble) {
+        stack.end()[-2] = Value(Arithmetic::subtract(
+            stack.end()[-2].asDouble(), stack.back().asDouble()));
+        stack.pop_back();
+        VM_NEXT();
+      }
+      VM_CASE(MultiplyDouble) {
+        stack.end()[-2] = Value(Arithmetic::multiply(
+            stack.end()[-2].asDouble(), stack.back().asDouble()));
+        stack.pop_back();
+        VM_NEXT();
+      }
+      VM_CASE(DivideDouble) {
+        stack.end()[-2] = Value(Arithmetic::divide(stack.end()[-2].asDouble(),
+                                                   stack.back().asDouble()));
+        stack.pop_back();
+        VM_NEXT();
+      }
+      VM_CASE(IntToDouble) {
+        stack.back() = Value(static_cast<double>(stack.back().asInt()));
+        VM_NEXT();
+      }
+      VM_CASE(Negate) {
+        Value& value = stack.back();
+        if (value.isArray()) {
+          value = value * Value(-1);
+          VM_NEXT();
+        }
+        if (!value.isNumeric()) throw std::runtime_error("Invalid Unary Operand");
+        value = value.isInt() ? Value(Arithmetic::subtract(0, value.asInt()))
+                              : Value(-value.asDouble());
+        VM_NEXT();
+      }
+      VM_CASE(UnaryPlus) {
+        Value& value = stack.back();
+        if (!value.isNumeric() && !value.isArray())
+          throw std::runtime_error("Invalid Unary Operand");
+        VM_NEXT();
+      }
+      VM_CASE(MakeArray) {
+        const uint32_t count = ip[-1].operand;
+        stack.emplace_back();
+        stack.back() =
+            Value::array(stack.data() + stack.size() - 1 - count, count);
+        stack[stack.size() - 1 - count] = std::move(stack.back());
+        stack.resize(stack.size() - count);
+        VM_NEXT();
+      }
+      VM_CASE(Index) {
+        stack.end()[-2] = stack.end()[-2][stack.back()];
+        stack.pop_back();
+        VM_NEXT();
+      }
+      VM_CASE(CallBuiltIn) {
+        const Instruction& in = ip[-1];
+        // the arguments are read where they are, the result replaces them
+        const size_t base = stack.size() - in.argc;
+        stack.emplace_back();
+        {
+          Profiler::Call profile(program.builtInNames[in.operand], true,
+                                 Profiler::isEnabled() ? position() : -1);
+          Trace::Scope trace(Trace::Kind::BuiltIn,
+                             program.builtInNames[in.operand]);
+          stack.back() = (*env.builtIns[in.operand])(
+              Arguments{stack.data() + base, in.argc, &env});
+        }
+        stack[base] = std::move(stack.back());
+        stack.resize(base + 1);
+        VM_NEXT();
+      }
+      VM_CASE(Call) {
+        const Instruction& in = ip[-1];
+        if (!env.defined[in.operand])
+          throw std::runtime_error("Unknown function: " +
+                                   symbolName(program.names[in.operand]));
+        enterLambda(env.globals[in.operand],
+                    symbolName(program.names[in.operand]), in.argc);
+        VM_NEXT();
+      }
+      VM_CASE(CallLocal) {
+        const Instruction& in = ip[-1];
+        {
+          // copied, entering the frame may grow the stack it lives on
+          const Value callee = stack[frames.back().base + in.operand];
+          enterLambda(callee, "$" + std::to_string(in.operand), in.argc);
+        }
+        VM_NEXT();
+      }
+      VM_CASE(Pop) {
+        stack.pop_back();
+        VM_NEXT();
+      }
+      VM_CASE(Slide) {
+        const uint32_t count = ip[-1].operand;
+        stack[stack.size() - 1 - count] = std::move(stack.back());
+        stack.resize(stack.size() - count);
+        VM_NEXT();
+      }
+      VM_CASE(Return) {
+        const size_t base = frames.back().base;
+        // the arguments are still below anything the body pushed
+        if (const LambdaNode* lambda = frames.back().function->lambda;
+            lambda && lambda->cache)
+          lambda->cache->insert(stack.data() + base, lambda->arguments.size(),
+                                stack.back());
+        if (const LambdaNode* lambda = frames.back().function->lambda) {
+          if (Profiler::isEnabled()) Profiler::leave();
+          if (Trace::isEnabled())
+            Trace::end(Trace::Kind::Lambda, lambda->functionName);
+        }
+        frames.pop_back();
+        if (frames.empty()) {
+          Value result = std::move(stack.back());
+          stack.pop_back();
+          return result;
+        }
+        // drop the arguments and leave the result where they started
+        if (stack.size() - 1 != base) {
+          stack[base] = std::move(stack.back());
+          stack.resize(base + 1);
+        }
+        ip = frames.back().ip;
+        constants = frames.back().function->constants.data();
+        VM_NEXT();
+      }
+    }
+  }
+
+#undef VM_CASE
+#undef VM_NEXT
+#undef VM_DISPATCH
+}
+
+#if defined(PALM_COMPUTED_GOTO) && defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+
+#include "Bytecode.h"
+
+// computed-goto dispatch where the compiler supports labels as values
+#if defined(__GNUC__) || defined(__clang__)
+#define PALM_COMPUTED_GOTO 1
+#endif
+
+// stack machine that runs a BytecodeProgram produced by the Compiler
+class VM {
+ public:
+  explicit VM(const BytecodeProgram& program) : program(program) {}
+
+  // runs the program's script, functions[0]
+  Value run(Environment& env);
+  // runs a script compiled on its own, see Compiler::compileScript
+  Value run(Environment& env, const Function& entry);
+
+ private:
+  // a lambda's arguments sit on the value stack from base up
+  struct CallFrame {
+    const Function* function;
+    const Instruction* ip;
+    size_t base;
+  };
+
+  const BytecodeProgram& program;
+  std::vector<Value> stack;
+  std::vector<CallFrame> frames;
+};
@@ -0,0 +1,82 @@
+# cmake -DPALMTREE=<palmtree> -DPROGRAM=<file.palm> -P CompareModes.cmake
+#
+# runs a program in every mode and fails if one of them prints anything, to
+# stdout or stderr, or exits with a status the reference doesn't. the
+# reference is the tree-walker without the optimizer. with a <name>.expected
+# next to the program, the reference has to print exactly that as well
+
+cmake_minimum_required(VERSION 3.10)
+
+if(NOT PALMTREE OR NOT PROGRAM)
+  message(FATAL_ERROR "PALMTREE and PROGRAM have to be set")
+endif()
+
+# each one is the flags for a run, "-" reads the program from stdin
+set(MODES
+    "--tree-walk"
+    ""
+    "--no-optimize"
+    "--stream"
+    "--stream -"
+    "--parallel"
+    "--jit=eager"
+    "--jit=eager --parallel")
+
+# the pool is as big as the machine, so on one core it has no threads of its
+# own and nothing runs concurrently. every run gets the same pool instead, and
+# each mode runs more than once so a race has a few chances to show up
+set(THREADS 4)
+if(NOT RUNS)
+  set(RUNS 3)
+endif()
+
+function(run flags prefix)
+  separate_arguments(args UNIX_COMMAND "--threads ${THREADS} ${flags}")
+  if("-" IN_LIST args)
+    execute_process(COMMAND "${PALMTREE}" ${args}
+                    INPUT_FILE "${PROGRAM}"
+                    OUTPUT_VARIABLE out ERROR_VARIABLE err
+                    RESULT_VARIABLE status)
+  else()
+    execute_process(COMMAND "${PALMTREE}" ${args} "${PROGRAM}"
+                    OUTPUT_VARIABLE out ERROR_VARIABLE err
+                    RESULT_VARIABLE status)
+  endif()
+  set(${prefix}_out "${out}" PARENT_SCOPE)
+  set(${prefix}_err "${err}" PARENT_SCOPE)
+  set(${prefix}_status "${status}" PARENT_SCOPE)
+endfunction()
+
+run("--tree-walk --no-optimize" reference)
+
+get_filename_component(dir "${PROGRAM}" DIRECTORY)
+get_filename_component(name "${PROGRAM}" NAME_WE)
+if(EXISTS "${dir}/${name}.expected")
+  file(READ "${dir}/${name}.expected" expected)
+  if(NOT reference_out STREQUAL expected)
+    message(FATAL_ERROR "the reference printed\n${reference_out}\n"
+                        "instead of\n${expected}")
+  endif()
+endif()
+
+set(failed FALSE)
+foreach(flags IN LISTS MODES)
+  foreach(attempt RANGE 1 ${RUNS})
+    run("${flags}" mode)
+    if(NOT mode_out STREQUAL reference_out OR
+       NOT mode_err STREQUAL reference_err OR
+       NOT mode_status STREQUAL reference_status)
+      message(SEND_ERROR "'${flags}' differs from the reference on run "
+                         "${attempt} of ${RUNS}\n"
+                         "exit ${mode_status}, stdout:\n${mode_out}"
+                         "stderr:\n${mode_err}\n"
+                         "the reference's exit ${reference_status}, stdout:\n"
+                         "${reference_out}stderr:\n${reference_err}")
+      set(failed TRUE)
+      break()
+    endif()
+  endforeach()
+endforeach()
+if(failed)
+  message(FATAL_ERROR "${PROGRAM} doesn't print the same in every mode")
+endif()
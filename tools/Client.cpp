@@ -0,0 +1,61 @@
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+#include "Server/Protocol.h"
+
+/*
+sends one script to palmtree --serve and prints what it printed, the way
+running it with palmtree would. inputs are given as name=value and are
+defined as globals before the script runs.
+*/
+
+namespace {
+
+int usage(const char* program) {
+  std::cerr << "usage: " << program << " socket file|- [name=value ...]\n";
+  return 2;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) return usage(argv[0]);
+
+  Protocol::Request request;
+  const std::string path = argv[2];
+  if (path == "-") {
+    request.script.assign(std::istreambuf_iterator<char>(std::cin), {});
+  } else {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+      std::cerr << "error: can't open " << path << '\n';
+      return 1;
+    }
+    request.script.assign(std::istreambuf_iterator<char>(file), {});
+  }
+  for (int i = 3; i < argc; i++) {
+    const std::string input = argv[i];
+    const size_t equals = input.find('=');
+    if (equals == std::string::npos || equals == 0) return usage(argv[0]);
+    request.inputs.emplace_back(input.substr(0, equals),
+                                input.substr(equals + 1));
+  }
+
+  try {
+    Protocol::Connection connection = Protocol::Connection::connect(argv[1]);
+    connection.write(request);
+    Protocol::Reply reply;
+    if (!connection.read(reply))
+      throw std::runtime_error("The server closed the connection");
+    std::cout << reply.output << std::flush;
+    if (!reply.ok) {
+      std::cerr << "error: " << reply.error << '\n';
+      return 1;
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "error: " << e.what() << '\n';
+    return 1;
+  }
+}